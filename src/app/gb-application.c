@@ -26,6 +26,7 @@
 #include <gtksourceview/gtksource.h>
 
 #include "gb-application.h"
+#include "gb-deferred.h"
 #include "gb-editor-file-marks.h"
 #include "gb-editor-workspace.h"
 #include "gb-log.h"
@@ -40,7 +41,14 @@
 #define LANGUAGE_PATH "/org/gnome/builder/editor/language/"
 #define GSV_PATH "resource:///org/gnome/builder/styles/"
 
-G_DEFINE_TYPE (GbApplication, gb_application, GTK_TYPE_APPLICATION)
+struct _GbApplicationPrivate
+{
+  GbDeferred *keybindings;
+  GbDeferred *skeleton_dirs;
+  GbDeferred *theme_overrides;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GbApplication, gb_application, GTK_TYPE_APPLICATION)
 
 static void
 gb_application_setup_search_paths (void)
@@ -174,23 +182,6 @@ gb_application_make_skeleton_dirs (GbApplication *self)
   g_free (path);
 }
 
-static void
-gb_application_load_file_marks (GbApplication *application)
-{
-  GbEditorFileMarks *marks;
-  GError *error = NULL;
-
-  g_return_if_fail (GB_IS_APPLICATION (application));
-
-  marks = gb_editor_file_marks_get_default ();
-
-  if (!gb_editor_file_marks_load (marks, &error))
-    {
-      g_warning ("%s", error->message);
-      g_clear_error (&error);
-    }
-}
-
 static void
 gb_application_on_theme_changed (GbApplication *self,
                                  GParamSpec    *pspec,
@@ -306,6 +297,32 @@ gb_application_register_keybindings (GbApplication *self)
   EXIT;
 }
 
+/*
+ * Anything not needed to show the first window is initialized once it has
+ * been drawn.
+ */
+static gboolean
+gb_application_on_first_draw (GtkWidget *widget,
+                              cairo_t   *cr,
+                              gpointer   user_data)
+{
+  GbApplication *self = user_data;
+
+  g_assert (GTK_IS_WIDGET (widget));
+  g_assert (GB_IS_APPLICATION (self));
+
+  gb_trace_instant ("first-draw");
+
+  gb_deferred_schedule (self->priv->keybindings);
+  gb_deferred_schedule (self->priv->skeleton_dirs);
+
+  g_signal_handlers_disconnect_by_func (widget,
+                                        gb_application_on_first_draw,
+                                        user_data);
+
+  return FALSE;
+}
+
 static GbWorkbench *
 gb_application_create_workbench (GApplication *application)
 {
@@ -337,6 +354,13 @@ gb_application_create_workbench (GApplication *application)
 
   gtk_window_maximize (window);
 
+  /* The style overrides must be in place before the window is drawn. */
+  gb_deferred_ensure (GB_APPLICATION (application)->priv->theme_overrides);
+
+  g_signal_connect_after (window, "draw",
+                          G_CALLBACK (gb_application_on_first_draw),
+                          application);
+
   gtk_application_add_window (GTK_APPLICATION (application), window);
 
   RETURN (GB_WORKBENCH (window));
@@ -375,7 +399,6 @@ gb_application_open (GApplication   *application,
   GbWorkbench *workbench = NULL;
   GbWorkspace *workspace;
   GList *list;
-  guint i;
 
   g_assert (GB_IS_APPLICATION (application));
 
@@ -400,11 +423,8 @@ gb_application_open (GApplication   *application,
 
   g_assert (GB_IS_EDITOR_WORKSPACE (workspace));
 
-  for (i = 0; i < n_files; i++)
-    {
-      g_return_if_fail (G_IS_FILE (files [i]));
-      gb_editor_workspace_open (GB_EDITOR_WORKSPACE (workspace), files [i]);
-    }
+  gb_editor_workspace_open_files (GB_EDITOR_WORKSPACE (workspace),
+                                  files, n_files);
 }
 
 static void
@@ -518,18 +538,26 @@ gb_application_startup (GApplication *app)
 
   g_assert (GB_IS_APPLICATION (self));
 
+  gb_trace_begin ("startup:resources");
   g_resources_register (gb_get_resource ());
   g_application_set_resource_base_path (app, "/org/gnome/builder");
+  gb_trace_end ("startup:resources");
 
+  gb_trace_begin ("startup:gtk");
   G_APPLICATION_CLASS (gb_application_parent_class)->startup (app);
+  gb_trace_end ("startup:gtk");
 
-  gb_application_make_skeleton_dirs (self);
+  gb_trace_begin ("startup:language-defaults");
   gb_application_install_language_defaults (self);
+  gb_trace_end ("startup:language-defaults");
+
+  gb_trace_begin ("startup:actions");
   gb_application_register_actions (self);
-  gb_application_register_keybindings (self);
-  gb_application_register_theme_overrides (self);
-  gb_application_load_file_marks (self);
+  gb_trace_end ("startup:actions");
+
+  gb_trace_begin ("startup:search-paths");
   gb_application_setup_search_paths ();
+  gb_trace_end ("startup:search-paths");
 
   EXIT;
 }
@@ -569,6 +597,22 @@ gb_application_constructed (GObject *object)
   EXIT;
 }
 
+static void
+gb_application_finalize (GObject *object)
+{
+  GbApplicationPrivate *priv = GB_APPLICATION (object)->priv;
+
+  ENTRY;
+
+  g_clear_pointer (&priv->keybindings, gb_deferred_free);
+  g_clear_pointer (&priv->skeleton_dirs, gb_deferred_free);
+  g_clear_pointer (&priv->theme_overrides, gb_deferred_free);
+
+  G_OBJECT_CLASS (gb_application_parent_class)->finalize (object);
+
+  EXIT;
+}
+
 static void
 gb_application_class_init (GbApplicationClass *klass)
 {
@@ -578,6 +622,7 @@ gb_application_class_init (GbApplicationClass *klass)
   ENTRY;
 
   object_class->constructed = gb_application_constructed;
+  object_class->finalize = gb_application_finalize;
 
   app_class->activate = gb_application_activate;
   app_class->startup = gb_application_startup;
@@ -590,6 +635,28 @@ gb_application_class_init (GbApplicationClass *klass)
 static void
 gb_application_init (GbApplication *application)
 {
+  GbApplicationPrivate *priv;
+
   ENTRY;
+
+  priv = application->priv = gb_application_get_instance_private (application);
+
+  /*
+   * These are not needed to show the first window. They run on first use
+   * or from an idle handler once the first window has been drawn.
+   */
+  priv->keybindings =
+    gb_deferred_new ("keybindings",
+                     (GbDeferredFunc)gb_application_register_keybindings,
+                     application);
+  priv->skeleton_dirs =
+    gb_deferred_new ("skeleton-dirs",
+                     (GbDeferredFunc)gb_application_make_skeleton_dirs,
+                     application);
+  priv->theme_overrides =
+    gb_deferred_new ("theme-overrides",
+                     (GbDeferredFunc)gb_application_register_theme_overrides,
+                     application);
+
   EXIT;
 }
@@ -100,156 +100,252 @@ parameter_validate (Parameter *param)
   return TRUE;
 }
 
+struct _ParameterArena
+{
+  GString *strings;
+  GArray  *params;
+};
+
+/**
+ * parameter_arena_new:
+ *
+ * Creates scratch storage for parse_parameters_arena(). Reusing the same
+ * arena for every call means parsing does not touch the heap once the arena
+ * has grown to fit the longest parameter list.
+ *
+ * Returns: (transfer full): A #ParameterArena.
+ */
+ParameterArena *
+parameter_arena_new (void)
+{
+  ParameterArena *arena;
+
+  arena = g_new0 (ParameterArena, 1);
+  arena->strings = g_string_sized_new (256);
+  arena->params = g_array_sized_new (FALSE, FALSE, sizeof (Parameter), 8);
+
+  return arena;
+}
+
+void
+parameter_arena_free (ParameterArena *arena)
+{
+  if (arena)
+    {
+      g_string_free (arena->strings, TRUE);
+      g_array_unref (arena->params);
+      g_free (arena);
+    }
+}
+
 static void
-parameter_compute (Parameter *param)
+strip_range (const gchar **begin,
+             const gchar **end)
+{
+  while ((*begin < *end) && g_ascii_isspace (**begin))
+    (*begin)++;
+
+  while ((*end > *begin) && g_ascii_isspace (*(*end - 1)))
+    (*end)--;
+}
+
+/*
+ * Copies the range into the arena. The strings buffer may be reallocated
+ * while parsing, so we return the offset (plus one, to keep NULL free for
+ * missing strings) and fix up the pointers when we are done.
+ */
+static gpointer
+arena_push (ParameterArena *arena,
+            const gchar    *begin,
+            const gchar    *end)
+{
+  gsize offset = arena->strings->len;
+
+  g_string_append_len (arena->strings, begin, end - begin);
+  g_string_append_c (arena->strings, '\0');
+
+  return GSIZE_TO_POINTER (offset + 1);
+}
+
+static gboolean
+range_is_valid (const gchar *begin,
+                const gchar *end,
+                const gchar *allowed)
 {
   const gchar *tmp;
-  gchar *rev;
-  guint n_star = 0;
 
-  rev = g_utf8_strreverse (param->type, -1);
+  for (tmp = begin; tmp < end; tmp = g_utf8_next_char (tmp))
+    {
+      gunichar ch = g_utf8_get_char (tmp);
+
+      if ((ch < 0x80) && strchr (allowed, ch))
+        continue;
+
+      if (g_unichar_isalnum (ch))
+        continue;
 
-  for (tmp = rev; tmp; tmp = g_utf8_next_char (tmp))
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+parse_parameter (ParameterArena *arena,
+                 const gchar    *word,
+                 const gchar    *word_end)
+{
+  Parameter param = { 0 };
+  const gchar *name_sep;
+  const gchar *name;
+  const gchar *name_end;
+  const gchar *type;
+  const gchar *type_end;
+  const gchar *stars;
+
+  strip_range (&word, &word_end);
+
+  if (word == word_end)
+    return FALSE;
+
+  if (((word_end - word) == 3) && (strncmp (word, "...", 3) == 0))
     {
-      switch (g_utf8_get_char (tmp))
-        {
-        case ' ':
-          break;
-
-        case '*':
-          n_star++;
-          break;
-
-        default:
-          if (n_star)
-            {
-              gchar *cleaned;
-
-              cleaned = g_strstrip (g_utf8_strreverse (tmp, -1));
-              g_free (param->type);
-              param->type = cleaned;
-            }
-          goto finish;
-        }
+      param.ellipsis = TRUE;
+      g_array_append_val (arena->params, param);
+      return TRUE;
     }
 
-finish:
-  param->n_star = n_star;
+  /*
+   * Check that each word only contains valid characters for a
+   * parameter list.
+   */
+  if (!range_is_valid (word, word_end, "\t *_[]"))
+    return FALSE;
+
+  /*
+   * TODO: Special case parsing of parameters that have [] after the
+   *       name. Such as "char foo[12]" or "char foo[static 12]".
+   */
+  if (memchr (word, '[', word_end - word) && memchr (word, ']', word_end - word))
+    return FALSE;
+
+  /* The name follows the last space or star. */
+  for (name_sep = word_end - 1; name_sep > word; name_sep--)
+    if (strchr ("\t\n *", *name_sep))
+      break;
 
-  g_free (rev);
+  if (name_sep == word)
+    return FALSE;
+
+  name = name_sep + 1;
+  name_end = word_end;
+  strip_range (&name, &name_end);
+
+  type = word;
+  type_end = name_sep + 1;
+  strip_range (&type, &type_end);
+
+  /* Trailing stars on the type are tracked with n_star instead. */
+  for (stars = type_end;
+       (stars > type) && ((*(stars - 1) == ' ') || (*(stars - 1) == '*'));
+       stars--)
+    if (*(stars - 1) == '*')
+      param.n_star++;
+
+  if (param.n_star)
+    {
+      type_end = stars;
+      strip_range (&type, &type_end);
+    }
+
+  if (!range_is_valid (name, name_end, "_[]") ||
+      !range_is_valid (type, type_end, "* _"))
+    return FALSE;
+
+  param.type = arena_push (arena, type, type_end);
+  param.name = arena_push (arena, name, name_end);
+  g_array_append_val (arena->params, param);
+
+  return TRUE;
 }
 
-GSList *
-parse_parameters (const gchar *text)
+/**
+ * parse_parameters_arena:
+ * @arena: A #ParameterArena.
+ * @text: The text within the parentheses of a parameter list.
+ * @n_params: (out): A location for the number of parameters.
+ *
+ * Like parse_parameters() but stores the result in @arena instead of
+ * allocating each parameter and its strings.
+ *
+ * Returns: (transfer none): An array of @n_params parameters that is valid
+ *   until @arena is reused or freed, or %NULL if @text could not be parsed.
+ */
+const Parameter *
+parse_parameters_arena (ParameterArena *arena,
+                        const gchar    *text,
+                        guint          *n_params)
 {
-  GSList *ret = NULL;
-  gchar **parts = NULL;
+  const gchar *word;
+  const gchar *sep;
   guint i;
 
   ENTRY;
 
-  parts = g_strsplit (text, ",", 0);
+  g_return_val_if_fail (arena, NULL);
+  g_return_val_if_fail (text, NULL);
+  g_return_val_if_fail (n_params, NULL);
+
+  g_string_truncate (arena->strings, 0);
+  g_array_set_size (arena->params, 0);
 
-  for (i = 0; parts [i]; i++)
+  *n_params = 0;
+
+  for (word = text; ; word = sep + 1)
     {
-      const gchar *tmp;
-      const gchar *word;
+      if (!(sep = strchr (word, ',')))
+        sep = word + strlen (word);
+
+      if (!parse_parameter (arena, word, sep))
+        RETURN (NULL);
 
-      word = g_strstrip (parts [i]);
+      if (*sep == '\0')
+        break;
+    }
 
-      if (!*word)
-        GOTO (failure);
+  for (i = 0; i < arena->params->len; i++)
+    {
+      Parameter *param = &g_array_index (arena->params, Parameter, i);
 
-      if (g_strcmp0 (word, "...") == 0)
-        {
-          Parameter param = { NULL, NULL, TRUE };
-          ret = g_slist_append (ret, parameter_copy (&param));
-          continue;
-        }
-
-      /*
-       * Check that each word only contains valid characters for a
-       * parameter list.
-       */
-      for (tmp = word; *tmp; tmp = g_utf8_next_char (tmp))
-        {
-          gunichar ch;
-
-          ch = g_utf8_get_char (tmp);
-
-          switch (ch)
-            {
-            case '\t':
-            case ' ':
-            case '*':
-            case '_':
-            case '[':
-            case ']':
-              break;
-
-            default:
-              if (g_unichar_isalnum (ch))
-                break;
-
-              GOTO (failure);
-            }
-        }
-
-      if (strchr (word, '[') && strchr (word, ']'))
-        {
-          /*
-           * TODO: Special case parsing of parameters that have [] after the
-           *       name. Such as "char foo[12]" or "char foo[static 12]".
-           */
-        }
-      else
-        {
-          const gchar *name_sep;
-          Parameter param = { 0 };
-          gboolean success = FALSE;
-          gchar *reversed = NULL;
-          gchar *name_rev = NULL;
-
-          reversed = g_utf8_strreverse (word, -1);
-          name_sep = strpbrk (reversed, "\t\n *");
-
-          if (name_sep && *name_sep && *(name_sep + 1))
-            {
-              name_rev = g_strndup (reversed, name_sep - reversed);
-
-              param.name = g_strstrip (g_utf8_strreverse (name_rev, -1));
-              param.type = g_strstrip (g_utf8_strreverse (name_sep, -1));
-
-              parameter_compute (&param);
-
-              if (parameter_validate (&param))
-                {
-                  ret = g_slist_append (ret, parameter_copy (&param));
-                  success = TRUE;
-                }
-
-              g_free (param.name);
-              g_free (param.type);
-              g_free (name_rev);
-            }
-
-          g_free (reversed);
-
-          if (success)
-            continue;
-        }
-
-      GOTO (failure);
+      if (param->type)
+        param->type = arena->strings->str + GPOINTER_TO_SIZE (param->type) - 1;
+      if (param->name)
+        param->name = arena->strings->str + GPOINTER_TO_SIZE (param->name) - 1;
     }
 
-  GOTO (cleanup);
+  *n_params = arena->params->len;
+
+  RETURN ((const Parameter *)(gpointer)arena->params->data);
+}
+
+GSList *
+parse_parameters (const gchar *text)
+{
+  ParameterArena *arena;
+  const Parameter *params;
+  GSList *ret = NULL;
+  guint n_params;
+  guint i;
+
+  ENTRY;
+
+  arena = parameter_arena_new ();
+  params = parse_parameters_arena (arena, text, &n_params);
 
-failure:
-  g_slist_foreach (ret, (GFunc)parameter_free, NULL);
-  g_clear_pointer (&ret, g_slist_free);
+  for (i = 0; params && (i < n_params); i++)
+    ret = g_slist_prepend (ret, parameter_copy (&params [i]));
 
-cleanup:
-  g_strfreev (parts);
+  parameter_arena_free (arena);
 
-  RETURN (ret);
+  RETURN (g_slist_reverse (ret));
 }
@@ -31,10 +31,17 @@ typedef struct
   guint  n_star   : 4;
 } Parameter;
 
-gboolean   parameter_validate (Parameter       *param);
-void       parameter_free     (Parameter       *p);
-Parameter *parameter_copy     (const Parameter *src);
-GSList    *parse_parameters   (const gchar     *text);
+typedef struct _ParameterArena ParameterArena;
+
+gboolean         parameter_validate     (Parameter       *param);
+void             parameter_free         (Parameter       *p);
+Parameter       *parameter_copy         (const Parameter *src);
+GSList          *parse_parameters       (const gchar     *text);
+ParameterArena  *parameter_arena_new    (void);
+void             parameter_arena_free   (ParameterArena  *arena);
+const Parameter *parse_parameters_arena (ParameterArena  *arena,
+                                         const gchar     *text,
+                                         guint           *n_params);
 
 G_END_DECLS
 
@@ -21,6 +21,8 @@
 #include <glib/gi18n.h>
 
 #include "gb-log.h"
+#include "gb-source-bracket-index.h"
+#include "gb-source-c-line-cache.h"
 #include "gb-source-auto-indenter-c.h"
 
 #include "c-parse-helper.h"
@@ -43,6 +45,8 @@
 
 struct _GbSourceAutoIndenterCPrivate
 {
+  ParameterArena *param_arena;
+
   gint  scope_indent;
   gint  condition_indent;
   gint  directive_indent;
@@ -73,28 +77,6 @@ gb_source_auto_indenter_c_new (void)
   return g_object_new (GB_TYPE_SOURCE_AUTO_INDENTER_C, NULL);
 }
 
-static gunichar
-text_iter_peek_next_char (const GtkTextIter *location)
-{
-  GtkTextIter iter = *location;
-
-  if (gtk_text_iter_forward_char (&iter))
-    return gtk_text_iter_get_char (&iter);
-
-  return 0;
-}
-
-static gunichar
-text_iter_peek_prev_char (const GtkTextIter *location)
-{
-  GtkTextIter iter = *location;
-
-  if (gtk_text_iter_backward_char (&iter))
-    return gtk_text_iter_get_char (&iter);
-
-  return 0;
-}
-
 static inline void
 build_indent (GbSourceAutoIndenterC *c,
               guint                  line_offset,
@@ -133,23 +115,6 @@ build_indent (GbSourceAutoIndenterC *c,
     g_string_append_c (str, ' ');
 }
 
-static gboolean
-iter_ends_c89_comment (const GtkTextIter *iter)
-{
-  if (gtk_text_iter_get_char (iter) == '/')
-    {
-      GtkTextIter tmp;
-
-      tmp = *iter;
-
-      if (gtk_text_iter_backward_char (&tmp) &&
-          ('*' == gtk_text_iter_get_char (&tmp)))
-        return TRUE;
-    }
-
-  return FALSE;
-}
-
 static gboolean
 non_space_predicate (gunichar ch,
                      gpointer user_data)
@@ -285,14 +250,18 @@ cleanup:
   return FALSE;
 }
 
+/*
+ * Moves @iter to the opening bracket that a @ch inserted at @iter would
+ * close. The bracket index skips strings and comments and is only rescanned
+ * after edits, so this no longer walks the buffer a character at a time.
+ */
 static gboolean
 backward_find_matching_char (GtkTextIter *iter,
                              gunichar     ch)
 {
-  GtkTextIter copy;
+  GbSourceBracketIndex *index;
+  GtkTextBuffer *buffer;
   gunichar match;
-  gunichar cur;
-  guint count = 1;
 
   switch (ch) {
   case ')':
@@ -302,65 +271,18 @@ backward_find_matching_char (GtkTextIter *iter,
     match = '{';
     break;
   case '[':
-    match = ']';
+  case ']':
+    match = '[';
     break;
   default:
     g_assert_not_reached ();
     break;
   }
 
-  gtk_text_iter_assign (&copy, iter);
-
-  while (gtk_text_iter_backward_char (iter))
-    {
-      cur = gtk_text_iter_get_char (iter);
-
-      if ((cur == '\'') || (cur == '"'))
-        {
-          gunichar strcur = 0;
-
-          while (gtk_text_iter_backward_char (iter))
-            {
-              strcur = gtk_text_iter_get_char (iter);
-              if (strcur == cur)
-                {
-                  GtkTextIter copy2 = *iter;
-
-                  /* check if the character before this is an escape char */
-                  if (gtk_text_iter_backward_char (&copy2) &&
-                      ('\\' == gtk_text_iter_get_char (&copy2)))
-                    continue;
-
-                  break;
-                }
-            }
-
-          if (strcur != cur)
-            break;
-        }
-      else if ((cur == '/') && iter_ends_c89_comment (iter))
-        {
-          GtkTextIter tmp = *iter;
-
-          if (backward_before_c89_comment (&tmp))
-            {
-              *iter = tmp;
-              cur = gtk_text_iter_get_char (iter);
-            }
-        }
-
-      if (cur == match)
-        {
-          if (--count == 0)
-            return TRUE;
-        }
-      else if (cur == ch)
-        count++;
-    }
-
-  gtk_text_iter_assign (iter, &copy);
+  buffer = gtk_text_iter_get_buffer (iter);
+  index = gb_source_bracket_index_get_for_buffer (buffer);
 
-  return FALSE;
+  return gb_source_bracket_index_find_enclosing (index, iter, match, iter);
 }
 
 static gboolean
@@ -436,14 +358,15 @@ backward_to_line_first_char (GtkTextIter *iter)
 }
 
 /**
- * text_iter_in_c89_comment:
+ * in_c89_comment:
  * @location: (in): A #GtkTextIter containing the target location.
+ * @match_begin: (out): A location for the beginning of the comment.
  *
- * The algorith for this is unfortunately trickier than one would expect.
- * Because we could always still have context if we walk backwards that
- * would let us know if we are in a string, we just start from the beginning
- * of the buffer and try to skip forward until we get to our target
- * position.
+ * Whether or not we are in a c89 comment depends on everything before
+ * @location, so we ask the line cache for the lexical state at the start of
+ * the line and only lex the current line up to (and including) @location.
+ * The lexer cannot look past @location, so a "/*" that begins at @location
+ * is checked for separately.
  *
  * Returns: %TRUE if we think we are in a c89 comment, otherwise %FALSE.
  */
@@ -451,70 +374,35 @@ static gboolean
 in_c89_comment (const GtkTextIter *location,
                 GtkTextIter       *match_begin)
 {
+  GbSourceCLineCache *cache;
+  GbSourceCLineState state;
   GtkTextBuffer *buffer;
-  GtkTextIter iter;
   GtkTextIter after_location;
 
   buffer = gtk_text_iter_get_buffer (location);
-  gtk_text_buffer_get_start_iter (buffer, &iter);
+  cache = gb_source_c_line_cache_get_for_buffer (buffer);
 
   after_location = *location;
   gtk_text_iter_forward_char (&after_location);
 
-  do
-    {
-      gunichar ch;
-
-      if (gtk_text_iter_compare (&iter, location) > 0)
-        break;
-
-      ch = gtk_text_iter_get_char (&iter);
-
-      /* skip past the c89 comment */
-      if ((ch == '/') && (text_iter_peek_next_char (&iter) == '*'))
-        {
-          GtkTextIter saved = iter;
-
-          if (!gtk_text_iter_forward_chars (&iter, 2) ||
-              !gtk_text_iter_forward_search (&iter, "*/",
-                                             GTK_TEXT_SEARCH_TEXT_ONLY,
-                                             NULL, &iter, &after_location))
-            {
-              *match_begin = saved;
-              RETURN (TRUE);
-            }
-        }
+  gb_source_c_line_cache_get_state (cache, &after_location, &state);
 
-      /* skip past a string or character */
-      if ((ch == '\'') || (ch == '"'))
-        {
-          const gchar *match = (ch == '\'') ? "'" : "\"";
+  if ((state.comment_begin == -1) &&
+      (state.string_quote == 0) &&
+      !state.in_line_comment &&
+      (gtk_text_iter_get_char (location) == '/') &&
+      (gtk_text_iter_get_char (&after_location) == '*'))
+    {
+      *match_begin = *location;
+      return TRUE;
+    }
 
-        again:
-          if (!gtk_text_iter_forward_search (&iter, match,
-                                             GTK_TEXT_SEARCH_TEXT_ONLY,
-                                             NULL, NULL, NULL))
-            return FALSE;
+  if (state.comment_begin == -1)
+    return FALSE;
 
-          /* this one is escaped, keep looking */
-          if (text_iter_peek_prev_char (&iter) == '\\')
-            {
-              if (!gtk_text_iter_forward_char (&iter))
-                return FALSE;
-              goto again;
-            }
-        }
+  gtk_text_buffer_get_iter_at_offset (buffer, match_begin, state.comment_begin);
 
-      /* skip past escaped character */
-      if (ch == '\\')
-        {
-          if (!gtk_text_iter_forward_char (&iter))
-            return FALSE;
-        }
-    }
-  while (gtk_text_iter_forward_char (&iter));
-
-  return FALSE;
+  return TRUE;
 }
 
 static gchar *
@@ -957,20 +845,23 @@ maybe_space_before_paren (GbSourceAutoIndenterC *c,
 }
 #endif
 
-static gchar *
-format_parameter (const Parameter *param,
+static void
+append_parameter (GString         *str,
+                  const Parameter *param,
                   guint            max_type,
                   guint            max_star)
 {
-  GString *str;
   guint i;
 
   if (param->ellipsis)
-    return g_strdup ("...");
+    {
+      g_string_append (str, "...");
+      return;
+    }
 
-  str = g_string_new (param->type);
+  g_string_append (str, param->type);
 
-  for (i = str->len; i < max_type; i++)
+  for (i = strlen (param->type); i < max_type; i++)
     g_string_append_c (str, ' ');
 
   g_string_append_c (str, ' ');
@@ -984,26 +875,25 @@ format_parameter (const Parameter *param,
     }
 
   g_string_append (str, param->name);
-
-  return g_string_free (str, FALSE);
 }
 
 static gchar *
-format_parameters (GtkTextIter *begin,
-                   GSList      *params)
+format_parameters (GtkTextIter     *begin,
+                   const Parameter *params,
+                   guint            n_params)
 {
   GtkTextIter line_start;
   GtkTextIter first_char;
   GString *str;
-  GSList *iter;
+  GString *join_str;
   gchar *slice;
-  gchar *join_str;
   guint max_star = 0;
   guint max_type = 0;
+  guint i;
 
-  for (iter = params; iter; iter = iter->next)
+  for (i = 0; i < n_params; i++)
     {
-      Parameter *p = iter->data;
+      const Parameter *p = &params [i];
 
       if (p->n_star)
         max_star = MAX (max_star, p->n_star);
@@ -1011,40 +901,33 @@ format_parameters (GtkTextIter *begin,
         max_type = MAX (max_type, strlen (p->type));
     }
 
-  str = g_string_new (NULL);
-
   ITER_INIT_LINE_START (&line_start, begin);
 
   gtk_text_iter_assign (&first_char, begin);
   backward_to_line_first_char (&first_char);
 
   slice = gtk_text_iter_get_slice (&line_start, &first_char);
-  str = g_string_new (",\n");
-  g_string_append (str, slice);
+  join_str = g_string_new (",\n");
+  g_string_append (join_str, slice);
   g_free (slice);
 
   while (gtk_text_iter_compare (&first_char, begin) < 0)
     {
-      g_string_append (str, " ");
+      g_string_append (join_str, " ");
       if (!gtk_text_iter_forward_char (&first_char))
         break;
     }
 
-  join_str = g_string_free (str, FALSE);
   str = g_string_new (NULL);
 
-  for (iter = params; iter; iter = iter->next)
+  for (i = 0; i < n_params; i++)
     {
-      gchar *param_str;
-
-      if (iter != params)
-        g_string_append (str, join_str);
-
-      param_str = format_parameter (iter->data, max_type, max_star);
-      g_string_append (str, param_str);
+      if (i > 0)
+        g_string_append_len (str, join_str->str, join_str->len);
+      append_parameter (str, &params [i], max_type, max_star);
     }
 
-  g_free (join_str);
+  g_string_free (join_str, TRUE);
 
   return g_string_free (str, FALSE);
 }
@@ -1056,9 +939,10 @@ maybe_align_parameters (GbSourceAutoIndenterC *c,
 {
   GtkTextIter match_begin;
   GtkTextIter copy;
-  GSList *params = NULL;
+  const Parameter *params = NULL;
   gchar *ret = NULL;
   gchar *text = NULL;
+  guint n_params = 0;
 
   ENTRY;
 
@@ -1071,18 +955,19 @@ maybe_align_parameters (GbSourceAutoIndenterC *c,
 
   gtk_text_iter_assign (&copy, begin);
 
+  /*
+   * The parameters are parsed into an arena that we keep around, so
+   * aligning long prototypes while typing does not churn the heap.
+   */
   if (gtk_text_iter_backward_char (begin) &&
       backward_find_matching_char (begin, ')') &&
       gtk_text_iter_forward_char (begin) &&
       gtk_text_iter_backward_char (end) &&
       (gtk_text_iter_compare (begin, end) < 0) &&
       (text = gtk_text_iter_get_slice (begin, end)) &&
-      (params = parse_parameters (text)) &&
-      (params->next != NULL))
-    ret = format_parameters (begin, params);
-
-  g_slist_foreach (params, (GFunc)parameter_free, NULL);
-  g_slist_free (params);
+      (params = parse_parameters_arena (c->priv->param_arena, text, &n_params)) &&
+      (n_params > 1))
+    ret = format_parameters (begin, params, n_params);
 
   if (!ret)
     {
@@ -1262,7 +1147,7 @@ maybe_unindent_case_label (GbSourceAutoIndenterC *c,
               while (g_unichar_isspace (gtk_text_iter_get_char (end)))
                 if (!gtk_text_iter_forward_char (end))
                   RETURN (NULL);
-              return g_string_free (str, FALSE);
+              RETURN (g_string_free (str, FALSE));
             }
           else
             {
@@ -1282,9 +1167,9 @@ maybe_unindent_case_label (GbSourceAutoIndenterC *c,
 
       while (g_unichar_isspace (gtk_text_iter_get_char (end)))
         if (!gtk_text_iter_forward_char (end))
-          return NULL;
+          RETURN (NULL);
 
-      return g_strdup ("");
+      RETURN (g_strdup (""));
     }
 
   RETURN (NULL);
@@ -1414,6 +1299,16 @@ gb_source_auto_indenter_c_format (GbSourceAutoIndenter *indenter,
   return ret;
 }
 
+static void
+gb_source_auto_indenter_c_finalize (GObject *object)
+{
+  GbSourceAutoIndenterCPrivate *priv = GB_SOURCE_AUTO_INDENTER_C (object)->priv;
+
+  g_clear_pointer (&priv->param_arena, parameter_arena_free);
+
+  G_OBJECT_CLASS (gb_source_auto_indenter_c_parent_class)->finalize (object);
+}
+
 static void
 gb_source_auto_indenter_c_get_property (GObject    *object,
                                         guint       prop_id,
@@ -1456,6 +1351,7 @@ gb_source_auto_indenter_c_class_init (GbSourceAutoIndenterCClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GbSourceAutoIndenterClass *indenter_class = GB_SOURCE_AUTO_INDENTER_CLASS (klass);
 
+  object_class->finalize = gb_source_auto_indenter_c_finalize;
   object_class->get_property = gb_source_auto_indenter_c_get_property;
   object_class->set_property = gb_source_auto_indenter_c_set_property;
 
@@ -1479,6 +1375,8 @@ gb_source_auto_indenter_c_init (GbSourceAutoIndenterC *c)
 {
   c->priv = gb_source_auto_indenter_c_get_instance_private (c);
 
+  c->priv->param_arena = parameter_arena_new ();
+
   c->priv->condition_indent = 2;
   c->priv->scope_indent = 2;
   c->priv->directive_indent = G_MININT;
@@ -0,0 +1,273 @@
+/* gb-source-c-line-cache.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "c-line-cache"
+
+#include "gb-source-c-line-cache.h"
+
+/*
+ * GbSourceCLineCache records the lexical state of a C buffer at the start of
+ * each line: whether we are within a c89 comment, a line comment or a
+ * string. Edits only invalidate the lines after the one that was changed,
+ * and states are recomputed lazily when they are needed.
+ *
+ * This allows the auto-indenter to lex just the current line, starting from
+ * its cached state, instead of scanning from the top of the buffer on every
+ * keystroke.
+ */
+
+struct _GbSourceCLineCache
+{
+  GtkTextBuffer *buffer;
+  GArray        *lines;
+};
+
+static void
+gb_source_c_line_state_init (GbSourceCLineState *state)
+{
+  state->comment_begin = -1;
+  state->string_quote = 0;
+  state->in_line_comment = FALSE;
+}
+
+/*
+ * Advances @state across @text, which starts at the character @offset. The
+ * lexer only needs to look ahead a single character, so @text must contain
+ * whole lines unless it ends where the caller wants the state.
+ */
+static void
+gb_source_c_line_state_lex (GbSourceCLineState *state,
+                            const gchar        *text,
+                            gint                offset)
+{
+  const gchar *iter;
+
+  for (iter = text; *iter; iter = g_utf8_next_char (iter), offset++)
+    {
+      gunichar ch = g_utf8_get_char (iter);
+      gunichar next = g_utf8_get_char (g_utf8_next_char (iter));
+
+      if (ch == '\n')
+        {
+          state->in_line_comment = FALSE;
+          state->string_quote = 0;
+          continue;
+        }
+
+      if (state->in_line_comment)
+        continue;
+
+      if (state->comment_begin != -1)
+        {
+          if ((ch == '*') && (next == '/'))
+            {
+              state->comment_begin = -1;
+              iter = g_utf8_next_char (iter);
+              offset++;
+            }
+          continue;
+        }
+
+      if (state->string_quote)
+        {
+          if (ch == '\\')
+            {
+              /* Skip the escaped character, including a line continuation. */
+              if (next != 0)
+                {
+                  iter = g_utf8_next_char (iter);
+                  offset++;
+                }
+            }
+          else if (ch == state->string_quote)
+            state->string_quote = 0;
+          continue;
+        }
+
+      switch (ch)
+        {
+        case '/':
+          if (next == '*')
+            {
+              state->comment_begin = offset;
+              iter = g_utf8_next_char (iter);
+              offset++;
+            }
+          else if (next == '/')
+            state->in_line_comment = TRUE;
+          break;
+
+        case '"':
+        case '\'':
+          state->string_quote = ch;
+          break;
+
+        default:
+          break;
+        }
+    }
+}
+
+static void
+gb_source_c_line_cache_invalidate (GbSourceCLineCache *cache,
+                                   const GtkTextIter  *location)
+{
+  guint line;
+
+  /* The state at the start of the edited line is unchanged. */
+  line = gtk_text_iter_get_line (location) + 1;
+
+  if (line < cache->lines->len)
+    g_array_set_size (cache->lines, line);
+}
+
+static void
+gb_source_c_line_cache_insert_text_cb (GtkTextBuffer      *buffer,
+                                       GtkTextIter        *location,
+                                       gchar              *text,
+                                       gint                len,
+                                       GbSourceCLineCache *cache)
+{
+  gb_source_c_line_cache_invalidate (cache, location);
+}
+
+static void
+gb_source_c_line_cache_delete_range_cb (GtkTextBuffer      *buffer,
+                                        GtkTextIter        *begin,
+                                        GtkTextIter        *end,
+                                        GbSourceCLineCache *cache)
+{
+  if (gtk_text_iter_compare (begin, end) < 0)
+    gb_source_c_line_cache_invalidate (cache, begin);
+  else
+    gb_source_c_line_cache_invalidate (cache, end);
+}
+
+static void
+gb_source_c_line_cache_free (gpointer data)
+{
+  GbSourceCLineCache *cache = data;
+
+  /* Our signal handlers are released with the buffer. */
+  g_array_unref (cache->lines);
+  g_free (cache);
+}
+
+/**
+ * gb_source_c_line_cache_get_for_buffer:
+ * @buffer: A #GtkTextBuffer.
+ *
+ * Gets the line state cache for @buffer, creating it if necessary. The cache
+ * is owned by @buffer.
+ *
+ * Returns: (transfer none): A #GbSourceCLineCache.
+ */
+GbSourceCLineCache *
+gb_source_c_line_cache_get_for_buffer (GtkTextBuffer *buffer)
+{
+  static GQuark quark;
+  GbSourceCLineCache *cache;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  if (G_UNLIKELY (!quark))
+    quark = g_quark_from_static_string ("GB_SOURCE_C_LINE_CACHE");
+
+  cache = g_object_get_qdata (G_OBJECT (buffer), quark);
+
+  if (!cache)
+    {
+      GbSourceCLineState state;
+
+      cache = g_new0 (GbSourceCLineCache, 1);
+      cache->buffer = buffer;
+      cache->lines = g_array_new (FALSE, FALSE, sizeof (GbSourceCLineState));
+
+      gb_source_c_line_state_init (&state);
+      g_array_append_val (cache->lines, state);
+
+      g_signal_connect (buffer,
+                        "insert-text",
+                        G_CALLBACK (gb_source_c_line_cache_insert_text_cb),
+                        cache);
+      g_signal_connect (buffer,
+                        "delete-range",
+                        G_CALLBACK (gb_source_c_line_cache_delete_range_cb),
+                        cache);
+
+      g_object_set_qdata_full (G_OBJECT (buffer), quark, cache,
+                               gb_source_c_line_cache_free);
+    }
+
+  return cache;
+}
+
+/**
+ * gb_source_c_line_cache_get_state:
+ * @cache: A #GbSourceCLineCache.
+ * @location: A #GtkTextIter.
+ * @state: (out): A location for the lexical state.
+ *
+ * Gets the lexical state after every character before @location. If @location
+ * is within a c89 comment, the comment_begin field will contain the offset of
+ * the opening "/" of the comment, otherwise -1.
+ */
+void
+gb_source_c_line_cache_get_state (GbSourceCLineCache *cache,
+                                  const GtkTextIter  *location,
+                                  GbSourceCLineState *state)
+{
+  GtkTextIter begin;
+  GtkTextIter end;
+  guint line;
+  gchar *text;
+
+  g_return_if_fail (cache);
+  g_return_if_fail (location);
+  g_return_if_fail (state);
+
+  line = gtk_text_iter_get_line (location);
+
+  /* Lex forward from the last valid line until we reach @location's line. */
+  while (cache->lines->len <= line)
+    {
+      GbSourceCLineState next;
+
+      next = g_array_index (cache->lines, GbSourceCLineState,
+                            cache->lines->len - 1);
+
+      gtk_text_buffer_get_iter_at_line (cache->buffer, &begin,
+                                        cache->lines->len - 1);
+      end = begin;
+      gtk_text_iter_forward_line (&end);
+
+      text = gtk_text_iter_get_slice (&begin, &end);
+      gb_source_c_line_state_lex (&next, text, gtk_text_iter_get_offset (&begin));
+      g_free (text);
+
+      g_array_append_val (cache->lines, next);
+    }
+
+  *state = g_array_index (cache->lines, GbSourceCLineState, line);
+
+  gtk_text_buffer_get_iter_at_line (cache->buffer, &begin, line);
+
+  text = gtk_text_iter_get_slice (&begin, location);
+  gb_source_c_line_state_lex (state, text, gtk_text_iter_get_offset (&begin));
+  g_free (text);
+}
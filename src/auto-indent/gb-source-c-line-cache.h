@@ -0,0 +1,42 @@
+/* gb-source-c-line-cache.h
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_SOURCE_C_LINE_CACHE_H
+#define GB_SOURCE_C_LINE_CACHE_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GbSourceCLineCache GbSourceCLineCache;
+
+typedef struct
+{
+  gint     comment_begin;
+  gunichar string_quote;
+  guint    in_line_comment : 1;
+} GbSourceCLineState;
+
+GbSourceCLineCache *gb_source_c_line_cache_get_for_buffer (GtkTextBuffer      *buffer);
+void                gb_source_c_line_cache_get_state      (GbSourceCLineCache *cache,
+                                                           const GtkTextIter  *location,
+                                                           GbSourceCLineState *state);
+
+G_END_DECLS
+
+#endif /* GB_SOURCE_C_LINE_CACHE_H */
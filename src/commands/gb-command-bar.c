@@ -348,7 +348,15 @@ gb_command_bar_complete (GbCommandBar *bar)
       if (strlen (expanded_prefix) > strlen (current_prefix))
         {
           gtk_widget_hide (GTK_WIDGET (bar->priv->completion_scroller));
-          gtk_editable_insert_text (editable, expanded_prefix + strlen (current_prefix), -1, &pos);
+          if (g_str_has_prefix (expanded_prefix, current_prefix))
+            gtk_editable_insert_text (editable, expanded_prefix + strlen (current_prefix), -1, &pos);
+          else
+            {
+              /* Fuzzy matches replace what was typed. */
+              gtk_editable_delete_text (editable, 0, pos);
+              pos = 0;
+              gtk_editable_insert_text (editable, expanded_prefix, -1, &pos);
+            }
           gtk_editable_set_position (editable, pos);
         }
       else if (g_strv_length (completions) > 1)
@@ -369,9 +377,14 @@ gb_command_bar_complete (GbCommandBar *bar)
               char *s;
 
               label = gtk_label_new ("");
-              s = g_strdup_printf ("<b>%s</b>%s", current_prefix, completions[i] + strlen (current_prefix));
-              gtk_label_set_markup (GTK_LABEL (label), s);
-              g_free (s);
+              if (g_str_has_prefix (completions[i], current_prefix))
+                {
+                  s = g_strdup_printf ("<b>%s</b>%s", current_prefix, completions[i] + strlen (current_prefix));
+                  gtk_label_set_markup (GTK_LABEL (label), s);
+                  g_free (s);
+                }
+              else
+                gtk_label_set_text (GTK_LABEL (label), completions[i]);
 
               gtk_container_add (GTK_CONTAINER (bar->priv->flow_box), label);
               gtk_widget_show (label);
@@ -23,9 +23,25 @@
 #include "gb-command-gaction-provider.h"
 #include "gb-command-gaction.h"
 #include "gb-log.h"
+#include "trie.h"
 
-G_DEFINE_TYPE (GbCommandGactionProvider, gb_command_gaction_provider,
-               GB_TYPE_COMMAND_PROVIDER)
+struct _GbCommandGactionProviderPrivate
+{
+  /*
+   * The workbench and application action groups and an index of their
+   * action names. Both are discarded when an action is added to or removed
+   * from one of them. The groups of the active view and its ancestors are
+   * not cached since the view may be destroyed or moved at any time.
+   */
+  GPtrArray      *groups;
+  Trie           *index;
+
+  GbDocumentView *view;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GbCommandGactionProvider,
+                            gb_command_gaction_provider,
+                            GB_TYPE_COMMAND_PROVIDER)
 
 GbCommandProvider *
 gb_command_gaction_provider_new (GbWorkbench *workbench)
@@ -35,17 +51,17 @@ gb_command_gaction_provider_new (GbWorkbench *workbench)
                        NULL);
 }
 
-static GList *
-discover_groups (GbCommandGactionProvider *provider)
+static GPtrArray *
+discover_view_groups (GbCommandGactionProvider *provider)
 {
   GbDocumentView *view;
-  GApplication *application;
-  GbWorkbench *workbench;
   GtkWidget *widget;
-  GList *list = NULL;
+  GPtrArray *list;
 
   g_return_val_if_fail (GB_IS_COMMAND_GACTION_PROVIDER (provider), NULL);
 
+  list = g_ptr_array_new_with_free_func (g_object_unref);
+
   view = gb_command_provider_get_active_view (GB_COMMAND_PROVIDER (provider));
 
   for (widget = GTK_WIDGET (view);
@@ -66,22 +82,151 @@ discover_groups (GbCommandGactionProvider *provider)
               group = gtk_widget_get_action_group (widget, prefixes [i]);
 
               if (G_IS_ACTION_GROUP (group))
-                list = g_list_append (list, group);
+                g_ptr_array_add (list, g_object_ref (group));
             }
 
           g_free (prefixes);
         }
     }
 
+  return list;
+}
+
+static GPtrArray *
+discover_groups (GbCommandGactionProvider *provider)
+{
+  GApplication *application;
+  GbWorkbench *workbench;
+  GPtrArray *list;
+
+  g_return_val_if_fail (GB_IS_COMMAND_GACTION_PROVIDER (provider), NULL);
+
+  list = g_ptr_array_new_with_free_func (g_object_unref);
+
   workbench = gb_command_provider_get_workbench (GB_COMMAND_PROVIDER (provider));
-  list = g_list_append (list, G_ACTION_GROUP (workbench));
+  g_ptr_array_add (list, g_object_ref (workbench));
 
   application = g_application_get_default ();
-  list = g_list_append (list, G_ACTION_GROUP (application));
+  g_ptr_array_add (list, g_object_ref (application));
 
   return list;
 }
 
+static void
+gb_command_gaction_provider_invalidate (GbCommandGactionProvider *provider);
+
+static void
+on_action_changed (GActionGroup             *group,
+                   const gchar              *action_name,
+                   GbCommandGactionProvider *provider)
+{
+  g_assert (G_IS_ACTION_GROUP (group));
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  gb_command_gaction_provider_invalidate (provider);
+}
+
+static void
+gb_command_gaction_provider_clear (GbCommandGactionProvider *provider)
+{
+  GbCommandGactionProviderPrivate *priv;
+  guint i;
+
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  priv = provider->priv;
+
+  if (priv->groups)
+    {
+      for (i = 0; i < priv->groups->len; i++)
+        g_signal_handlers_disconnect_by_func (g_ptr_array_index (priv->groups, i),
+                                              G_CALLBACK (on_action_changed),
+                                              provider);
+      g_clear_pointer (&priv->groups, g_ptr_array_unref);
+    }
+
+  g_clear_pointer (&priv->index, trie_destroy);
+}
+
+static void
+gb_command_gaction_provider_invalidate (GbCommandGactionProvider *provider)
+{
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  if (provider->priv->groups)
+    {
+      gb_command_gaction_provider_clear (provider);
+      gb_command_provider_emit_changed (GB_COMMAND_PROVIDER (provider));
+    }
+}
+
+static GPtrArray *
+gb_command_gaction_provider_get_groups (GbCommandGactionProvider *provider)
+{
+  GbCommandGactionProviderPrivate *priv;
+  guint i;
+
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  priv = provider->priv;
+
+  if (!priv->groups)
+    {
+      priv->groups = discover_groups (provider);
+
+      for (i = 0; i < priv->groups->len; i++)
+        {
+          GActionGroup *group = g_ptr_array_index (priv->groups, i);
+
+          g_signal_connect_object (group, "action-added",
+                                   G_CALLBACK (on_action_changed),
+                                   provider, 0);
+          g_signal_connect_object (group, "action-removed",
+                                   G_CALLBACK (on_action_changed),
+                                   provider, 0);
+        }
+    }
+
+  return priv->groups;
+}
+
+static Trie *
+gb_command_gaction_provider_get_index (GbCommandGactionProvider *provider)
+{
+  GbCommandGactionProviderPrivate *priv;
+  GPtrArray *groups;
+  guint i;
+  guint j;
+
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  priv = provider->priv;
+
+  if (!priv->index)
+    {
+      groups = gb_command_gaction_provider_get_groups (provider);
+      priv->index = trie_new (g_free);
+
+      for (i = 0; i < groups->len; i++)
+        {
+          gchar **names;
+
+          names = g_action_group_list_actions (g_ptr_array_index (groups, i));
+
+          for (j = 0; names [j]; j++)
+            {
+              /* Nearer groups shadow actions of the same name. */
+              if (!trie_lookup (priv->index, names [j]))
+                trie_insert (priv->index, names [j], g_strdup (names [j]));
+            }
+
+          g_strfreev (names);
+        }
+    }
+
+  return priv->index;
+}
+
 static gboolean
 parse_command_text (const gchar  *command_text,
                     gchar       **name,
@@ -141,6 +286,28 @@ failure:
   return FALSE;
 }
 
+static GbCommand *
+lookup_in_groups (GPtrArray   *groups,
+                  const gchar *action_name,
+                  GVariant    *params)
+{
+  guint i;
+
+  for (i = 0; i < groups->len; i++)
+    {
+      GActionGroup *group = g_ptr_array_index (groups, i);
+
+      if (g_action_group_has_action (group, action_name))
+        return g_object_new (GB_TYPE_COMMAND_GACTION,
+                             "action-group", group,
+                             "action-name", action_name,
+                             "parameters", params,
+                             NULL);
+    }
+
+  return NULL;
+}
+
 static GbCommand *
 gb_command_gaction_provider_lookup (GbCommandProvider *provider,
                                     const gchar       *command_text)
@@ -148,8 +315,8 @@ gb_command_gaction_provider_lookup (GbCommandProvider *provider,
   GbCommandGactionProvider *self = (GbCommandGactionProvider *)provider;
   GbCommand *command = NULL;
   GVariant *params = NULL;
-  GList *groups;
-  GList *iter;
+  GPtrArray *view_groups;
+  GPtrArray *groups;
   gchar *action_name = NULL;
 
   ENTRY;
@@ -160,74 +327,151 @@ gb_command_gaction_provider_lookup (GbCommandProvider *provider,
   if (!parse_command_text (command_text, &action_name, &params))
     RETURN (NULL);
 
-  groups = discover_groups (self);
+  view_groups = discover_view_groups (self);
+  command = lookup_in_groups (view_groups, action_name, params);
+  g_ptr_array_unref (view_groups);
 
-  for (iter = groups; iter; iter = iter->next)
+  if (!command)
     {
-      GActionGroup *group = G_ACTION_GROUP (iter->data);
-
-      if (g_action_group_has_action (group, action_name))
-        {
-          command = g_object_new (GB_TYPE_COMMAND_GACTION,
-                                  "action-group", group,
-                                  "action-name", action_name,
-                                  "parameters", params,
-                                  NULL);
-          break;
-        }
+      groups = gb_command_gaction_provider_get_groups (self);
+      command = lookup_in_groups (groups, action_name, params);
     }
 
   g_clear_pointer (&params, g_variant_unref);
-  g_list_free (groups);
   g_free (action_name);
 
   RETURN (command);
 }
 
+static gboolean
+add_completion (Trie        *trie,
+                const gchar *key,
+                gpointer     value,
+                gpointer     user_data)
+{
+  GPtrArray *completions = user_data;
+
+  g_ptr_array_add (completions, g_strdup (key));
+
+  return FALSE;
+}
+
 static void
 gb_command_gaction_provider_complete (GbCommandProvider *provider,
                                       GPtrArray         *completions,
                                       const gchar       *initial_command_text)
 {
   GbCommandGactionProvider *self = (GbCommandGactionProvider *)provider;
-  GList *groups;
-  GList *iter;
+  GPtrArray *view_groups;
+  guint i;
+  guint j;
 
   ENTRY;
 
   g_return_if_fail (GB_IS_COMMAND_GACTION_PROVIDER (self));
   g_return_if_fail (initial_command_text);
 
-  groups = discover_groups (self);
+  /* The command manager sorts and removes duplicates afterwards. */
+  view_groups = discover_view_groups (self);
 
-  for (iter = groups; iter; iter = iter->next)
+  for (i = 0; i < view_groups->len; i++)
     {
-      GActionGroup *group = iter->data;
       gchar **names;
-      guint i;
-
-      g_assert (G_IS_ACTION_GROUP (group));
 
-      names = g_action_group_list_actions (group);
+      names = g_action_group_list_actions (g_ptr_array_index (view_groups, i));
 
-      for (i = 0; names [i]; i++)
-        {
-          if (g_str_has_prefix (names [i], initial_command_text))
-            g_ptr_array_add (completions, g_strdup (names [i]));
-        }
+      for (j = 0; names [j]; j++)
+        if (g_str_has_prefix (names [j], initial_command_text))
+          g_ptr_array_add (completions, g_strdup (names [j]));
 
-      g_free (names);
+      g_strfreev (names);
     }
 
-  g_list_free (groups);
+  g_ptr_array_unref (view_groups);
+
+  trie_traverse_sorted (gb_command_gaction_provider_get_index (self),
+                        initial_command_text,
+                        G_TRAVERSE_LEAVES,
+                        -1,
+                        add_completion,
+                        completions);
 
   EXIT;
 }
 
+static void
+on_view_destroy (GbCommandGactionProvider *provider,
+                 GtkWidget                *view)
+{
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  /* Let the command manager drop completions for the view's actions. */
+  gb_command_provider_emit_changed (GB_COMMAND_PROVIDER (provider));
+}
+
+static void
+gb_command_gaction_provider_set_view (GbCommandGactionProvider *provider,
+                                      GbDocumentView           *view)
+{
+  GbCommandGactionProviderPrivate *priv;
+
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  priv = provider->priv;
+
+  if (priv->view)
+    {
+      g_signal_handlers_disconnect_by_func (priv->view,
+                                            G_CALLBACK (on_view_destroy),
+                                            provider);
+      g_object_remove_weak_pointer (G_OBJECT (priv->view),
+                                    (gpointer *)&priv->view);
+      priv->view = NULL;
+    }
+
+  if (view)
+    {
+      priv->view = view;
+      g_object_add_weak_pointer (G_OBJECT (priv->view),
+                                 (gpointer *)&priv->view);
+      g_signal_connect_object (view, "destroy",
+                               G_CALLBACK (on_view_destroy),
+                               provider, G_CONNECT_SWAPPED);
+    }
+}
+
+static void
+on_notify_active_tab (GbCommandGactionProvider *provider,
+                      GParamSpec               *pspec,
+                      gpointer                  user_data)
+{
+  GbDocumentView *view;
+
+  g_assert (GB_IS_COMMAND_GACTION_PROVIDER (provider));
+
+  view = gb_command_provider_get_active_view (GB_COMMAND_PROVIDER (provider));
+  gb_command_gaction_provider_set_view (provider, view);
+
+  gb_command_provider_emit_changed (GB_COMMAND_PROVIDER (provider));
+}
+
+static void
+gb_command_gaction_provider_finalize (GObject *object)
+{
+  gb_command_gaction_provider_set_view (GB_COMMAND_GACTION_PROVIDER (object),
+                                        NULL);
+  gb_command_gaction_provider_clear (GB_COMMAND_GACTION_PROVIDER (object));
+
+  G_OBJECT_CLASS (gb_command_gaction_provider_parent_class)->finalize (object);
+}
+
 static void
 gb_command_gaction_provider_class_init (GbCommandGactionProviderClass *klass)
 {
   GbCommandProviderClass *provider_class = GB_COMMAND_PROVIDER_CLASS (klass);
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gb_command_gaction_provider_finalize;
 
   provider_class->lookup = gb_command_gaction_provider_lookup;
   provider_class->complete = gb_command_gaction_provider_complete;
@@ -236,4 +480,10 @@ gb_command_gaction_provider_class_init (GbCommandGactionProviderClass *klass)
 static void
 gb_command_gaction_provider_init (GbCommandGactionProvider *self)
 {
+  self->priv = gb_command_gaction_provider_get_instance_private (self);
+
+  g_signal_connect (self,
+                    "notify::active-tab",
+                    G_CALLBACK (on_notify_active_tab),
+                    NULL);
 }
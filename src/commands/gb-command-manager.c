@@ -20,12 +20,22 @@
 
 #include <string.h>
 
+#include "fuzzy.h"
 #include "gb-command-manager.h"
 #include "gb-workbench.h"
 
+#define MAX_FUZZY_COMPLETIONS 50
+
 struct _GbCommandManagerPrivate
 {
   GPtrArray *providers;
+
+  /*
+   * Fuzzy index of every command the providers can complete, built the
+   * first time a prefix has no completions and discarded when a provider
+   * emits GbCommandProvider::changed.
+   */
+  Fuzzy     *fuzzy_index;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GbCommandManager, gb_command_manager, G_TYPE_OBJECT)
@@ -73,6 +83,16 @@ on_notify_priority_cb (GbCommandProvider *provider,
   g_ptr_array_sort (manager->priv->providers, provider_compare_func);
 }
 
+static void
+on_provider_changed_cb (GbCommandProvider *provider,
+                        GbCommandManager  *manager)
+{
+  g_return_if_fail (GB_IS_COMMAND_PROVIDER (provider));
+  g_return_if_fail (GB_IS_COMMAND_MANAGER (manager));
+
+  g_clear_pointer (&manager->priv->fuzzy_index, fuzzy_unref);
+}
+
 void
 gb_command_manager_add_provider (GbCommandManager  *manager,
                                  GbCommandProvider *provider)
@@ -83,6 +103,11 @@ gb_command_manager_add_provider (GbCommandManager  *manager,
   g_signal_connect_object (provider, "notify::priority",
                            G_CALLBACK (on_notify_priority_cb),
                            manager, 0);
+  g_signal_connect_object (provider, "changed",
+                           G_CALLBACK (on_provider_changed_cb),
+                           manager, 0);
+
+  g_clear_pointer (&manager->priv->fuzzy_index, fuzzy_unref);
 
   g_ptr_array_add (manager->priv->providers, g_object_ref (provider));
   g_ptr_array_sort (manager->priv->providers, provider_compare_func);
@@ -119,27 +144,115 @@ sort_strings (const gchar * const * a,
   return strcmp (*a, *b);
 }
 
+static void
+collect_completions (GbCommandManager *manager,
+                     GPtrArray        *completions,
+                     const gchar      *initial_command_text)
+{
+  guint i;
+  guint j;
+
+  g_assert (GB_IS_COMMAND_MANAGER (manager));
+  g_assert (completions);
+  g_assert (initial_command_text);
+
+  for (i = 0; i < manager->priv->providers->len; i++)
+    {
+      GbCommandProvider *provider;
+
+      provider = g_ptr_array_index (manager->priv->providers, i);
+      gb_command_provider_complete (provider, completions, initial_command_text);
+    }
+
+  g_ptr_array_sort (completions, (GCompareFunc)sort_strings);
+
+  /*
+   * Multiple providers may complete the same command. @completions has no
+   * free func, so the duplicates are freed here.
+   */
+  for (i = 0, j = 0; i < completions->len; i++)
+    {
+      gchar *str = g_ptr_array_index (completions, i);
+
+      if (j && !strcmp (str, g_ptr_array_index (completions, j - 1)))
+        g_free (str);
+      else
+        g_ptr_array_index (completions, j++) = str;
+    }
+
+  g_ptr_array_set_size (completions, j);
+}
+
+static Fuzzy *
+gb_command_manager_get_fuzzy_index (GbCommandManager *manager)
+{
+  GbCommandManagerPrivate *priv;
+  GPtrArray *all;
+  guint i;
+
+  g_assert (GB_IS_COMMAND_MANAGER (manager));
+
+  priv = manager->priv;
+
+  if (!priv->fuzzy_index)
+    {
+      all = g_ptr_array_new ();
+      collect_completions (manager, all, "");
+
+      priv->fuzzy_index = fuzzy_new (FALSE);
+      fuzzy_begin_bulk_insert (priv->fuzzy_index);
+      for (i = 0; i < all->len; i++)
+        fuzzy_insert (priv->fuzzy_index, g_ptr_array_index (all, i), NULL);
+      fuzzy_end_bulk_insert (priv->fuzzy_index);
+
+      g_ptr_array_foreach (all, (GFunc)g_free, NULL);
+      g_ptr_array_unref (all);
+    }
+
+  return priv->fuzzy_index;
+}
+
+/**
+ * gb_command_manager_complete:
+ * @manager: A #GbCommandManager.
+ * @initial_command_text: The text to complete.
+ *
+ * Completes @initial_command_text using each of the providers. If no command
+ * starts with @initial_command_text, fuzzy matches are returned instead,
+ * best match first. Otherwise the completions are sorted.
+ *
+ * Returns: (transfer full): A newly allocated string vector.
+ */
 gchar **
 gb_command_manager_complete (GbCommandManager *manager,
                              const gchar      *initial_command_text)
 {
   GPtrArray *completions;
-  int i;
+  GArray *matches;
+  guint i;
 
   g_return_val_if_fail (GB_IS_COMMAND_MANAGER (manager), NULL);
   g_return_val_if_fail (initial_command_text, NULL);
 
   completions = g_ptr_array_new ();
 
-  for (i = 0; i < manager->priv->providers->len; i++)
+  collect_completions (manager, completions, initial_command_text);
+
+  if (!completions->len && *initial_command_text)
     {
-      GbCommandProvider *provider;
+      matches = fuzzy_match (gb_command_manager_get_fuzzy_index (manager),
+                             initial_command_text,
+                             MAX_FUZZY_COMPLETIONS);
 
-      provider = g_ptr_array_index (manager->priv->providers, i);
-      gb_command_provider_complete (provider, completions, initial_command_text);
-    }
+      for (i = 0; i < matches->len; i++)
+        {
+          FuzzyMatch *match = &g_array_index (matches, FuzzyMatch, i);
 
-  g_ptr_array_sort (completions, (GCompareFunc)sort_strings);
+          g_ptr_array_add (completions, g_strdup (match->key));
+        }
+
+      g_array_unref (matches);
+    }
 
   g_ptr_array_add (completions, NULL);
 
@@ -153,6 +266,7 @@ gb_command_manager_finalize (GObject *object)
   GbCommandManagerPrivate *priv = GB_COMMAND_MANAGER (object)->priv;
 
   g_clear_pointer (&priv->providers, g_ptr_array_unref);
+  g_clear_pointer (&priv->fuzzy_index, fuzzy_unref);
 
   G_OBJECT_CLASS (gb_command_manager_parent_class)->finalize (object);
 }
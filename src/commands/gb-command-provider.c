@@ -42,6 +42,7 @@ enum {
 enum {
   LOOKUP,
   COMPLETE,
+  CHANGED,
   LAST_SIGNAL
 };
 
@@ -83,6 +84,9 @@ gb_command_provider_set_active_view (GbCommandProvider *provider,
 
   priv = provider->priv;
 
+  if (tab == priv->active_view)
+    return;
+
   if (priv->active_view)
     {
       g_object_remove_weak_pointer (G_OBJECT (priv->active_view),
@@ -252,6 +256,21 @@ gb_command_provider_complete (GbCommandProvider *provider,
   g_signal_emit (provider, gSignals [COMPLETE], 0, completions, initial_command_text);
 }
 
+/**
+ * gb_command_provider_emit_changed:
+ * @provider: (in): A #GbCommandProvider.
+ *
+ * Emits the #GbCommandProvider::changed signal. Providers should call this
+ * when the set of commands they can complete has changed.
+ */
+void
+gb_command_provider_emit_changed (GbCommandProvider *provider)
+{
+  g_return_if_fail (GB_IS_COMMAND_PROVIDER (provider));
+
+  g_signal_emit (provider, gSignals [CHANGED], 0);
+}
+
 
 static void
 gb_command_provider_get_property (GObject    *object,
@@ -407,6 +426,23 @@ gb_command_provider_class_init (GbCommandProviderClass *klass)
                   2,
                   G_TYPE_PTR_ARRAY,
                   G_TYPE_STRING);
+
+  /**
+   * GbCommandProvider::changed:
+   *
+   * This signal is emitted when the commands the provider can complete
+   * have changed, so that any index of them can be discarded.
+   */
+  gSignals [CHANGED] =
+    g_signal_new ("changed",
+                  GB_TYPE_COMMAND_PROVIDER,
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (GbCommandProviderClass, changed),
+                  NULL,
+                  NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  0);
 }
 
 static void
@@ -56,6 +56,7 @@ struct _GbCommandProviderClass
   void       (*complete) (GbCommandProvider *provider,
                           GPtrArray         *completions,
                           const gchar       *command_text);
+  void       (*changed)  (GbCommandProvider *provider);
 };
 
 GType              gb_command_provider_get_type        (void);
@@ -70,6 +71,7 @@ GbCommand         *gb_command_provider_lookup          (GbCommandProvider *provi
 void               gb_command_provider_complete        (GbCommandProvider *provider,
                                                         GPtrArray         *completions,
                                                         const gchar       *initial_command_text);
+void               gb_command_provider_emit_changed    (GbCommandProvider *provider);
 
 G_END_DECLS
 
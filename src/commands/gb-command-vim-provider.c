@@ -111,13 +111,12 @@ gb_command_vim_provider_complete (GbCommandProvider *provider,
   g_return_if_fail (completions);
   g_return_if_fail (initial_command_text);
 
-  trie_traverse (self->priv->trie,
-                 initial_command_text,
-                 G_PRE_ORDER,
-                 G_TRAVERSE_LEAVES,
-                 -1,
-                 traverse_func,
-                 completions);
+  trie_traverse_sorted (self->priv->trie,
+                        initial_command_text,
+                        G_TRAVERSE_LEAVES,
+                        -1,
+                        traverse_func,
+                        completions);
 }
 
 static void
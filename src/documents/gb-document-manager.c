@@ -26,9 +26,47 @@
 
 struct _GbDocumentManagerPrivate
 {
-  GPtrArray *documents;
+  GPtrArray  *documents;
+
+  /*
+   * Index of editor documents by location and of all documents by their
+   * exact GType, so that lookups do not need to scan every document.
+   * Entries has one IndexEntry per document. For editor documents it also
+   * tracks the location the document is currently indexed under, so that
+   * it can be moved when the location changes.
+   */
+  GHashTable *by_file;
+  GHashTable *by_type;
+  GHashTable *entries;
+
+  /*
+   * One directory monitor is shared by every open file within that
+   * directory. Events are coalesced per directory before the affected
+   * documents are asked to check for external modification.
+   */
+  GHashTable *watches;
 };
 
+typedef struct
+{
+  GbDocumentManager *manager;
+  GbDocument        *document;
+  GFile             *location;
+  gulong             handler;
+} IndexEntry;
+
+typedef struct
+{
+  GbDocumentManager *manager;
+  GFile             *directory;
+  GFileMonitor      *monitor;
+  GHashTable        *pending;
+  guint              n_files;
+  guint              flush_handler;
+} DirectoryWatch;
+
+#define WATCH_FLUSH_DELAY_MSEC 100
+
 G_DEFINE_TYPE_WITH_PRIVATE (GbDocumentManager, gb_document_manager,
                             G_TYPE_OBJECT)
 
@@ -66,19 +104,26 @@ GbDocument *
 gb_document_manager_find_with_type (GbDocumentManager *manager,
                                     GType              type)
 {
-  guint i;
+  GHashTableIter iter;
+  GPtrArray *bucket;
+  gpointer key;
 
   g_return_val_if_fail (GB_IS_DOCUMENT_MANAGER (manager), NULL);
   g_return_val_if_fail (g_type_is_a (type, GB_TYPE_DOCUMENT), NULL);
 
-  for (i = 0; i < manager->priv->documents->len; i++)
-    {
-      GbDocument *document;
-
-      document = g_ptr_array_index (manager->priv->documents, i);
+  bucket = g_hash_table_lookup (manager->priv->by_type, GSIZE_TO_POINTER (type));
+  if (bucket)
+    return g_ptr_array_index (bucket, 0);
 
-      if (g_type_is_a (G_TYPE_FROM_INSTANCE (document), type))
-        return document;
+  /*
+   * Fall back to subtypes of @type. There are only ever a handful of
+   * distinct document types, regardless of the number of documents.
+   */
+  g_hash_table_iter_init (&iter, manager->priv->by_type);
+  while (g_hash_table_iter_next (&iter, &key, (gpointer *)&bucket))
+    {
+      if (g_type_is_a (GPOINTER_TO_SIZE (key), type))
+        return g_ptr_array_index (bucket, 0);
     }
 
   return NULL;
@@ -88,31 +133,370 @@ GbDocument *
 gb_document_manager_find_with_file (GbDocumentManager *manager,
                                     GFile             *file)
 {
-  guint i;
-
   g_return_val_if_fail (GB_IS_DOCUMENT_MANAGER (manager), NULL);
   g_return_val_if_fail (G_IS_FILE (file), NULL);
 
-  for (i = 0; i < manager->priv->documents->len; i++)
+  return g_hash_table_lookup (manager->priv->by_file, file);
+}
+
+static GFile *
+gb_document_manager_get_location (GbDocument *document)
+{
+  GtkSourceFile *sfile;
+
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+
+  sfile = gb_editor_document_get_file (GB_EDITOR_DOCUMENT (document));
+
+  return gtk_source_file_get_location (sfile);
+}
+
+static void
+directory_watch_free (gpointer data)
+{
+  DirectoryWatch *watch = data;
+
+  if (watch->flush_handler)
+    g_source_remove (watch->flush_handler);
+
+  if (watch->monitor)
     {
-      GbDocument *document;
+      g_signal_handlers_disconnect_by_data (watch->monitor, watch);
+      g_file_monitor_cancel (watch->monitor);
+      g_clear_object (&watch->monitor);
+    }
 
-      document = g_ptr_array_index (manager->priv->documents, i);
+  g_clear_pointer (&watch->pending, g_hash_table_unref);
+  g_clear_object (&watch->directory);
+  g_slice_free (DirectoryWatch, watch);
+}
 
+static gboolean
+gb_document_manager_flush_watch (gpointer user_data)
+{
+  DirectoryWatch *watch = user_data;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (watch);
+
+  watch->flush_handler = 0;
+
+  g_hash_table_iter_init (&iter, watch->pending);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      GbDocument *document;
+
+      document = gb_document_manager_find_with_file (watch->manager, key);
       if (GB_IS_EDITOR_DOCUMENT (document))
+        gb_editor_document_check_externally_modified (GB_EDITOR_DOCUMENT (document));
+    }
+
+  g_hash_table_remove_all (watch->pending);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gb_document_manager_watch_changed (GFileMonitor      *monitor,
+                                   GFile             *file,
+                                   GFile             *other_file,
+                                   GFileMonitorEvent  event,
+                                   DirectoryWatch    *watch)
+{
+  g_assert (G_IS_FILE_MONITOR (monitor));
+  g_assert (watch);
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+      break;
+
+    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+    default:
+      return;
+    }
+
+  if (file && g_hash_table_contains (watch->manager->priv->by_file, file))
+    g_hash_table_add (watch->pending, g_object_ref (file));
+
+  if (other_file && g_hash_table_contains (watch->manager->priv->by_file, other_file))
+    g_hash_table_add (watch->pending, g_object_ref (other_file));
+
+  if (!watch->flush_handler && g_hash_table_size (watch->pending))
+    watch->flush_handler = g_timeout_add (WATCH_FLUSH_DELAY_MSEC,
+                                          gb_document_manager_flush_watch,
+                                          watch);
+}
+
+static void
+gb_document_manager_watch (GbDocumentManager *manager,
+                           GFile             *location)
+{
+  DirectoryWatch *watch;
+  GFile *directory;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (G_IS_FILE (location));
+
+  if (!g_file_is_native (location) || !(directory = g_file_get_parent (location)))
+    return;
+
+  watch = g_hash_table_lookup (manager->priv->watches, directory);
+
+  if (!watch)
+    {
+      GError *error = NULL;
+
+      watch = g_slice_new0 (DirectoryWatch);
+      watch->manager = manager;
+      watch->directory = g_object_ref (directory);
+      watch->pending = g_hash_table_new_full (g_file_hash,
+                                              (GEqualFunc)g_file_equal,
+                                              g_object_unref,
+                                              NULL);
+      watch->monitor = g_file_monitor_directory (directory,
+                                                 G_FILE_MONITOR_NONE,
+                                                 NULL,
+                                                 &error);
+
+      if (watch->monitor)
+        g_signal_connect (watch->monitor,
+                          "changed",
+                          G_CALLBACK (gb_document_manager_watch_changed),
+                          watch);
+      else
         {
-          GtkSourceFile *sfile;
+          g_warning ("Failed to monitor directory: %s", error->message);
+          g_clear_error (&error);
+        }
+
+      g_hash_table_insert (manager->priv->watches, watch->directory, watch);
+    }
+
+  watch->n_files++;
+
+  g_object_unref (directory);
+}
+
+/**
+ * gb_document_manager_is_watching:
+ * @manager: A #GbDocumentManager.
+ * @file: A #GFile.
+ *
+ * Checks whether external changes to @file are being monitored. This is
+ * %FALSE for non-native files and when the directory monitor could not be
+ * created, such as when the inotify watch limit has been reached. Callers
+ * should check for external modifications themselves in that case.
+ *
+ * Returns: %TRUE if @file is monitored for changes.
+ */
+gboolean
+gb_document_manager_is_watching (GbDocumentManager *manager,
+                                 GFile             *file)
+{
+  DirectoryWatch *watch;
+  GFile *directory;
+
+  g_return_val_if_fail (GB_IS_DOCUMENT_MANAGER (manager), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+  if (!g_file_is_native (file) || !(directory = g_file_get_parent (file)))
+    return FALSE;
+
+  watch = g_hash_table_lookup (manager->priv->watches, directory);
+  g_object_unref (directory);
+
+  return (watch && watch->monitor);
+}
+
+static void
+gb_document_manager_unwatch (GbDocumentManager *manager,
+                             GFile             *location)
+{
+  DirectoryWatch *watch;
+  GFile *directory;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (G_IS_FILE (location));
+
+  if (!g_file_is_native (location) || !(directory = g_file_get_parent (location)))
+    return;
+
+  watch = g_hash_table_lookup (manager->priv->watches, directory);
+
+  if (watch && !--watch->n_files)
+    g_hash_table_remove (manager->priv->watches, directory);
+
+  g_object_unref (directory);
+}
+
+static void
+gb_document_manager_unindex_location (GbDocumentManager *manager,
+                                      IndexEntry        *entry)
+{
+  guint i;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (entry);
+
+  if (!entry->location)
+    return;
+
+  gb_document_manager_unwatch (manager, entry->location);
+
+  if (g_hash_table_lookup (manager->priv->by_file, entry->location) == entry->document)
+    {
+      g_hash_table_remove (manager->priv->by_file, entry->location);
+
+      /*
+       * Another document may share the location (such as an unsaved buffer
+       * that was saved over an open file). Let it take over the slot.
+       */
+      for (i = 0; i < manager->priv->documents->len; i++)
+        {
+          GbDocument *item;
           GFile *location;
 
-          sfile = gb_editor_document_get_file (GB_EDITOR_DOCUMENT (document));
-          location = gtk_source_file_get_location (sfile);
+          item = g_ptr_array_index (manager->priv->documents, i);
+
+          if ((item == entry->document) || !GB_IS_EDITOR_DOCUMENT (item))
+            continue;
 
-          if (location && g_file_equal (location, file))
-            return document;
+          location = gb_document_manager_get_location (item);
+
+          if (location && g_file_equal (location, entry->location))
+            {
+              g_hash_table_insert (manager->priv->by_file,
+                                   g_object_ref (location), item);
+              break;
+            }
         }
     }
 
-  return NULL;
+  g_clear_object (&entry->location);
+}
+
+static void
+gb_document_manager_index_location (GbDocumentManager *manager,
+                                    IndexEntry        *entry)
+{
+  GFile *location;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (entry);
+  g_assert (!entry->location);
+
+  location = gb_document_manager_get_location (entry->document);
+
+  if (location)
+    {
+      entry->location = g_object_ref (location);
+
+      gb_document_manager_watch (manager, location);
+
+      if (!g_hash_table_contains (manager->priv->by_file, location))
+        g_hash_table_insert (manager->priv->by_file,
+                             g_object_ref (location), entry->document);
+    }
+}
+
+static void
+gb_document_manager_location_changed (GtkSourceFile *file,
+                                      GParamSpec    *pspec,
+                                      IndexEntry    *entry)
+{
+  g_assert (GTK_SOURCE_IS_FILE (file));
+  g_assert (entry);
+
+  gb_document_manager_unindex_location (entry->manager, entry);
+  gb_document_manager_index_location (entry->manager, entry);
+}
+
+static void
+gb_document_manager_index (GbDocumentManager *manager,
+                           GbDocument        *document)
+{
+  GtkSourceFile *sfile;
+  IndexEntry *entry;
+  GPtrArray *bucket;
+  GType type;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (GB_IS_DOCUMENT (document));
+
+  entry = g_slice_new0 (IndexEntry);
+  entry->manager = manager;
+  entry->document = document;
+
+  g_hash_table_insert (manager->priv->entries, document, entry);
+
+  type = G_TYPE_FROM_INSTANCE (document);
+  bucket = g_hash_table_lookup (manager->priv->by_type, GSIZE_TO_POINTER (type));
+
+  if (!bucket)
+    {
+      bucket = g_ptr_array_new ();
+      g_hash_table_insert (manager->priv->by_type, GSIZE_TO_POINTER (type),
+                           bucket);
+    }
+
+  g_ptr_array_add (bucket, document);
+
+  if (GB_IS_EDITOR_DOCUMENT (document))
+    {
+      sfile = gb_editor_document_get_file (GB_EDITOR_DOCUMENT (document));
+      entry->handler =
+        g_signal_connect (sfile,
+                          "notify::location",
+                          G_CALLBACK (gb_document_manager_location_changed),
+                          entry);
+      gb_document_manager_index_location (manager, entry);
+    }
+}
+
+static void
+gb_document_manager_unindex (GbDocumentManager *manager,
+                             GbDocument        *document)
+{
+  GtkSourceFile *sfile;
+  IndexEntry *entry;
+  GPtrArray *bucket;
+  GType type;
+
+  g_assert (GB_IS_DOCUMENT_MANAGER (manager));
+  g_assert (GB_IS_DOCUMENT (document));
+
+  if (!(entry = g_hash_table_lookup (manager->priv->entries, document)))
+    return;
+
+  g_hash_table_remove (manager->priv->entries, document);
+
+  type = G_TYPE_FROM_INSTANCE (document);
+  bucket = g_hash_table_lookup (manager->priv->by_type, GSIZE_TO_POINTER (type));
+
+  if (bucket)
+    {
+      /* Keep the bucket ordered so the oldest document is found first. */
+      g_ptr_array_remove (bucket, document);
+      if (!bucket->len)
+        g_hash_table_remove (manager->priv->by_type, GSIZE_TO_POINTER (type));
+    }
+
+  if (entry->handler)
+    {
+      sfile = gb_editor_document_get_file (GB_EDITOR_DOCUMENT (document));
+      g_signal_handler_disconnect (sfile, entry->handler);
+      gb_document_manager_unindex_location (manager, entry);
+    }
+
+  g_slice_free (IndexEntry, entry);
 }
 
 /**
@@ -187,23 +571,14 @@ void
 gb_document_manager_add (GbDocumentManager *manager,
                          GbDocument        *document)
 {
-  guint i;
-
   g_return_if_fail (GB_IS_DOCUMENT_MANAGER (manager));
   g_return_if_fail (GB_IS_DOCUMENT (document));
 
-  for (i = 0; i < manager->priv->documents->len; i++)
+  if (g_hash_table_contains (manager->priv->entries, document))
     {
-      GbDocument *item;
-
-      item = g_ptr_array_index (manager->priv->documents, i);
-
-      if (item == document)
-        {
-          g_warning ("GbDocumentManager already contains document \"%s\"",
-                     gb_document_get_title (document));
-          return;
-        }
+      g_warning ("GbDocumentManager already contains document \"%s\"",
+                 gb_document_get_title (document));
+      return;
     }
 
   g_signal_connect_object (document,
@@ -213,6 +588,7 @@ gb_document_manager_add (GbDocumentManager *manager,
                            G_CONNECT_SWAPPED);
 
   g_ptr_array_add (manager->priv->documents, g_object_ref (document));
+  gb_document_manager_index (manager, document);
 
   g_signal_emit (manager, gSignals [DOCUMENT_ADDED], 0, document);
 
@@ -223,27 +599,18 @@ void
 gb_document_manager_remove (GbDocumentManager *manager,
                             GbDocument        *document)
 {
-  guint i;
-
   g_return_if_fail (GB_IS_DOCUMENT_MANAGER (manager));
   g_return_if_fail (GB_IS_DOCUMENT (document));
 
-  for (i = 0; i < manager->priv->documents->len; i++)
+  if (g_hash_table_contains (manager->priv->entries, document))
     {
-      GbDocument *item;
-
-      item = g_ptr_array_index (manager->priv->documents, i);
-
-      if (item == document)
-        {
-          g_signal_handlers_disconnect_by_func (item,
-                                                gb_document_manager_document_modified,
-                                                manager);
-          g_ptr_array_remove_index_fast (manager->priv->documents, i);
-          g_signal_emit (manager, gSignals [DOCUMENT_REMOVED], 0, item);
-          g_object_unref (item);
-          break;
-        }
+      g_signal_handlers_disconnect_by_func (document,
+                                            gb_document_manager_document_modified,
+                                            manager);
+      g_ptr_array_remove_fast (manager->priv->documents, document);
+      gb_document_manager_unindex (manager, document);
+      g_signal_emit (manager, gSignals [DOCUMENT_REMOVED], 0, document);
+      g_object_unref (document);
     }
 
   g_object_notify_by_pspec (G_OBJECT (manager), gParamSpecs [PROP_COUNT]);
@@ -264,6 +631,10 @@ gb_document_manager_finalize (GObject *object)
     }
 
   g_clear_pointer (&priv->documents, g_ptr_array_unref);
+  g_clear_pointer (&priv->by_file, g_hash_table_unref);
+  g_clear_pointer (&priv->by_type, g_hash_table_unref);
+  g_clear_pointer (&priv->entries, g_hash_table_unref);
+  g_clear_pointer (&priv->watches, g_hash_table_unref);
 
   G_OBJECT_CLASS (gb_document_manager_parent_class)->finalize (object);
 }
@@ -349,4 +720,16 @@ gb_document_manager_init (GbDocumentManager *self)
 {
   self->priv = gb_document_manager_get_instance_private (self);
   self->priv->documents = g_ptr_array_new ();
+  self->priv->by_file = g_hash_table_new_full (g_file_hash,
+                                               (GEqualFunc)g_file_equal,
+                                               g_object_unref,
+                                               NULL);
+  self->priv->by_type = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL,
+                                               (GDestroyNotify)g_ptr_array_unref);
+  self->priv->entries = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->watches = g_hash_table_new_full (g_file_hash,
+                                               (GEqualFunc)g_file_equal,
+                                               NULL,
+                                               directory_watch_free);
 }
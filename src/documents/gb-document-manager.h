@@ -70,6 +70,8 @@ GbDocument        *gb_document_manager_find_with_file        (GbDocumentManager
                                                               GFile             *file);
 GbDocument        *gb_document_manager_find_with_type        (GbDocumentManager *manager,
                                                               GType              type);
+gboolean           gb_document_manager_is_watching           (GbDocumentManager *manager,
+                                                              GFile             *file);
 
 G_END_DECLS
 
@@ -28,8 +28,16 @@
 #include "gb-editor-view.h"
 #include "gb-log.h"
 #include "gb-gtk.h"
+#include "gb-source-language-sniffer.h"
 #include "gca-structs.h"
 
+/*
+ * Files larger than this are opened in "large file" mode. Highlighting,
+ * diffing against the VCS, code assistance and word completion are all
+ * deferred and the document starts read-only until the user opts in.
+ */
+#define LARGE_FILE_THRESHOLD (10 * 1024 * 1024)
+
 struct _GbEditorDocumentPrivate
 {
   GtkSourceFile         *file;
@@ -38,24 +46,51 @@ struct _GbEditorDocumentPrivate
   gchar                 *title;
   GCancellable          *cancellable;
   GError                *error;
+  GtkSourceLanguage     *deferred_language;
 
   gdouble                progress;
   guint                  doc_seq_id;
+  guint                  change_seq;
+  gint                   io_priority;
   GTimeVal               mtime;
+  GTimeVal               saving_mtime;
   GTimeVal               unsaved_ctime;
+  GTimeVal               sniff_mtime;
 
   guint                  file_changed_on_volume : 1;
+  guint                  file_read_only : 1;
+  guint                  defer_analysis : 1;
+  guint                  large_file : 1;
   guint                  mtime_set : 1;
+  guint                  saving_mtime_set : 1;
   guint                  read_only : 1;
+  guint                  sniff_mtime_set : 1;
   guint                  trim_trailing_whitespace : 1;
 };
 
+typedef struct
+{
+  guint line;
+  guint begin;
+  guint end;
+} TrimRange;
+
+typedef struct
+{
+  gchar    *text;
+  GArray   *lines;
+  GArray   *ranges;
+  guint     change_seq;
+  gboolean  all_lines;
+} TrimState;
+
 enum {
   PROP_0,
   PROP_CHANGE_MONITOR,
   PROP_ERROR,
   PROP_FILE,
   PROP_FILE_CHANGED_ON_VOLUME,
+  PROP_LARGE_FILE,
   PROP_MODIFIED,
   PROP_PROGRESS,
   PROP_READ_ONLY,
@@ -74,6 +109,8 @@ enum {
 
 static void gb_editor_document_init_document (GbDocumentInterface *iface);
 static void gb_editor_document_update_title  (GbEditorDocument *document);
+static void gb_editor_document_save_begin    (GbEditorDocument *document,
+                                              GTask            *task);
 
 G_DEFINE_TYPE_EXTENDED (GbEditorDocument,
                         gb_editor_document,
@@ -146,6 +183,13 @@ gb_editor_document_set_read_only (GbEditorDocument *document,
 
   g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
 
+  /*
+   * Remember what the file system told us so that we can restore it when
+   * leaving large file mode, which always forces the document read-only.
+   */
+  document->priv->file_read_only = read_only;
+  read_only = read_only || document->priv->large_file;
+
   if (document->priv->read_only != read_only)
     {
       document->priv->read_only = read_only;
@@ -201,8 +245,7 @@ gb_editor_document_check_modified_cb (GObject      *object,
 
           read_only = !g_file_info_get_attribute_boolean (info,
                                                           G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE);
-          if (gb_editor_document_get_read_only (GB_DOCUMENT (document)) != read_only)
-            gb_editor_document_set_read_only (document, read_only);
+          gb_editor_document_set_read_only (document, read_only);
         }
 
       if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) && document->priv->mtime_set)
@@ -264,6 +307,131 @@ gb_editor_document_set_progress (GbEditorDocument *document,
   g_object_notify_by_pspec (G_OBJECT (document), gParamSpecs [PROP_PROGRESS]);
 }
 
+static gboolean
+gb_editor_document_get_analysis_enabled (GbEditorDocument *document)
+{
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+
+  return !document->priv->large_file && !document->priv->defer_analysis;
+}
+
+/*
+ * Withholds or restores the pieces of the document that analyze its
+ * contents. Without a language the buffer is not highlighted and the code
+ * assistant, snippets and auto-indenter stay idle. Without a file the
+ * change monitor does not diff against the VCS.
+ */
+static void
+gb_editor_document_update_analysis (GbEditorDocument *document)
+{
+  GbEditorDocumentPrivate *priv;
+  GtkSourceLanguage *lang;
+  GFile *location;
+
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+
+  priv = document->priv;
+
+  location = gtk_source_file_get_location (priv->file);
+
+  if (!gb_editor_document_get_analysis_enabled (document))
+    {
+      lang = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (document));
+
+      if (lang)
+        {
+          g_clear_object (&priv->deferred_language);
+          priv->deferred_language = g_object_ref (lang);
+          gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (document), NULL);
+        }
+
+      gb_source_change_monitor_set_file (priv->change_monitor, NULL);
+    }
+  else
+    {
+      if ((lang = priv->deferred_language))
+        {
+          priv->deferred_language = NULL;
+          gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (document), lang);
+          g_object_unref (lang);
+        }
+
+      gb_source_change_monitor_set_file (priv->change_monitor, location);
+    }
+}
+
+gboolean
+gb_editor_document_get_large_file (GbEditorDocument *document)
+{
+  g_return_val_if_fail (GB_IS_EDITOR_DOCUMENT (document), FALSE);
+
+  return document->priv->large_file;
+}
+
+/**
+ * gb_editor_document_set_large_file:
+ * @large_file: if the document should be treated as a large file.
+ *
+ * Toggles large file mode. While enabled, the language is withheld from the
+ * buffer (which disables highlighting, code assistance, snippets and
+ * auto-indentation), the change monitor is detached and the document is
+ * read-only. Disabling it restores all of those.
+ */
+void
+gb_editor_document_set_large_file (GbEditorDocument *document,
+                                   gboolean          large_file)
+{
+  ENTRY;
+
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+
+  large_file = !!large_file;
+
+  if (document->priv->large_file == large_file)
+    EXIT;
+
+  document->priv->large_file = large_file;
+
+  gb_editor_document_update_analysis (document);
+  gb_editor_document_set_read_only (document, document->priv->file_read_only);
+
+  g_object_notify_by_pspec (G_OBJECT (document), gParamSpecs [PROP_LARGE_FILE]);
+
+  EXIT;
+}
+
+gboolean
+gb_editor_document_get_defer_analysis (GbEditorDocument *document)
+{
+  g_return_val_if_fail (GB_IS_EDITOR_DOCUMENT (document), FALSE);
+
+  return document->priv->defer_analysis;
+}
+
+/**
+ * gb_editor_document_set_defer_analysis:
+ * @defer_analysis: if analysis should be deferred.
+ *
+ * Background documents that are not yet visible can defer highlighting,
+ * code assistance and change tracking until a view is created for them.
+ * Unlike large file mode, this does not affect whether the document is
+ * read-only.
+ */
+void
+gb_editor_document_set_defer_analysis (GbEditorDocument *document,
+                                       gboolean          defer_analysis)
+{
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+
+  defer_analysis = !!defer_analysis;
+
+  if (document->priv->defer_analysis != defer_analysis)
+    {
+      document->priv->defer_analysis = defer_analysis;
+      gb_editor_document_update_analysis (document);
+    }
+}
+
 gboolean
 gb_editor_document_get_trim_trailing_whitespace (GbEditorDocument *document)
 {
@@ -342,6 +510,8 @@ gb_editor_document_changed (GtkTextBuffer *buffer)
 {
   g_assert (GB_IS_EDITOR_DOCUMENT (buffer));
 
+  GB_EDITOR_DOCUMENT (buffer)->priv->change_seq++;
+
   g_signal_emit (buffer, gSignals [CURSOR_MOVED], 0);
 
   GTK_TEXT_BUFFER_CLASS (gb_editor_document_parent_class)->changed (buffer);
@@ -567,6 +737,8 @@ gb_editor_document_trim (GbEditorDocument *document)
 
   buffer = GTK_TEXT_BUFFER (document);
 
+  gtk_text_buffer_begin_user_action (buffer);
+
   gtk_text_buffer_get_end_iter (buffer, &iter);
 
   for (line = gtk_text_iter_get_line (&iter); line >= 0; line--)
@@ -599,45 +771,220 @@ gb_editor_document_trim (GbEditorDocument *document)
         }
     }
 
+  gtk_text_buffer_end_user_action (buffer);
+
   EXIT;
 }
 
 static void
-gb_editor_document_guess_language (GbEditorDocument *document)
+trim_state_free (gpointer data)
 {
-  GtkSourceLanguageManager *manager;
-  GtkSourceLanguage *lang;
+  TrimState *state = data;
+
+  g_free (state->text);
+  g_clear_pointer (&state->lines, g_array_unref);
+  g_clear_pointer (&state->ranges, g_array_unref);
+  g_slice_free (TrimState, state);
+}
+
+/*
+ * Finds the trailing whitespace on changed lines of a text snapshot. This
+ * mirrors gb_editor_document_trim(), including leaving a final line without
+ * a line terminator alone. Lines are split with the same rules as
+ * GtkTextBuffer so that line numbers match the change monitor.
+ */
+static void
+gb_editor_document_trim_worker (GTask        *task,
+                                gpointer      source_object,
+                                gpointer      task_data,
+                                GCancellable *cancellable)
+{
+  TrimState *state = task_data;
+  const gchar *line;
+  guint next_changed = 0;
+  guint lineno;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (state);
+
+  state->ranges = g_array_new (FALSE, FALSE, sizeof (TrimRange));
+
+  for (line = state->text, lineno = 0; *line; lineno++)
+    {
+      const gchar *begin;
+      const gchar *end;
+      gint delimiter;
+      gint next;
+
+      pango_find_paragraph_boundary (line, -1, &delimiter, &next);
+
+      if (delimiter == next)
+        break;
+
+      if (!state->all_lines)
+        {
+          while ((next_changed < state->lines->len) &&
+                 (g_array_index (state->lines, guint, next_changed) < lineno))
+            next_changed++;
+
+          if (next_changed == state->lines->len)
+            break;
+
+          if (g_array_index (state->lines, guint, next_changed) != lineno)
+            goto next_line;
+        }
+
+      end = line + delimiter;
+
+      for (begin = end; begin > line; )
+        {
+          const gchar *prev = g_utf8_prev_char (begin);
+
+          if (!g_unichar_isspace (g_utf8_get_char (prev)))
+            break;
+          begin = prev;
+        }
+
+      if (begin != end)
+        {
+          TrimRange range;
+
+          range.line = lineno;
+          range.begin = g_utf8_strlen (line, begin - line);
+          range.end = range.begin + g_utf8_strlen (begin, end - begin);
+          g_array_append_val (state->ranges, range);
+        }
+
+    next_line:
+      line += next;
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+gb_editor_document_trim_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  GbEditorDocument *document = (GbEditorDocument *)object;
+  GtkTextBuffer *buffer = (GtkTextBuffer *)object;
+  TrimState *state;
+  GError *error = NULL;
+  GTask *task = user_data;
+  guint i;
+
+  ENTRY;
+
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      EXIT;
+    }
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (state->change_seq != document->priv->change_seq)
+    {
+      /* The buffer was edited while we were scanning, do it the slow way. */
+      gb_editor_document_trim (document);
+    }
+  else if (state->ranges->len)
+    {
+      gtk_text_buffer_begin_user_action (buffer);
+
+      for (i = state->ranges->len; i > 0; i--)
+        {
+          TrimRange *range = &g_array_index (state->ranges, TrimRange, i - 1);
+          GtkTextIter begin;
+          GtkTextIter end;
+
+          gtk_text_buffer_get_iter_at_line_offset (buffer, &begin,
+                                                   range->line, range->begin);
+          gtk_text_buffer_get_iter_at_line_offset (buffer, &end,
+                                                   range->line, range->end);
+          gtk_text_buffer_delete (buffer, &begin, &end);
+        }
+
+      gtk_text_buffer_end_user_action (buffer);
+    }
+
+  gb_editor_document_save_begin (document, task);
+
+  EXIT;
+}
+
+/*
+ * Trims trailing whitespace from changed lines and then continues saving.
+ * Finding the whitespace is done on a snapshot of the buffer in a worker
+ * thread; only the deletions themselves happen on the main thread.
+ */
+static void
+gb_editor_document_trim_then_save (GbEditorDocument *document,
+                                   GTask            *task)
+{
+  GTask *trim_task;
+  TrimState *state;
   GtkTextIter begin;
   GtkTextIter end;
-  gboolean result_uncertain = TRUE;
-  GFile *location;
-  gchar *name = NULL;
-  gchar *text = NULL;
-  gchar *content_type = NULL;
 
-  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+  g_assert (G_IS_TASK (task));
 
-  location = gtk_source_file_get_location (document->priv->file);
-  if (location)
-    name = g_file_get_basename (location);
+  state = g_slice_new0 (TrimState);
+  state->lines = gb_source_change_monitor_get_changed_lines (document->priv->change_monitor,
+                                                             &state->all_lines);
+
+  if (!state->all_lines && !state->lines->len)
+    {
+      trim_state_free (state);
+      gb_editor_document_save_begin (document, task);
+      return;
+    }
 
   gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (document), &begin, &end);
-  text = gtk_text_iter_get_slice (&begin, &end);
+  state->text = gtk_text_iter_get_slice (&begin, &end);
+  state->change_seq = document->priv->change_seq;
+
+  trim_task = g_task_new (document,
+                          g_task_get_cancellable (task),
+                          gb_editor_document_trim_cb,
+                          task);
+  g_task_set_task_data (trim_task, state, trim_state_free);
+  g_task_run_in_thread (trim_task, gb_editor_document_trim_worker);
+  g_object_unref (trim_task);
+}
+
+static void
+gb_editor_document_guess_language (GbEditorDocument *document)
+{
+  GtkSourceLanguage *lang;
+  const GTimeVal *mtime = NULL;
+  GFile *location;
 
-  content_type = g_content_type_guess (name,
-                                       (const guint8 *)text, strlen (text),
-                                       &result_uncertain);
-  if (result_uncertain)
-    g_clear_pointer (&content_type, g_free);
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+
+  location = gtk_source_file_get_location (document->priv->file);
 
-  manager = gtk_source_language_manager_get_default ();
-  lang = gtk_source_language_manager_guess_language (manager, name, content_type);
+  if (document->priv->sniff_mtime_set)
+    mtime = &document->priv->sniff_mtime;
 
-  gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (document), lang);
+  lang = gb_source_language_sniffer_guess (GTK_TEXT_BUFFER (document),
+                                           location, mtime);
 
-  g_free (content_type);
-  g_free (name);
-  g_free (text);
+  if (!gb_editor_document_get_analysis_enabled (document))
+    {
+      g_clear_object (&document->priv->deferred_language);
+      if (lang)
+        document->priv->deferred_language = g_object_ref (lang);
+    }
+  else
+    gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (document), lang);
 }
 
 static void
@@ -705,7 +1052,14 @@ gb_editor_document_notify_file_location (GbEditorDocument *document,
 
   gb_editor_document_update_title (document);
 
-  gb_source_change_monitor_set_file (priv->change_monitor, location);
+  /*
+   * The modification time is only known once the new file has been
+   * queried, don't let the language cache key off the previous one.
+   */
+  priv->sniff_mtime_set = FALSE;
+
+  if (gb_editor_document_get_analysis_enabled (document))
+    gb_source_change_monitor_set_file (priv->change_monitor, location);
 
   gb_editor_document_guess_language (document);
 }
@@ -842,6 +1196,10 @@ gb_editor_document_save_cb (GObject      *object,
 
   if (!gtk_source_file_saver_save_finish (saver, result, &error))
     {
+      /* Nothing was written, so the previous mtime is still valid. */
+      document->priv->mtime = document->priv->saving_mtime;
+      document->priv->mtime_set = document->priv->saving_mtime_set;
+
       gb_editor_document_set_error (document, error);
       g_task_return_error (task, error);
       GOTO (cleanup);
@@ -880,50 +1238,16 @@ cleanup:
 }
 
 static void
-gb_editor_document_save_async (GbDocument          *doc,
-                               GtkWidget           *toplevel,
-                               GCancellable        *cancellable,
-                               GAsyncReadyCallback  callback,
-                               gpointer             user_data)
+gb_editor_document_save_begin (GbEditorDocument *document,
+                               GTask            *task)
 {
   GtkSourceFileSaver *saver;
-  GbEditorDocument *document = (GbEditorDocument *)doc;
   GbEditorFileMarks *marks;
   GbEditorFileMark *mark;
   GFile *location;
-  GTask *task;
-
-  ENTRY;
-
-  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
-  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
-
-  if (!(location = gtk_source_file_get_location (document->priv->file)))
-    {
-      GFile *chosen_file;
-
-      chosen_file = gb_editor_document_prompt_save (document, toplevel);
-
-      if (!chosen_file)
-        {
-          g_task_report_new_error (document, callback, user_data,
-                                   gb_editor_document_save_async,
-                                   G_IO_ERROR,
-                                   G_IO_ERROR_NOT_FOUND,
-                                   _("No file was selected."));
-          EXIT;
-        }
-
-      location = gtk_source_file_get_location (document->priv->file);
-      g_assert (location == chosen_file);
-
-      g_clear_object (&chosen_file);
-    }
-
-  task = g_task_new (document, cancellable, callback, user_data);
 
-  if (document->priv->trim_trailing_whitespace)
-    gb_editor_document_trim (document);
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+  g_assert (G_IS_TASK (task));
 
   saver = gtk_source_file_saver_new (GTK_SOURCE_BUFFER (document),
                                      document->priv->file);
@@ -952,11 +1276,18 @@ gb_editor_document_save_async (GbDocument          *doc,
 
   gb_editor_document_set_progress (document, 0.0);
 
+  /*
+   * Our own write will show up as a change on disk. Forget the previous
+   * mtime until the save completes so it is not mistaken for an external
+   * modification. It is restored if the save fails.
+   */
+  document->priv->saving_mtime = document->priv->mtime;
+  document->priv->saving_mtime_set = document->priv->mtime_set;
   document->priv->mtime_set = FALSE;
 
   gtk_source_file_saver_save_async (saver,
                                     G_PRIORITY_DEFAULT,
-                                    cancellable,
+                                    g_task_get_cancellable (task),
                                     gb_editor_document_progress_cb,
                                     g_object_ref (document),
                                     g_object_unref,
@@ -964,6 +1295,52 @@ gb_editor_document_save_async (GbDocument          *doc,
                                     task);
 
   g_object_unref (saver);
+}
+
+static void
+gb_editor_document_save_async (GbDocument          *doc,
+                               GtkWidget           *toplevel,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  GbEditorDocument *document = (GbEditorDocument *)doc;
+  GFile *location;
+  GTask *task;
+
+  ENTRY;
+
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (!(location = gtk_source_file_get_location (document->priv->file)))
+    {
+      GFile *chosen_file;
+
+      chosen_file = gb_editor_document_prompt_save (document, toplevel);
+
+      if (!chosen_file)
+        {
+          g_task_report_new_error (document, callback, user_data,
+                                   gb_editor_document_save_async,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_NOT_FOUND,
+                                   _("No file was selected."));
+          EXIT;
+        }
+
+      location = gtk_source_file_get_location (document->priv->file);
+      g_assert (location == chosen_file);
+
+      g_clear_object (&chosen_file);
+    }
+
+  task = g_task_new (document, cancellable, callback, user_data);
+
+  if (document->priv->trim_trailing_whitespace)
+    gb_editor_document_trim_then_save (document, task);
+  else
+    gb_editor_document_save_begin (document, task);
 
   EXIT;
 }
@@ -1133,7 +1510,7 @@ gb_editor_document_load_cb (GObject      *object,
                            G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE","
                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
                            G_FILE_QUERY_INFO_NONE,
-                           G_PRIORITY_DEFAULT,
+                           document->priv->io_priority,
                            document->priv->cancellable,
                            gb_editor_document_load_info_cb,
                            g_object_ref (document));
@@ -1149,14 +1526,84 @@ cleanup:
   EXIT;
 }
 
+static void
+gb_editor_document_load_begin (GbEditorDocument *document,
+                               GTask            *task)
+{
+  GtkSourceFileLoader *loader;
+
+  g_assert (GB_IS_EDITOR_DOCUMENT (document));
+  g_assert (G_IS_TASK (task));
+
+  loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (document),
+                                       document->priv->file);
+
+  gtk_source_file_loader_load_async (loader,
+                                     document->priv->io_priority,
+                                     g_task_get_cancellable (task),
+                                     gb_editor_document_progress_cb,
+                                     g_object_ref (document),
+                                     g_object_unref,
+                                     gb_editor_document_load_cb,
+                                     task);
+
+  g_object_unref (loader);
+}
+
+static void
+gb_editor_document_load_size_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  GbEditorDocument *document;
+  GFileInfo *info;
+  GFile *file = (GFile *)object;
+  GTask *task = user_data;
+  gboolean large_file = FALSE;
+
+  ENTRY;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (G_IS_TASK (task));
+
+  document = g_task_get_source_object (task);
+
+  /*
+   * Failing to query the size is not fatal, the loader will report any
+   * real problem with the file.
+   */
+  info = g_file_query_info_finish (file, result, NULL);
+
+  if (info &&
+      g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) &&
+      g_file_info_get_size (info) > LARGE_FILE_THRESHOLD)
+    large_file = TRUE;
+
+  document->priv->sniff_mtime_set = FALSE;
+
+  if (info && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+    {
+      g_file_info_get_modification_time (info, &document->priv->sniff_mtime);
+      document->priv->sniff_mtime_set = TRUE;
+    }
+
+  gb_editor_document_set_large_file (document, large_file);
+  gb_editor_document_load_begin (document, task);
+
+  g_clear_object (&info);
+
+  EXIT;
+}
+
 void
 gb_editor_document_load_async (GbEditorDocument      *document,
                                GFile                 *file,
+                               gint                   io_priority,
                                GCancellable          *cancellable,
                                GAsyncReadyCallback    callback,
                                gpointer               user_data)
 {
-  GtkSourceFileLoader *loader;
+  GFile *location;
   GTask *task;
 
   ENTRY;
@@ -1169,22 +1616,32 @@ gb_editor_document_load_async (GbEditorDocument      *document,
 
   task = g_task_new (document, cancellable, callback, user_data);
 
-  loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (document),
-                                       document->priv->file);
+  document->priv->io_priority = io_priority;
 
   gb_editor_document_set_file_changed_on_volume (document, FALSE);
   gb_editor_document_set_progress (document, 0.0);
 
-  gtk_source_file_loader_load_async (loader,
-                                     G_PRIORITY_DEFAULT,
-                                     cancellable,
-                                     gb_editor_document_progress_cb,
-                                     g_object_ref (document),
-                                     g_object_unref,
-                                     gb_editor_document_load_cb,
-                                     task);
+  location = gtk_source_file_get_location (document->priv->file);
 
-  g_object_unref (loader);
+  if (!location)
+    {
+      gb_editor_document_load_begin (document, task);
+      EXIT;
+    }
+
+  /*
+   * Check the size up front so that we can decide on large file mode
+   * before the contents land in the buffer. The modification time keys
+   * the language detection cache.
+   */
+  g_file_query_info_async (location,
+                           G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                           G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                           G_FILE_QUERY_INFO_NONE,
+                           io_priority,
+                           cancellable,
+                           gb_editor_document_load_size_cb,
+                           task);
 
   EXIT;
 }
@@ -1217,7 +1674,8 @@ gb_editor_document_reload (GbEditorDocument *document)
       return;
     }
 
-  gb_editor_document_load_async (document, location, NULL, NULL, NULL);
+  gb_editor_document_load_async (document, location, G_PRIORITY_DEFAULT,
+                                 NULL, NULL, NULL);
 }
 
 static void
@@ -1326,6 +1784,7 @@ gb_editor_document_finalize (GObject *object)
   g_clear_object (&priv->change_monitor);
   g_clear_object (&priv->code_assistant);
   g_clear_object (&priv->cancellable);
+  g_clear_object (&priv->deferred_language);
   g_clear_pointer (&priv->title, g_free);
 
   G_OBJECT_CLASS(gb_editor_document_parent_class)->finalize (object);
@@ -1365,6 +1824,10 @@ gb_editor_document_get_property (GObject    *object,
                            gb_editor_document_get_file_changed_on_volume (self));
       break;
 
+    case PROP_LARGE_FILE:
+      g_value_set_boolean (value, gb_editor_document_get_large_file (self));
+      break;
+
     case PROP_READ_ONLY:
       g_value_set_boolean (value,
                            gb_editor_document_get_read_only (GB_DOCUMENT (self)));
@@ -1399,6 +1862,10 @@ gb_editor_document_set_property (GObject      *object,
 
   switch (prop_id)
     {
+    case PROP_LARGE_FILE:
+      gb_editor_document_set_large_file (self, g_value_get_boolean (value));
+      break;
+
     case PROP_STYLE_SCHEME_NAME:
       gb_editor_document_set_style_scheme_name (self,
                                                 g_value_get_string (value));
@@ -1471,6 +1938,15 @@ gb_editor_document_class_init (GbEditorDocumentClass *klass)
   g_object_class_install_property (object_class, PROP_FILE_CHANGED_ON_VOLUME,
                                    gParamSpecs [PROP_FILE_CHANGED_ON_VOLUME]);
 
+  gParamSpecs [PROP_LARGE_FILE] =
+    g_param_spec_boolean ("large-file",
+                          _("Large File"),
+                          _("If expensive features are deferred for a large file."),
+                          FALSE,
+                          (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_LARGE_FILE,
+                                   gParamSpecs [PROP_LARGE_FILE]);
+
   gParamSpecs [PROP_PROGRESS] =
     g_param_spec_double ("progress",
                          _("Progress"),
@@ -1540,6 +2016,7 @@ gb_editor_document_init (GbEditorDocument *document)
 
   document->priv->cancellable = g_cancellable_new ();
   document->priv->trim_trailing_whitespace = TRUE;
+  document->priv->io_priority = G_PRIORITY_DEFAULT;
   document->priv->file = gtk_source_file_new ();
   document->priv->change_monitor = gb_source_change_monitor_new (GTK_TEXT_BUFFER (document));
   document->priv->code_assistant = gb_source_code_assistant_new (GTK_TEXT_BUFFER (document));
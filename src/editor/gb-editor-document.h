@@ -65,11 +65,18 @@ gdouble                gb_editor_document_get_progress                 (GbEditor
 GbSourceChangeMonitor *gb_editor_document_get_change_monitor           (GbEditorDocument       *document);
 GbSourceCodeAssistant *gb_editor_document_get_code_assistant           (GbEditorDocument       *document);
 gboolean               gb_editor_document_get_file_changed_on_volume   (GbEditorDocument       *document);
+gboolean               gb_editor_document_get_defer_analysis           (GbEditorDocument       *document);
+void                   gb_editor_document_set_defer_analysis           (GbEditorDocument       *document,
+                                                                        gboolean                defer_analysis);
+gboolean               gb_editor_document_get_large_file               (GbEditorDocument       *document);
+void                   gb_editor_document_set_large_file               (GbEditorDocument       *document,
+                                                                        gboolean                large_file);
 gboolean               gb_editor_document_get_trim_trailing_whitespace (GbEditorDocument       *document);
 void                   gb_editor_document_set_trim_trailing_whitespace (GbEditorDocument       *document,
                                                                         gboolean                trim_trailing_whitespace);
 void                   gb_editor_document_load_async                   (GbEditorDocument       *document,
                                                                         GFile                  *file,
+                                                                        gint                    io_priority,
                                                                         GCancellable           *cancellable,
                                                                         GAsyncReadyCallback     callback,
                                                                         gpointer                user_data);
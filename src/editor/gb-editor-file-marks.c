@@ -17,18 +17,65 @@
  */
 
 #include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 #include "gb-editor-file-marks.h"
 #include "gb-string.h"
 
+/*
+ * File marks are kept in an append-only log of binary records. Each record
+ * holds the position within a file and when the mark was last used. The
+ * newest record for a uri wins. Nothing is read at startup; the log is
+ * mapped and indexed the first time a mark is requested. Once the log is
+ * mostly stale records it is compacted in a worker thread, which also
+ * evicts the least recently used marks beyond MAX_MARKS.
+ */
+
+#define FILE_MARKS_MAGIC    "GBFM"
+#define FILE_MARKS_VERSION  1
+#define MAX_MARKS           5000
+#define COMPACT_MIN_RECORDS 1024
+#define ALIGN8(n)           (((n) + 7) & ~(gsize)7)
+
+typedef struct
+{
+  gchar   magic [4];
+  guint32 version;
+} FileMarksHeader;
+
+typedef struct
+{
+  gint64  last_used;
+  guint32 line;
+  guint32 column;
+  guint32 uri_len;  /* Including the trailing \0, before padding. */
+  guint32 padding;
+} FileMarksRecord;
+
+typedef struct
+{
+  FileMarksRecord  record;
+  const gchar     *uri;
+} CompactEntry;
+
 struct _GbEditorFileMarksPrivate
 {
-  GHashTable *marks;
-  guint       save_timeout;
+  GHashTable  *marks;
+  GHashTable  *dirty;
+  GMappedFile *mapped;
+  GHashTable  *index;
+  guint        n_records;
+  guint        save_timeout;
+  guint        compacting : 1;
+  guint        loaded : 1;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GbEditorFileMarks, gb_editor_file_marks, G_TYPE_OBJECT)
 
+/* Serializes writers of the log, including compaction. */
+G_LOCK_DEFINE_STATIC (store);
+
 GbEditorFileMarks *
 gb_editor_file_marks_new (void)
 {
@@ -46,6 +93,462 @@ gb_editor_file_marks_get_default (void)
   return instance;
 }
 
+static gchar *
+gb_editor_file_marks_get_path (void)
+{
+  return g_build_filename (g_get_user_data_dir (),
+                           "gnome-builder",
+                           "file-marks.log",
+                           NULL);
+}
+
+static gchar *
+gb_editor_file_marks_get_legacy_path (void)
+{
+  return g_build_filename (g_get_user_data_dir (),
+                           "gnome-builder",
+                           "file-marks",
+                           NULL);
+}
+
+static void
+append_header (GString *str)
+{
+  FileMarksHeader header = { { 0 } };
+
+  memcpy (header.magic, FILE_MARKS_MAGIC, sizeof header.magic);
+  header.version = GUINT32_TO_LE (FILE_MARKS_VERSION);
+
+  g_string_append_len (str, (const gchar *)&header, sizeof header);
+}
+
+static gboolean
+header_is_valid (const gchar *data,
+                 gsize        len)
+{
+  FileMarksHeader header;
+
+  if (len < sizeof header)
+    return FALSE;
+
+  memcpy (&header, data, sizeof header);
+
+  return ((memcmp (header.magic, FILE_MARKS_MAGIC, sizeof header.magic) == 0) &&
+          (GUINT32_FROM_LE (header.version) == FILE_MARKS_VERSION));
+}
+
+static void
+append_record (GString     *str,
+               const gchar *uri,
+               guint        line,
+               guint        column,
+               gint64       last_used)
+{
+  FileMarksRecord record = { 0 };
+  gsize uri_len;
+  gsize i;
+
+  uri_len = strlen (uri) + 1;
+
+  record.last_used = GINT64_TO_LE (last_used);
+  record.line = GUINT32_TO_LE (line);
+  record.column = GUINT32_TO_LE (column);
+  record.uri_len = GUINT32_TO_LE (uri_len);
+
+  g_string_append_len (str, (const gchar *)&record, sizeof record);
+  g_string_append_len (str, uri, uri_len);
+
+  for (i = uri_len; i < ALIGN8 (uri_len); i++)
+    g_string_append_c (str, '\0');
+}
+
+/*
+ * Reads the record at @offset and advances @offset past it. A truncated or
+ * corrupt record, such as one left behind by a crash during an append,
+ * ends the walk.
+ */
+static gboolean
+read_record (const gchar      *data,
+             gsize             len,
+             gsize            *offset,
+             FileMarksRecord  *record,
+             const gchar     **uri)
+{
+  gsize size;
+
+  if ((*offset > len) || (len - *offset < sizeof *record))
+    return FALSE;
+
+  memcpy (record, data + *offset, sizeof *record);
+
+  record->last_used = GINT64_FROM_LE (record->last_used);
+  record->line = GUINT32_FROM_LE (record->line);
+  record->column = GUINT32_FROM_LE (record->column);
+  record->uri_len = GUINT32_FROM_LE (record->uri_len);
+
+  if ((record->uri_len < 2) || (record->uri_len > len))
+    return FALSE;
+
+  size = sizeof *record + ALIGN8 (record->uri_len);
+
+  if (size > len - *offset)
+    return FALSE;
+
+  *uri = data + *offset + sizeof *record;
+
+  if (memchr (*uri, '\0', record->uri_len) != *uri + record->uri_len - 1)
+    return FALSE;
+
+  *offset += size;
+
+  return TRUE;
+}
+
+/*
+ * Appends @bytes to the log, writing the header first if the log is new.
+ * Must be called with the store lock held.
+ */
+static gboolean
+gb_editor_file_marks_append (const gchar  *path,
+                             GBytes       *bytes,
+                             GError      **error)
+{
+  GFileOutputStream *stream;
+  GStatBuf st;
+  gboolean ret = FALSE;
+  GString *str;
+  GFile *file;
+  gchar *dir;
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0750);
+  g_free (dir);
+
+  file = g_file_new_for_path (path);
+  stream = g_file_append_to (file, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+
+  if (!stream)
+    return FALSE;
+
+  str = g_string_new (NULL);
+
+  if ((g_stat (path, &st) != 0) || (st.st_size == 0))
+    append_header (str);
+
+  g_string_append_len (str,
+                       g_bytes_get_data (bytes, NULL),
+                       g_bytes_get_size (bytes));
+
+  ret = (g_output_stream_write_all (G_OUTPUT_STREAM (stream),
+                                    str->str, str->len,
+                                    NULL, NULL, error) &&
+         g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error));
+
+  g_string_free (str, TRUE);
+  g_object_unref (stream);
+
+  return ret;
+}
+
+static gint
+compact_entry_compare (gconstpointer a,
+                       gconstpointer b)
+{
+  const CompactEntry *entry_a = *(const CompactEntry **)a;
+  const CompactEntry *entry_b = *(const CompactEntry **)b;
+
+  if (entry_a->record.last_used > entry_b->record.last_used)
+    return -1;
+  else if (entry_a->record.last_used < entry_b->record.last_used)
+    return 1;
+
+  return 0;
+}
+
+static void
+compact_entry_free (gpointer data)
+{
+  g_slice_free (CompactEntry, data);
+}
+
+static void
+gb_editor_file_marks_compact_worker (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  const gchar *path = task_data;
+  GMappedFile *mapped;
+  GHashTable *latest;
+  GPtrArray *entries;
+  const gchar *data;
+  GString *str;
+  GError *error = NULL;
+  gboolean ret;
+  gsize offset;
+  gsize len;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (path);
+
+  G_LOCK (store);
+
+  mapped = g_mapped_file_new (path, FALSE, &error);
+
+  if (!mapped)
+    {
+      G_UNLOCK (store);
+      g_task_return_error (task, error);
+      return;
+    }
+
+  data = g_mapped_file_get_contents (mapped);
+  len = g_mapped_file_get_length (mapped);
+
+  latest = g_hash_table_new (g_str_hash, g_str_equal);
+  entries = g_ptr_array_new_with_free_func (compact_entry_free);
+
+  if (header_is_valid (data, len))
+    {
+      FileMarksRecord record;
+      const gchar *uri;
+
+      offset = sizeof (FileMarksHeader);
+
+      while (read_record (data, len, &offset, &record, &uri))
+        {
+          CompactEntry *entry;
+
+          if (!(entry = g_hash_table_lookup (latest, uri)))
+            {
+              entry = g_slice_new0 (CompactEntry);
+              entry->uri = uri;
+              g_hash_table_insert (latest, (gchar *)uri, entry);
+              g_ptr_array_add (entries, entry);
+            }
+
+          entry->record = record;
+        }
+    }
+
+  g_ptr_array_sort (entries, compact_entry_compare);
+
+  if (entries->len > MAX_MARKS)
+    g_ptr_array_set_size (entries, MAX_MARKS);
+
+  str = g_string_new (NULL);
+  append_header (str);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      CompactEntry *entry = g_ptr_array_index (entries, i);
+
+      append_record (str, entry->uri, entry->record.line,
+                     entry->record.column, entry->record.last_used);
+    }
+
+  ret = g_file_set_contents (path, str->str, str->len, &error);
+
+  G_UNLOCK (store);
+
+  g_string_free (str, TRUE);
+  g_ptr_array_unref (entries);
+  g_hash_table_unref (latest);
+  g_mapped_file_unref (mapped);
+
+  if (!ret)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+gb_editor_file_marks_drop_index (GbEditorFileMarks *marks)
+{
+  GbEditorFileMarksPrivate *priv;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+
+  priv = marks->priv;
+
+  g_clear_pointer (&priv->index, g_hash_table_unref);
+  g_clear_pointer (&priv->mapped, g_mapped_file_unref);
+  priv->n_records = 0;
+}
+
+static void
+gb_editor_file_marks_compact_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  GbEditorFileMarks *marks = (GbEditorFileMarks *)object;
+  GError *error = NULL;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+  g_assert (G_IS_TASK (result));
+
+  marks->priv->compacting = FALSE;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+
+  /* The index points into the old log, map the new one on next use. */
+  gb_editor_file_marks_drop_index (marks);
+}
+
+static void
+gb_editor_file_marks_compact_async (GbEditorFileMarks *marks)
+{
+  GTask *task;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+
+  if (marks->priv->compacting)
+    return;
+
+  marks->priv->compacting = TRUE;
+
+  task = g_task_new (marks, NULL, gb_editor_file_marks_compact_cb, NULL);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_set_task_data (task, gb_editor_file_marks_get_path (), g_free);
+  g_task_run_in_thread (task, gb_editor_file_marks_compact_worker);
+  g_object_unref (task);
+}
+
+static void
+gb_editor_file_marks_maybe_compact (GbEditorFileMarks *marks)
+{
+  GbEditorFileMarksPrivate *priv;
+  guint n_live;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+
+  priv = marks->priv;
+
+  if (!priv->index)
+    return;
+
+  n_live = g_hash_table_size (priv->index);
+
+  if ((n_live > MAX_MARKS) ||
+      ((priv->n_records >= COMPACT_MIN_RECORDS) &&
+       (priv->n_records > 2 * n_live)))
+    gb_editor_file_marks_compact_async (marks);
+}
+
+static void
+gb_editor_file_marks_ensure_index (GbEditorFileMarks *marks)
+{
+  GbEditorFileMarksPrivate *priv;
+  FileMarksRecord record;
+  const gchar *data;
+  const gchar *uri;
+  gsize offset;
+  gsize len;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+
+  priv = marks->priv;
+
+  if (priv->index)
+    return;
+
+  if (!priv->loaded)
+    {
+      GError *error = NULL;
+
+      if (!gb_editor_file_marks_load (marks, &error))
+        {
+          g_warning ("%s", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  priv->index = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->n_records = 0;
+
+  if (!priv->mapped)
+    {
+      gchar *path;
+
+      path = gb_editor_file_marks_get_path ();
+      priv->mapped = g_mapped_file_new (path, FALSE, NULL);
+      g_free (path);
+
+      if (!priv->mapped)
+        return;
+    }
+
+  data = g_mapped_file_get_contents (priv->mapped);
+  len = g_mapped_file_get_length (priv->mapped);
+
+  if (!header_is_valid (data, len))
+    {
+      /* Compaction rewrites an unreadable log from scratch. */
+      if (len)
+        gb_editor_file_marks_compact_async (marks);
+      return;
+    }
+
+  offset = sizeof (FileMarksHeader);
+
+  for (;;)
+    {
+      gsize begin = offset;
+
+      if (!read_record (data, len, &offset, &record, &uri))
+        break;
+
+      g_hash_table_insert (priv->index, (gchar *)uri, GSIZE_TO_POINTER (begin));
+      priv->n_records++;
+    }
+
+  gb_editor_file_marks_maybe_compact (marks);
+}
+
+static gboolean
+gb_editor_file_marks_lookup (GbEditorFileMarks *marks,
+                             const gchar       *uri,
+                             guint             *line,
+                             guint             *column)
+{
+  GbEditorFileMarksPrivate *priv;
+  FileMarksRecord record;
+  const gchar *record_uri;
+  gpointer value;
+  gsize offset;
+
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+  g_assert (uri);
+  g_assert (line);
+  g_assert (column);
+
+  priv = marks->priv;
+
+  gb_editor_file_marks_ensure_index (marks);
+
+  if (!priv->mapped ||
+      !g_hash_table_lookup_extended (priv->index, uri, NULL, &value))
+    return FALSE;
+
+  offset = GPOINTER_TO_SIZE (value);
+
+  if (!read_record (g_mapped_file_get_contents (priv->mapped),
+                    g_mapped_file_get_length (priv->mapped),
+                    &offset, &record, &record_uri))
+    return FALSE;
+
+  *line = record.line;
+  *column = record.column;
+
+  return TRUE;
+}
+
 static gboolean
 gb_editor_file_marks_save_timeout (gpointer data)
 {
@@ -73,42 +576,37 @@ gb_editor_file_marks_queue_save (GbEditorFileMarks *marks)
 }
 
 static void
-on_mark_notify (GbEditorFileMark *mark,
-                GParamSpec       *pspec,
-                gpointer          user_data)
+gb_editor_file_marks_touch (GbEditorFileMarks *marks,
+                            GbEditorFileMark  *mark)
 {
-  GbEditorFileMarks *marks = user_data;
-
   g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
+  g_assert (GB_IS_EDITOR_FILE_MARK (mark));
+
+  if (!g_hash_table_contains (marks->priv->dirty, mark))
+    g_hash_table_add (marks->priv->dirty, g_object_ref (mark));
 
   gb_editor_file_marks_queue_save (marks);
 }
 
-static GFile *
-gb_editor_file_marks_get_file (GbEditorFileMarks *marks)
+static void
+on_mark_notify (GbEditorFileMark *mark,
+                GParamSpec       *pspec,
+                gpointer          user_data)
 {
-  gchar *path;
-  GFile *file;
-
-  g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), NULL);
+  GbEditorFileMarks *marks = user_data;
 
-  path = g_build_filename (g_get_user_data_dir (),
-                           "gnome-builder",
-                           "file-marks",
-                           NULL);
-  file = g_file_new_for_path (path);
-  g_free (path);
+  g_assert (GB_IS_EDITOR_FILE_MARKS (marks));
 
-  return file;
+  gb_editor_file_marks_touch (marks, mark);
 }
 
 /**
  * gb_editor_file_marks_get_for_file:
  *
  * Gets the #GbEditorFileMark used to represent @file. If one has not been
- * loaded, it will be created. The resulting #GbEditorFileMark is owned by
- * the #GbEditorFileMarks instance and will be saved when
- * gb_editor_file_marks_save_async() is called.
+ * loaded, it will be looked up in the store or created. The resulting
+ * #GbEditorFileMark is owned by the #GbEditorFileMarks instance and will be
+ * saved when gb_editor_file_marks_save_async() is called.
  *
  * Returns: (transfer none): A #GbEditorFileMark representing @file.
  */
@@ -124,56 +622,82 @@ gb_editor_file_marks_get_for_file (GbEditorFileMarks *marks,
 
   uri = g_file_get_uri (file);
   ret = g_hash_table_lookup (marks->priv->marks, uri);
-  g_free (uri);
 
   if (!ret)
     {
-      ret = gb_editor_file_mark_new (file, 0, 0);
-      g_hash_table_replace (marks->priv->marks, g_file_get_uri (file), ret);
+      gboolean found;
+      guint line = 0;
+      guint column = 0;
+
+      found = gb_editor_file_marks_lookup (marks, uri, &line, &column);
+
+      ret = gb_editor_file_mark_new (file, line, column);
+      g_hash_table_replace (marks->priv->marks, uri, ret);
+      uri = NULL;
       g_signal_connect_object (ret, "notify", G_CALLBACK (on_mark_notify),
                                marks, 0);
+
+      /* Refresh the last use so the mark is not evicted. */
+      if (found)
+        gb_editor_file_marks_touch (marks, ret);
     }
 
+  g_free (uri);
+
   return ret;
 }
 
+/*
+ * Serializes the marks that changed since the last save and forgets about
+ * them. Returns %NULL if there is nothing to save.
+ */
 static GBytes *
-gb_editor_file_marks_serialize (GbEditorFileMarks *marks)
+gb_editor_file_marks_serialize (GbEditorFileMarks *marks,
+                                guint             *n_records)
 {
   GbEditorFileMark *mark;
   GHashTableIter iter;
   GString *str;
+  gint64 now;
   gsize len;
   gchar *data;
 
   g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), NULL);
+  g_return_val_if_fail (n_records, NULL);
+
+  *n_records = 0;
+
+  if (!g_hash_table_size (marks->priv->dirty))
+    return NULL;
 
   str = g_string_new (NULL);
+  now = g_get_real_time () / G_USEC_PER_SEC;
 
-  g_hash_table_iter_init (&iter, marks->priv->marks);
+  g_hash_table_iter_init (&iter, marks->priv->dirty);
 
-  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&mark))
+  while (g_hash_table_iter_next (&iter, (gpointer *)&mark, NULL))
     {
-      guint line;
-      guint column;
       GFile *file;
-      gchar *uri = NULL;
-
-      g_object_get (mark,
-                    "file", &file,
-                    "line", &line,
-                    "column", &column,
-                    NULL);
+      gchar *uri;
 
-      if (!file)
+      if (!(file = gb_editor_file_mark_get_file (mark)))
         continue;
 
       uri = g_file_get_uri (file);
+      append_record (str, uri,
+                     gb_editor_file_mark_get_line (mark),
+                     gb_editor_file_mark_get_column (mark),
+                     now);
+      (*n_records)++;
+      g_free (uri);
+    }
 
-      g_string_append_printf (str, "%u:%u %s\n", line, column, uri);
+  g_hash_table_remove_all (marks->priv->dirty);
 
-      g_free (uri);
-      g_object_unref (file);
+  if (marks->priv->index)
+    {
+      marks->priv->n_records += *n_records;
+      gb_editor_file_marks_maybe_compact (marks);
     }
 
   len = str->len;
@@ -183,24 +707,31 @@ gb_editor_file_marks_serialize (GbEditorFileMarks *marks)
 }
 
 static void
-gb_editor_file_marks_save_cb (GObject      *source,
-                              GAsyncResult *result,
-                              gpointer      user_data)
+gb_editor_file_marks_save_worker (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
 {
-  GFile *file = (GFile *)source;
-  GSimpleAsyncResult *simple = user_data;
+  GBytes *bytes = task_data;
   GError *error = NULL;
+  gboolean ret;
+  gchar *path;
 
-  g_return_if_fail (G_IS_FILE (file));
-  g_return_if_fail (G_IS_ASYNC_RESULT (result));
-  g_return_if_fail (G_IS_SIMPLE_ASYNC_RESULT (simple));
+  g_assert (G_IS_TASK (task));
+  g_assert (bytes);
 
-  if (!g_file_replace_contents_finish (file, result, NULL, &error))
-    g_simple_async_result_take_error (simple, error);
-  else
-    g_simple_async_result_set_op_res_gboolean (simple, TRUE);
+  path = gb_editor_file_marks_get_path ();
+
+  G_LOCK (store);
+  ret = gb_editor_file_marks_append (path, bytes, &error);
+  G_UNLOCK (store);
+
+  g_free (path);
 
-  g_simple_async_result_complete_in_idle (simple);
+  if (!ret)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
 }
 
 void
@@ -209,31 +740,25 @@ gb_editor_file_marks_save_async (GbEditorFileMarks   *marks,
                                  GAsyncReadyCallback  callback,
                                  gpointer             user_data)
 {
-  GSimpleAsyncResult *simple;
-  GFile *file = NULL;
-  GBytes *bytes = NULL;
+  GBytes *bytes;
+  GTask *task;
+  guint n_records;
 
   g_return_if_fail (GB_IS_EDITOR_FILE_MARKS (marks));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  file = gb_editor_file_marks_get_file (marks);
-  bytes = gb_editor_file_marks_serialize (marks);
+  task = g_task_new (marks, cancellable, callback, user_data);
 
-  simple = g_simple_async_result_new (G_OBJECT (marks), callback, user_data,
-                                      gb_editor_file_marks_save_async);
-
-  g_file_replace_contents_bytes_async (file,
-                                       bytes,
-                                       NULL,
-                                       FALSE,
-                                       G_FILE_CREATE_REPLACE_DESTINATION,
-                                       cancellable,
-                                       gb_editor_file_marks_save_cb,
-                                       g_object_ref (simple));
+  if (!(bytes = gb_editor_file_marks_serialize (marks, &n_records)))
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
 
-  g_clear_object (&file);
-  g_clear_object (&simple);
-  g_clear_pointer (&bytes, g_bytes_unref);
+  g_task_set_task_data (task, bytes, (GDestroyNotify)g_bytes_unref);
+  g_task_run_in_thread (task, gb_editor_file_marks_save_worker);
+  g_object_unref (task);
 }
 
 gboolean
@@ -241,15 +766,10 @@ gb_editor_file_marks_save_finish (GbEditorFileMarks  *marks,
                                   GAsyncResult       *result,
                                   GError            **error)
 {
-  GSimpleAsyncResult *simple = (GSimpleAsyncResult *)result;
-
   g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), FALSE);
-  g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (simple), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
 
-  if (g_simple_async_result_propagate_error (simple, error))
-    return FALSE;
-
-  return TRUE;
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 gboolean
@@ -258,99 +778,135 @@ gb_editor_file_marks_save (GbEditorFileMarks  *marks,
                            GError            **error)
 {
   GBytes *bytes;
-  GFile *file;
   gboolean ret;
+  guint n_records;
+  gchar *path;
 
   g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), FALSE);
 
-  bytes = gb_editor_file_marks_serialize (marks);
-  file = gb_editor_file_marks_get_file (marks);
+  if (!(bytes = gb_editor_file_marks_serialize (marks, &n_records)))
+    return TRUE;
+
+  path = gb_editor_file_marks_get_path ();
 
-  ret = g_file_replace_contents (file,
-                                 g_bytes_get_data (bytes, NULL),
-                                 g_bytes_get_size (bytes),
-                                 NULL,
-                                 FALSE,
-                                 G_FILE_CREATE_REPLACE_DESTINATION,
-                                 NULL,
-                                 cancellable,
-                                 error);
+  G_LOCK (store);
+  ret = gb_editor_file_marks_append (path, bytes, error);
+  G_UNLOCK (store);
 
+  g_free (path);
   g_bytes_unref (bytes);
-  g_clear_object (&file);
 
   return ret;
 }
 
-gboolean
-gb_editor_file_marks_load (GbEditorFileMarks  *marks,
-                           GError            **error)
+/*
+ * Converts the "line:column uri" text file used by previous versions into
+ * the log format. This only happens once, after which the old file is
+ * removed.
+ */
+static gboolean
+gb_editor_file_marks_import_legacy (const gchar  *legacy_path,
+                                    const gchar  *path,
+                                    GError      **error)
 {
   gchar **parts = NULL;
   gchar *contents = NULL;
-  GFile *file = NULL;
-  gsize len = 0;
+  GString *str;
   gboolean ret;
+  gint64 now;
   guint i;
 
-  g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), FALSE);
+  if (!g_file_get_contents (legacy_path, &contents, NULL, error))
+    return FALSE;
 
-  file = gb_editor_file_marks_get_file (marks);
+  str = g_string_new (NULL);
+  append_header (str);
 
-  ret = g_file_load_contents (file, NULL, &contents, &len, NULL, error);
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  parts = g_strsplit (contents, "\n", -1);
 
-  if (ret)
+  for (i = 0; parts [i]; i++)
     {
-      parts = g_strsplit (contents, "\n", -1);
+      const gchar *line_str = g_strstrip (parts [i]);
+      gchar *endptr = NULL;
+      gint64 val;
+      guint line;
+      guint column;
 
-      for (i = 0; parts [i]; i++)
-        {
-          const gchar *str = g_strstrip (parts [i]);
-          GbEditorFileMark *mark;
-          gchar *endptr = NULL;
-          GFile *mark_file;
-          gint64 val;
-          guint line;
-          guint column;
-
-          val = g_ascii_strtoll (str, &endptr, 10);
-          if (((val == G_MAXINT64) || (val == G_MININT64)) && (errno == ERANGE))
-            continue;
-          line = (guint)val;
-
-          if (*endptr != ':')
-            continue;
-
-          str = ++endptr;
-
-          val = g_ascii_strtoll (str, &endptr, 10);
-          if (((val == G_MAXINT64) || (val == G_MININT64)) && (errno == ERANGE))
-            continue;
-          column = (guint)val;
-
-          if (*endptr != ' ')
-            continue;
-
-          str = ++endptr;
-
-          if (gb_str_empty0 (str))
-            continue;
-
-          mark_file = g_file_new_for_uri (str);
-          if (!mark_file)
-            continue;
-
-          mark = gb_editor_file_mark_new (mark_file, line, column);
-          g_hash_table_replace (marks->priv->marks, g_strdup (str), mark);
-          g_signal_connect_object (mark, "notify", G_CALLBACK (on_mark_notify),
-                                   marks, 0);
-          g_object_unref (mark_file);
-        }
+      val = g_ascii_strtoll (line_str, &endptr, 10);
+      if (((val == G_MAXINT64) || (val == G_MININT64)) && (errno == ERANGE))
+        continue;
+      line = (guint)val;
+
+      if (*endptr != ':')
+        continue;
+
+      line_str = ++endptr;
+
+      val = g_ascii_strtoll (line_str, &endptr, 10);
+      if (((val == G_MAXINT64) || (val == G_MININT64)) && (errno == ERANGE))
+        continue;
+      column = (guint)val;
+
+      if (*endptr != ' ')
+        continue;
+
+      line_str = ++endptr;
+
+      if (gb_str_empty0 (line_str))
+        continue;
+
+      append_record (str, line_str, line, column, now);
+    }
+
+  G_LOCK (store);
+  ret = g_file_set_contents (path, str->str, str->len, error);
+  G_UNLOCK (store);
+
+  if (ret)
+    g_unlink (legacy_path);
+
+  g_string_free (str, TRUE);
+  g_strfreev (parts);
+  g_free (contents);
+
+  return ret;
+}
+
+/**
+ * gb_editor_file_marks_load:
+ *
+ * Prepares the store for use, converting marks saved by previous versions.
+ * Marks are not read until they are requested with
+ * gb_editor_file_marks_get_for_file(), which calls this if needed, so
+ * there is no need to call it at startup.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+gb_editor_file_marks_load (GbEditorFileMarks  *marks,
+                           GError            **error)
+{
+  gchar *legacy_path;
+  gchar *path;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (GB_IS_EDITOR_FILE_MARKS (marks), FALSE);
+
+  marks->priv->loaded = TRUE;
+
+  path = gb_editor_file_marks_get_path ();
+  legacy_path = gb_editor_file_marks_get_legacy_path ();
+
+  if (!g_file_test (path, G_FILE_TEST_EXISTS) &&
+      g_file_test (legacy_path, G_FILE_TEST_EXISTS))
+    {
+      ret = gb_editor_file_marks_import_legacy (legacy_path, path, error);
+      gb_editor_file_marks_drop_index (marks);
     }
 
-  g_clear_object (&file);
-  g_clear_pointer (&parts, g_strfreev);
-  g_clear_pointer (&contents, g_free);
+  g_free (legacy_path);
+  g_free (path);
 
   return ret;
 }
@@ -361,6 +917,9 @@ gb_editor_file_marks_finalize (GObject *object)
   GbEditorFileMarksPrivate *priv = GB_EDITOR_FILE_MARKS (object)->priv;
 
   g_clear_pointer (&priv->marks, g_hash_table_unref);
+  g_clear_pointer (&priv->dirty, g_hash_table_unref);
+  g_clear_pointer (&priv->index, g_hash_table_unref);
+  g_clear_pointer (&priv->mapped, g_mapped_file_unref);
 
   if (priv->save_timeout)
     {
@@ -385,4 +944,6 @@ gb_editor_file_marks_init (GbEditorFileMarks *self)
   self->priv = gb_editor_file_marks_get_instance_private (self);
   self->priv->marks = g_hash_table_new_full (g_str_hash, g_str_equal,
                                              g_free, g_object_unref);
+  self->priv->dirty = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             g_object_unref, NULL);
 }
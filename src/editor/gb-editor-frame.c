@@ -282,10 +282,7 @@ gb_editor_frame_reformat (GbEditorFrame *self)
   GtkTextIter end;
   GtkTextIter iter;
   GtkTextMark *insert;
-  gboolean fragment = TRUE;
   GError *error = NULL;
-  gchar *input = NULL;
-  gchar *output = NULL;
   guint line_number;
   guint char_offset;
 
@@ -301,16 +298,12 @@ gb_editor_frame_reformat (GbEditorFrame *self)
 
   buffer = GTK_TEXT_BUFFER (priv->document);
 
+  /*
+   * If there is no selection, the formatter will locate the top-level block
+   * containing the cursor and only reformat that.
+   */
   gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
 
-  if (gtk_text_iter_compare (&begin, &end) == 0)
-    {
-      gtk_text_buffer_get_bounds (buffer, &begin, &end);
-      fragment = FALSE;
-    }
-
-  input = gtk_text_buffer_get_text (buffer, &begin, &end, TRUE);
-
   insert = gtk_text_buffer_get_insert (buffer);
   gtk_text_buffer_get_iter_at_mark (buffer, &iter, insert);
   char_offset = gtk_text_iter_get_line_offset (&iter);
@@ -319,25 +312,20 @@ gb_editor_frame_reformat (GbEditorFrame *self)
   language = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (buffer));
   formatter = gb_source_formatter_new_from_language (language);
 
-  if (!gb_source_formatter_format (formatter, input, fragment, NULL, &output,
-                                   &error))
+  if (!gb_source_formatter_format_range (formatter, buffer, &begin, &end,
+                                         NULL, &error))
     {
       g_warning ("%s", error->message);
       g_clear_error (&error);
       GOTO (cleanup);
     }
 
-  gtk_text_buffer_begin_user_action (buffer);
-
   /* TODO: Keep the cursor on same CXCursor from Clang instead of the
    *       same character offset within the buffer. We probably want
    *       to defer this to the formatter API since it will be language
    *       specific.
    */
 
-  gtk_text_buffer_delete (buffer, &begin, &end);
-  gtk_text_buffer_insert (buffer, &begin, output, -1);
-
   if (line_number >= gtk_text_buffer_get_line_count (buffer))
     {
       gtk_text_buffer_get_bounds (buffer, &begin, &iter);
@@ -354,14 +342,11 @@ gb_editor_frame_reformat (GbEditorFrame *self)
 
 select_range:
   gtk_text_buffer_select_range (buffer, &iter, &iter);
-  gtk_text_buffer_end_user_action (buffer);
 
   gb_gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (priv->source_view), &iter,
                                    0.25, TRUE, 0.5, 0.5);
 
 cleanup:
-  g_free (input);
-  g_free (output);
   g_clear_object (&formatter);
 
   EXIT;
@@ -634,6 +619,9 @@ gb_editor_frame_on_focus_in_event (GbEditorFrame *self,
                                    GdkEvent      *event,
                                    GbSourceView  *source_view)
 {
+  GbWorkbench *workbench;
+  GFile *location;
+
   g_return_val_if_fail (GB_IS_EDITOR_FRAME (self), FALSE);
   g_return_val_if_fail (GB_IS_SOURCE_VIEW (source_view), FALSE);
 
@@ -643,7 +631,19 @@ gb_editor_frame_on_focus_in_event (GbEditorFrame *self,
   if (gtk_source_search_context_get_highlight (self->priv->search_context))
     gtk_source_search_context_set_highlight (self->priv->search_context, FALSE);
 
-  gb_editor_document_check_externally_modified (self->priv->document);
+  /*
+   * Files are usually watched by GbDocumentManager. Remote locations may not
+   * support file monitors and creating one can fail, so fall back to
+   * checking when focused.
+   */
+  location = gtk_source_file_get_location (
+      gb_editor_document_get_file (self->priv->document));
+  workbench = gb_widget_get_workbench (GTK_WIDGET (self));
+  if (location &&
+      (!workbench ||
+       !gb_document_manager_is_watching (
+          gb_workbench_get_document_manager (workbench), location)))
+    gb_editor_document_check_externally_modified (self->priv->document);
 
   g_signal_emit (self, gSignals [FOCUSED], 0);
 
@@ -1119,6 +1119,9 @@ gb_editor_frame_constructed (GObject *object)
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_object_bind_property (vim, "busy", priv->floating_bar, "show-spinner",
+                          G_BINDING_SYNC_CREATE);
+
   g_signal_connect_object (priv->source_view,
                            "display-documentation",
                            G_CALLBACK (gb_editor_frame_on_jump_to_doc),
@@ -47,6 +47,8 @@ struct _GbEditorViewPrivate
   GtkLabel        *error_label;
   GtkButton       *error_close_button;
   GtkRevealer     *error_revealer;
+  GtkButton       *large_file_edit_button;
+  GtkRevealer     *large_file_revealer;
   GtkLabel        *modified_label;
   GtkButton       *modified_reload_button;
   GtkButton       *modified_cancel_button;
@@ -456,6 +458,27 @@ gb_editor_view_file_changed_on_volume (GbEditorView     *view,
   g_free (str);
 }
 
+static void
+gb_editor_view_notify_large_file (GbEditorView     *view,
+                                  GParamSpec       *pspec,
+                                  GbEditorDocument *document)
+{
+  g_return_if_fail (GB_IS_EDITOR_VIEW (view));
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+
+  gtk_revealer_set_reveal_child (view->priv->large_file_revealer,
+                                 gb_editor_document_get_large_file (document));
+}
+
+static void
+gb_editor_view_leave_large_file (GbEditorView *view,
+                                 GtkButton    *button)
+{
+  g_return_if_fail (GB_IS_EDITOR_VIEW (view));
+
+  gb_editor_document_set_large_file (view->priv->document, FALSE);
+}
+
 static void
 gb_editor_view_reload_document (GbEditorView *view,
                                 GtkButton    *button)
@@ -523,6 +546,12 @@ gb_editor_view_connect (GbEditorView     *view,
   g_return_if_fail (GB_IS_EDITOR_VIEW (view));
   g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
 
+  /*
+   * Documents opened in the background defer their analysis until they
+   * are first shown.
+   */
+  gb_editor_document_set_defer_analysis (document, FALSE);
+
   gb_editor_frame_set_document (view->priv->frame, document);
 
   child2 = gtk_paned_get_child2 (view->priv->paned);
@@ -571,6 +600,20 @@ gb_editor_view_connect (GbEditorView     *view,
                            view,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (document,
+                           "notify::large-file",
+                           G_CALLBACK (gb_editor_view_notify_large_file),
+                           view,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (view->priv->large_file_edit_button,
+                           "clicked",
+                           G_CALLBACK (gb_editor_view_leave_large_file),
+                           view,
+                           G_CONNECT_SWAPPED);
+
+  gb_editor_view_notify_large_file (view, NULL, document);
+
   g_object_bind_property_full (document, "language",
                                view->priv->tweak_button, "label",
                                G_BINDING_SYNC_CREATE,
@@ -599,6 +642,12 @@ gb_editor_view_disconnect (GbEditorView     *view,
   g_signal_handlers_disconnect_by_func (document,
                                         G_CALLBACK (gb_editor_view_notify_progress),
                                         view);
+  g_signal_handlers_disconnect_by_func (document,
+                                        G_CALLBACK (gb_editor_view_notify_large_file),
+                                        view);
+  g_signal_handlers_disconnect_by_func (view->priv->large_file_edit_button,
+                                        G_CALLBACK (gb_editor_view_leave_large_file),
+                                        view);
 }
 
 static GbDocument *
@@ -1006,6 +1055,8 @@ gb_editor_view_class_init (GbEditorViewClass *klass)
   GB_WIDGET_CLASS_BIND (klass, GbEditorView, error_label);
   GB_WIDGET_CLASS_BIND (klass, GbEditorView, error_revealer);
   GB_WIDGET_CLASS_BIND (klass, GbEditorView, error_close_button);
+  GB_WIDGET_CLASS_BIND (klass, GbEditorView, large_file_edit_button);
+  GB_WIDGET_CLASS_BIND (klass, GbEditorView, large_file_revealer);
 
   g_type_ensure (GB_TYPE_EDITOR_FRAME);
   g_type_ensure (GB_TYPE_EDITOR_TWEAK_WIDGET);
@@ -31,45 +31,175 @@
 #include "gb-widget.h"
 #include "gb-workbench.h"
 
+/*
+ * Number of background documents loaded at once when opening a batch of
+ * files. The focused document is always loaded immediately.
+ */
+#define MAX_BACKGROUND_LOADS 4
+
 struct _GbEditorWorkspacePrivate
 {
   GHashTable         *command_map;
   GtkPaned           *paned;
   GbDocumentGrid     *document_grid;
   gchar              *current_folder_uri;
+  GQueue             *pending_loads;
+  guint               active_loads;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GbEditorWorkspace, gb_editor_workspace,
                             GB_TYPE_WORKSPACE)
 
+static void gb_editor_workspace_load_next (GbEditorWorkspace *workspace);
+
+static void
+gb_editor_workspace_load_cb (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  GbEditorDocument *document = (GbEditorDocument *)object;
+  GbEditorWorkspace *workspace = user_data;
+  GError *error = NULL;
+
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+  g_return_if_fail (GB_IS_EDITOR_WORKSPACE (workspace));
+
+  /* Failures are surfaced by the document view through its error property. */
+  if (!gb_editor_document_load_finish (document, result, &error))
+    g_clear_error (&error);
+
+  workspace->priv->active_loads--;
+  gb_editor_workspace_load_next (workspace);
+
+  g_object_unref (workspace);
+}
+
+static void
+gb_editor_workspace_load_next (GbEditorWorkspace *workspace)
+{
+  GbEditorWorkspacePrivate *priv;
+  GbEditorDocument *document;
+
+  g_assert (GB_IS_EDITOR_WORKSPACE (workspace));
+
+  priv = workspace->priv;
+
+  while ((priv->active_loads < MAX_BACKGROUND_LOADS) &&
+         (document = g_queue_pop_head (priv->pending_loads)))
+    {
+      priv->active_loads++;
+      gb_editor_document_load_async (document, NULL, G_PRIORITY_LOW, NULL,
+                                     gb_editor_workspace_load_cb,
+                                     g_object_ref (workspace));
+      g_object_unref (document);
+    }
+}
+
+/**
+ * gb_editor_workspace_open_files:
+ * @files: (array length=n_files): The files to open.
+ * @n_files: The number of elements in @files.
+ *
+ * Opens a batch of files. Files that are already open or that are listed
+ * more than once are only opened once.
+ *
+ * The last file is focused and loaded right away. The others are loaded in
+ * the background a few at a time at a lower I/O priority, and defer their
+ * analysis (highlighting, code assistance and change tracking) until they
+ * are first shown.
+ */
 void
-gb_editor_workspace_open (GbEditorWorkspace *workspace,
-                          GFile             *file)
+gb_editor_workspace_open_files (GbEditorWorkspace  *workspace,
+                                GFile             **files,
+                                guint               n_files)
 {
   GbEditorWorkspacePrivate *priv;
   GbDocumentManager *manager;
   GbWorkbench *workbench;
-  GbDocument *document;
+  GbDocument *focus = NULL;
+  GHashTable *seen;
+  guint i;
+
+  ENTRY;
 
   g_return_if_fail (GB_IS_EDITOR_WORKSPACE (workspace));
+  g_return_if_fail (files || !n_files);
+
+  for (i = 0; i < n_files; i++)
+    g_return_if_fail (G_IS_FILE (files [i]));
+
+  if (!n_files)
+    EXIT;
 
   priv = workspace->priv;
 
   workbench = gb_widget_get_workbench (GTK_WIDGET (workspace));
   manager = gb_workbench_get_document_manager (workbench);
-  document = gb_document_manager_find_with_file (manager, file);
 
-  if (!document)
+  seen = g_hash_table_new (g_file_hash, (GEqualFunc)g_file_equal);
+
+  /*
+   * Handle the focused file first so that its load is issued before any of
+   * the background loads, then the rest in the order they were given.
+   */
+  for (i = 0; i < n_files; i++)
     {
-      document = GB_DOCUMENT (gb_editor_document_new ());
-      gb_editor_document_load_async (GB_EDITOR_DOCUMENT (document),
-                                     file, NULL, NULL, NULL);
-      gb_document_manager_add (manager, document);
-      gb_document_grid_focus_document (priv->document_grid, document);
-      g_object_unref (document);
+      gboolean is_focus = (i == 0);
+      GbDocument *document;
+      GFile *file;
+
+      file = files [is_focus ? (n_files - 1) : (i - 1)];
+
+      if (g_hash_table_contains (seen, file))
+        continue;
+      g_hash_table_add (seen, file);
+
+      document = gb_document_manager_find_with_file (manager, file);
+
+      if (!document)
+        {
+          document = GB_DOCUMENT (gb_editor_document_new ());
+
+          if (is_focus)
+            gb_editor_document_load_async (GB_EDITOR_DOCUMENT (document),
+                                           file, G_PRIORITY_DEFAULT,
+                                           NULL, NULL, NULL);
+          else
+            {
+              GtkSourceFile *sfile;
+
+              gb_editor_document_set_defer_analysis (GB_EDITOR_DOCUMENT (document),
+                                                     TRUE);
+              sfile = gb_editor_document_get_file (GB_EDITOR_DOCUMENT (document));
+              gtk_source_file_set_location (sfile, file);
+              g_queue_push_tail (priv->pending_loads, g_object_ref (document));
+            }
+
+          gb_document_manager_add (manager, document);
+          g_object_unref (document);
+        }
+
+      if (is_focus)
+        focus = document;
     }
-  else
-    gb_document_grid_focus_document (priv->document_grid, document);
+
+  g_hash_table_unref (seen);
+
+  gb_editor_workspace_load_next (workspace);
+
+  gb_document_grid_focus_document (priv->document_grid, focus);
+
+  EXIT;
+}
+
+void
+gb_editor_workspace_open (GbEditorWorkspace *workspace,
+                          GFile             *file)
+{
+  g_return_if_fail (GB_IS_EDITOR_WORKSPACE (workspace));
+  g_return_if_fail (G_IS_FILE (file));
+
+  gb_editor_workspace_open_files (workspace, &file, 1);
 }
 
 static void
@@ -178,6 +308,7 @@ gb_editor_workspace_action_open (GSimpleAction *action,
 
   if (response == GTK_RESPONSE_OK)
     {
+      GPtrArray *ar;
       GSList *files;
       GSList *iter;
       gchar *file_uri;
@@ -195,13 +326,14 @@ gb_editor_workspace_action_open (GSimpleAction *action,
       g_free (file_uri);
 
       files = gtk_file_chooser_get_files (GTK_FILE_CHOOSER (dialog));
+      ar = g_ptr_array_new_with_free_func (g_object_unref);
 
       for (iter = files; iter; iter = iter->next)
-        {
-          gb_editor_workspace_open (workspace, G_FILE (iter->data));
-          g_clear_object (&iter->data);
-        }
+        g_ptr_array_add (ar, iter->data);
+
+      gb_editor_workspace_open_files (workspace, (GFile **)ar->pdata, ar->len);
 
+      g_ptr_array_unref (ar);
       g_slist_free (files);
     }
 
@@ -248,6 +380,7 @@ gb_editor_workspace_finalize (GObject *object)
 
   g_clear_pointer (&priv->command_map, g_hash_table_unref);
   g_clear_pointer (&priv->current_folder_uri, g_free);
+  g_queue_free_full (priv->pending_loads, g_object_unref);
 
   G_OBJECT_CLASS (gb_editor_workspace_parent_class)->finalize (object);
 }
@@ -285,6 +418,7 @@ gb_editor_workspace_init (GbEditorWorkspace *workspace)
 
   workspace->priv->command_map = g_hash_table_new (g_str_hash, g_str_equal);
   workspace->priv->current_folder_uri = NULL;
+  workspace->priv->pending_loads = g_queue_new ();
 
   gtk_widget_init_template (GTK_WIDGET (workspace));
 
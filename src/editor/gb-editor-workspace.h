@@ -48,9 +48,12 @@ struct _GbEditorWorkspaceClass
   GbWorkspaceClass parent_class;
 };
 
-GType gb_editor_workspace_get_type (void);
-void  gb_editor_workspace_open     (GbEditorWorkspace *workspace,
-                                    GFile             *file);
+GType gb_editor_workspace_get_type   (void);
+void  gb_editor_workspace_open       (GbEditorWorkspace  *workspace,
+                                      GFile              *file);
+void  gb_editor_workspace_open_files (GbEditorWorkspace  *workspace,
+                                      GFile             **files,
+                                      guint               n_files);
 
 G_END_DECLS
 
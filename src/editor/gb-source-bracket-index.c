@@ -0,0 +1,520 @@
+/* gb-source-bracket-index.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "bracket-index"
+
+#include <gtksourceview/gtksource.h>
+
+#include "gb-source-bracket-index.h"
+
+/*
+ * GbSourceBracketIndex keeps track of the position of every (), [] and {}
+ * in a buffer that is not within a string or comment, along with the entry
+ * it is matched with. The index is built lazily from the start of the buffer
+ * and is truncated at the location of every insertion or deletion, so that
+ * only the text after an edit needs to be rescanned. This is a truncating
+ * cache: later entries are dropped rather than shifted, since an edit can
+ * change which brackets are within strings or comments, or how everything
+ * after it is matched. A lookup after an edit costs a scan from the edit to
+ * the bracket, and lookups without intervening edits are a binary search.
+ *
+ * Each entry records the innermost unmatched opener of the same kind at the
+ * time it was added (its parent). This lets us recover the stack of open
+ * brackets at any point with a binary search, rather than walking the buffer
+ * backwards a character at a time.
+ */
+
+#define SCAN_CHUNK_SIZE 16384
+
+typedef struct
+{
+  gint  offset;
+  gint  match;
+  gint  parent;
+  guint is_open : 1;
+} BracketEntry;
+
+enum
+{
+  BRACKET_PAREN,
+  BRACKET_SQUARE,
+  BRACKET_CURLY,
+  N_BRACKET_KINDS
+};
+
+struct _GbSourceBracketIndex
+{
+  GtkTextBuffer *buffer;
+  GArray        *entries [N_BRACKET_KINDS];
+  gint           scanned_offset;
+};
+
+#define ENTRY(entries, i) (&g_array_index ((entries), BracketEntry, (i)))
+
+static gint
+bracket_kind (gunichar  ch,
+              gboolean *is_open)
+{
+  switch (ch)
+    {
+    case '(': *is_open = TRUE;  return BRACKET_PAREN;
+    case ')': *is_open = FALSE; return BRACKET_PAREN;
+    case '[': *is_open = TRUE;  return BRACKET_SQUARE;
+    case ']': *is_open = FALSE; return BRACKET_SQUARE;
+    case '{': *is_open = TRUE;  return BRACKET_CURLY;
+    case '}': *is_open = FALSE; return BRACKET_CURLY;
+    default:
+      return -1;
+    }
+}
+
+/*
+ * Returns the index of the first entry at or after @offset.
+ */
+static guint
+entries_lower_bound (GArray *entries,
+                     gint    offset)
+{
+  guint lo = 0;
+  guint hi = entries->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (ENTRY (entries, mid)->offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+/*
+ * Returns the innermost unmatched opener after the entry at @i has been
+ * applied, or -1.
+ */
+static gint
+entries_top_after (GArray *entries,
+                   gint    i)
+{
+  BracketEntry *entry;
+
+  if (i < 0)
+    return -1;
+
+  entry = ENTRY (entries, i);
+
+  if (entry->is_open)
+    return i;
+
+  if (entry->match < 0)
+    return -1;
+
+  return ENTRY (entries, entry->match)->parent;
+}
+
+static void
+entries_add (GArray   *entries,
+             gint      offset,
+             gboolean  is_open)
+{
+  BracketEntry entry;
+  gint top;
+
+  top = entries_top_after (entries, (gint)entries->len - 1);
+
+  entry.offset = offset;
+  entry.is_open = !!is_open;
+
+  if (is_open)
+    {
+      entry.match = -1;
+      entry.parent = top;
+    }
+  else
+    {
+      entry.match = top;
+      entry.parent = -1;
+      if (top >= 0)
+        ENTRY (entries, top)->match = entries->len;
+    }
+
+  g_array_append_val (entries, entry);
+}
+
+static void
+gb_source_bracket_index_truncate (GbSourceBracketIndex *index,
+                                  gint                  offset)
+{
+  guint kind;
+
+  for (kind = 0; kind < N_BRACKET_KINDS; kind++)
+    {
+      GArray *entries = index->entries [kind];
+      guint len;
+      gint i;
+
+      len = entries_lower_bound (entries, offset);
+      if (len == entries->len)
+        continue;
+
+      g_array_set_size (entries, len);
+
+      /*
+       * Openers that were matched by a closer we just removed are open
+       * again. They are exactly the chain of parents at the new end.
+       */
+      for (i = entries_top_after (entries, (gint)len - 1);
+           i >= 0;
+           i = ENTRY (entries, i)->parent)
+        ENTRY (entries, i)->match = -1;
+    }
+
+  index->scanned_offset = MIN (index->scanned_offset, offset);
+}
+
+static void
+gb_source_bracket_index_scan_text (GbSourceBracketIndex *index,
+                                   const GtkTextIter    *begin,
+                                   const GtkTextIter    *end)
+{
+  const gchar *iter;
+  gchar *text;
+  gint offset;
+
+  /* Slices keep a placeholder for embedded objects, so offsets stay valid. */
+  text = gtk_text_iter_get_slice (begin, end);
+  offset = gtk_text_iter_get_offset (begin);
+
+  for (iter = text; *iter; iter = g_utf8_next_char (iter), offset++)
+    {
+      gboolean is_open;
+      gint kind;
+
+      if ((kind = bracket_kind (*iter, &is_open)) >= 0)
+        entries_add (index->entries [kind], offset, is_open);
+    }
+
+  g_free (text);
+}
+
+static gboolean
+iter_in_ignored_context (GtkSourceBuffer   *buffer,
+                         const GtkTextIter *iter,
+                         const gchar      **context_class)
+{
+  if (gtk_source_buffer_iter_has_context_class (buffer, iter, "comment"))
+    *context_class = "comment";
+  else if (gtk_source_buffer_iter_has_context_class (buffer, iter, "string"))
+    *context_class = "string";
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Extends the index so that it covers all text before @target.
+ */
+static void
+gb_source_bracket_index_scan (GbSourceBracketIndex *index,
+                              gint                  target)
+{
+  GtkSourceBuffer *source_buffer = NULL;
+  GtkTextIter begin;
+  GtkTextIter limit;
+
+  target = MIN (target, gtk_text_buffer_get_char_count (index->buffer));
+
+  if (index->scanned_offset >= target)
+    return;
+
+  gtk_text_buffer_get_iter_at_offset (index->buffer, &begin,
+                                      index->scanned_offset);
+  gtk_text_buffer_get_iter_at_offset (index->buffer, &limit, target);
+
+  if (GTK_SOURCE_IS_BUFFER (index->buffer))
+    {
+      source_buffer = GTK_SOURCE_BUFFER (index->buffer);
+      gtk_source_buffer_ensure_highlight (source_buffer, &begin, &limit);
+    }
+
+  while (gtk_text_iter_compare (&begin, &limit) < 0)
+    {
+      const gchar *context_class = NULL;
+      GtkTextIter end = begin;
+
+      if (!source_buffer)
+        {
+          end = limit;
+          gb_source_bracket_index_scan_text (index, &begin, &end);
+        }
+      else if (iter_in_ignored_context (source_buffer, &begin, &context_class))
+        {
+          /* Skip past the string or comment. */
+          if (!gtk_source_buffer_iter_forward_to_context_class_toggle (source_buffer,
+                                                                       &end,
+                                                                       context_class))
+            end = limit;
+
+          /* Highlighting past @limit may not be up to date. */
+          if (gtk_text_iter_compare (&end, &limit) > 0)
+            end = limit;
+        }
+      else
+        {
+          GtkTextIter comment = begin;
+          GtkTextIter string = begin;
+
+          /* Scan up to the start of the next string or comment. */
+          if (!gtk_source_buffer_iter_forward_to_context_class_toggle (source_buffer,
+                                                                       &comment,
+                                                                       "comment"))
+            comment = limit;
+          if (!gtk_source_buffer_iter_forward_to_context_class_toggle (source_buffer,
+                                                                       &string,
+                                                                       "string"))
+            string = limit;
+
+          end = (gtk_text_iter_compare (&comment, &string) < 0) ? comment : string;
+
+          if (gtk_text_iter_compare (&end, &limit) > 0)
+            end = limit;
+
+          gb_source_bracket_index_scan_text (index, &begin, &end);
+        }
+
+      if (gtk_text_iter_compare (&end, &begin) <= 0)
+        {
+          end = begin;
+          gtk_text_iter_forward_char (&end);
+        }
+
+      begin = end;
+    }
+
+  index->scanned_offset = target;
+}
+
+static void
+gb_source_bracket_index_insert_text_cb (GtkTextBuffer        *buffer,
+                                        GtkTextIter          *location,
+                                        gchar                *text,
+                                        gint                  len,
+                                        GbSourceBracketIndex *index)
+{
+  gb_source_bracket_index_truncate (index, gtk_text_iter_get_offset (location));
+}
+
+static void
+gb_source_bracket_index_delete_range_cb (GtkTextBuffer        *buffer,
+                                         GtkTextIter          *begin,
+                                         GtkTextIter          *end,
+                                         GbSourceBracketIndex *index)
+{
+  gb_source_bracket_index_truncate (index,
+                                    MIN (gtk_text_iter_get_offset (begin),
+                                         gtk_text_iter_get_offset (end)));
+}
+
+static void
+gb_source_bracket_index_notify_language_cb (GtkSourceBuffer      *buffer,
+                                            GParamSpec           *pspec,
+                                            GbSourceBracketIndex *index)
+{
+  /* Strings and comments may be found in different places now. */
+  gb_source_bracket_index_truncate (index, 0);
+}
+
+static void
+gb_source_bracket_index_free (gpointer data)
+{
+  GbSourceBracketIndex *index = data;
+  guint kind;
+
+  /* Our signal handlers are released with the buffer. */
+  for (kind = 0; kind < N_BRACKET_KINDS; kind++)
+    g_array_unref (index->entries [kind]);
+
+  g_free (index);
+}
+
+/**
+ * gb_source_bracket_index_get_for_buffer:
+ * @buffer: A #GtkTextBuffer.
+ *
+ * Gets the bracket index for @buffer, creating it if necessary. The index is
+ * owned by @buffer.
+ *
+ * Returns: (transfer none): A #GbSourceBracketIndex.
+ */
+GbSourceBracketIndex *
+gb_source_bracket_index_get_for_buffer (GtkTextBuffer *buffer)
+{
+  static GQuark quark;
+  GbSourceBracketIndex *index;
+  guint kind;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  if (G_UNLIKELY (!quark))
+    quark = g_quark_from_static_string ("GB_SOURCE_BRACKET_INDEX");
+
+  index = g_object_get_qdata (G_OBJECT (buffer), quark);
+
+  if (!index)
+    {
+      index = g_new0 (GbSourceBracketIndex, 1);
+      index->buffer = buffer;
+
+      for (kind = 0; kind < N_BRACKET_KINDS; kind++)
+        index->entries [kind] = g_array_new (FALSE, FALSE, sizeof (BracketEntry));
+
+      g_signal_connect (buffer,
+                        "insert-text",
+                        G_CALLBACK (gb_source_bracket_index_insert_text_cb),
+                        index);
+      g_signal_connect (buffer,
+                        "delete-range",
+                        G_CALLBACK (gb_source_bracket_index_delete_range_cb),
+                        index);
+
+      if (GTK_SOURCE_IS_BUFFER (buffer))
+        {
+          g_signal_connect (buffer,
+                            "notify::language",
+                            G_CALLBACK (gb_source_bracket_index_notify_language_cb),
+                            index);
+          g_signal_connect (buffer,
+                            "notify::highlight-syntax",
+                            G_CALLBACK (gb_source_bracket_index_notify_language_cb),
+                            index);
+        }
+
+      g_object_set_qdata_full (G_OBJECT (buffer), quark, index,
+                               gb_source_bracket_index_free);
+    }
+
+  return index;
+}
+
+/**
+ * gb_source_bracket_index_find_match:
+ * @index: A #GbSourceBracketIndex.
+ * @location: A #GtkTextIter pointing at a bracket.
+ * @match: (out): A location for the matching bracket.
+ *
+ * Locates the bracket matching the one at @location.
+ *
+ * Returns: %TRUE if @match was set. %FALSE if there is no bracket at
+ *   @location, it is within a string or comment, or it is unmatched.
+ */
+gboolean
+gb_source_bracket_index_find_match (GbSourceBracketIndex *index,
+                                    const GtkTextIter    *location,
+                                    GtkTextIter          *match)
+{
+  GArray *entries;
+  gboolean is_open;
+  gint char_count;
+  gint offset;
+  gint kind;
+  guint i;
+
+  g_return_val_if_fail (index, FALSE);
+  g_return_val_if_fail (location, FALSE);
+  g_return_val_if_fail (match, FALSE);
+
+  kind = bracket_kind (gtk_text_iter_get_char (location), &is_open);
+  if (kind < 0)
+    return FALSE;
+
+  offset = gtk_text_iter_get_offset (location);
+  gb_source_bracket_index_scan (index, offset + 1);
+
+  entries = index->entries [kind];
+  i = entries_lower_bound (entries, offset);
+
+  if ((i >= entries->len) || (ENTRY (entries, i)->offset != offset))
+    return FALSE;
+
+  /* Keep extending the index until the opener has been closed. */
+  char_count = gtk_text_buffer_get_char_count (index->buffer);
+  while (is_open &&
+         (ENTRY (entries, i)->match < 0) &&
+         (index->scanned_offset < char_count))
+    gb_source_bracket_index_scan (index, index->scanned_offset + SCAN_CHUNK_SIZE);
+
+  if (ENTRY (entries, i)->match < 0)
+    return FALSE;
+
+  gtk_text_buffer_get_iter_at_offset (index->buffer, match,
+                                      ENTRY (entries, ENTRY (entries, i)->match)->offset);
+
+  return TRUE;
+}
+
+/**
+ * gb_source_bracket_index_find_enclosing:
+ * @index: A #GbSourceBracketIndex.
+ * @location: A #GtkTextIter.
+ * @open_char: The opening bracket to locate, such as '{'.
+ * @match: (out): A location for the opening bracket.
+ *
+ * Locates the innermost @open_char before @location that has not been closed
+ * before @location. This is the bracket that a closing bracket inserted at
+ * @location would match.
+ *
+ * Returns: %TRUE if @match was set.
+ */
+gboolean
+gb_source_bracket_index_find_enclosing (GbSourceBracketIndex *index,
+                                        const GtkTextIter    *location,
+                                        gunichar              open_char,
+                                        GtkTextIter          *match)
+{
+  GArray *entries;
+  gboolean is_open;
+  gint offset;
+  gint kind;
+  gint top;
+
+  g_return_val_if_fail (index, FALSE);
+  g_return_val_if_fail (location, FALSE);
+  g_return_val_if_fail (match, FALSE);
+
+  kind = bracket_kind (open_char, &is_open);
+  g_return_val_if_fail (kind >= 0, FALSE);
+
+  offset = gtk_text_iter_get_offset (location);
+  gb_source_bracket_index_scan (index, offset);
+
+  entries = index->entries [kind];
+  top = entries_top_after (entries,
+                           (gint)entries_lower_bound (entries, offset) - 1);
+
+  if (top < 0)
+    return FALSE;
+
+  gtk_text_buffer_get_iter_at_offset (index->buffer, match,
+                                      ENTRY (entries, top)->offset);
+
+  return TRUE;
+}
@@ -0,0 +1,39 @@
+/* gb-source-bracket-index.h
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_SOURCE_BRACKET_INDEX_H
+#define GB_SOURCE_BRACKET_INDEX_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GbSourceBracketIndex GbSourceBracketIndex;
+
+GbSourceBracketIndex *gb_source_bracket_index_get_for_buffer (GtkTextBuffer        *buffer);
+gboolean              gb_source_bracket_index_find_match     (GbSourceBracketIndex *index,
+                                                              const GtkTextIter    *location,
+                                                              GtkTextIter          *match);
+gboolean              gb_source_bracket_index_find_enclosing (GbSourceBracketIndex *index,
+                                                              const GtkTextIter    *location,
+                                                              gunichar              open_char,
+                                                              GtkTextIter          *match);
+
+G_END_DECLS
+
+#endif /* GB_SOURCE_BRACKET_INDEX_H */
@@ -100,6 +100,67 @@ gb_source_change_monitor_get_line (GbSourceChangeMonitor *monitor,
   return GB_SOURCE_CHANGE_NONE;
 }
 
+static gint
+compare_uint (gconstpointer a,
+              gconstpointer b)
+{
+  guint ua = *(const guint *)a;
+  guint ub = *(const guint *)b;
+
+  return (ua < ub) ? -1 : (ua > ub);
+}
+
+/**
+ * gb_source_change_monitor_get_changed_lines:
+ * @all_lines: (out): Set to %TRUE if every line is considered added.
+ *
+ * Takes a snapshot of the added or changed lines so that they can be
+ * consumed from a worker thread. This matches the lines for which
+ * gb_source_change_monitor_get_line() returns a non-zero value.
+ *
+ * Returns: (transfer full): A sorted #GArray of zero-based guint line
+ *   numbers. Empty when @all_lines is set.
+ */
+GArray *
+gb_source_change_monitor_get_changed_lines (GbSourceChangeMonitor *monitor,
+                                            gboolean              *all_lines)
+{
+  GArray *lines;
+
+  g_return_val_if_fail (GB_IS_SOURCE_CHANGE_MONITOR (monitor), NULL);
+  g_return_val_if_fail (all_lines, NULL);
+
+  lines = g_array_new (FALSE, FALSE, sizeof (guint));
+  *all_lines = FALSE;
+
+  if (monitor->priv->state)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, monitor->priv->state);
+
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          guint lineno;
+
+          if ((GPOINTER_TO_INT (key) <= 0) ||
+              !(GPOINTER_TO_INT (value) & GB_SOURCE_CHANGE_MASK))
+            continue;
+
+          lineno = GPOINTER_TO_INT (key) - 1;
+          g_array_append_val (lines, lineno);
+        }
+
+      g_array_sort (lines, compare_uint);
+    }
+  else if (monitor->priv->repo && (monitor->priv->found_blob == 0))
+    *all_lines = TRUE;
+
+  return lines;
+}
+
 static gint
 diff_line_cb (GgitDiffDelta *delta,
               GgitDiffHunk  *hunk,
@@ -57,14 +57,16 @@ struct _GbSourceChangeMonitorClass
   void (*changed) (GbSourceChangeMonitor *monitor);
 };
 
-GType                  gb_source_change_monitor_get_type (void);
-GbSourceChangeMonitor *gb_source_change_monitor_new      (GtkTextBuffer         *buffer);
-GFile                 *gb_source_change_monitor_get_file (GbSourceChangeMonitor *monitor);
-void                   gb_source_change_monitor_set_file (GbSourceChangeMonitor *monitor,
-                                                          GFile                 *file);
-GbSourceChangeFlags    gb_source_change_monitor_get_line (GbSourceChangeMonitor *monitor,
-                                                          guint                  lineno);
-void                   gb_source_change_monitor_reload   (GbSourceChangeMonitor *monitor);
+GType                  gb_source_change_monitor_get_type          (void);
+GbSourceChangeMonitor *gb_source_change_monitor_new               (GtkTextBuffer         *buffer);
+GFile                 *gb_source_change_monitor_get_file          (GbSourceChangeMonitor *monitor);
+void                   gb_source_change_monitor_set_file          (GbSourceChangeMonitor *monitor,
+                                                                   GFile                 *file);
+GbSourceChangeFlags    gb_source_change_monitor_get_line          (GbSourceChangeMonitor *monitor,
+                                                                   guint                  lineno);
+GArray                *gb_source_change_monitor_get_changed_lines (GbSourceChangeMonitor *monitor,
+                                                                   gboolean              *all_lines);
+void                   gb_source_change_monitor_reload            (GbSourceChangeMonitor *monitor);
 
 G_END_DECLS
 
@@ -20,6 +20,7 @@
 #define UNCRUSTIFY_CONFIG_DIRECTORY "/org/gnome/builder/editor/uncrustify/"
 
 #include <glib/gi18n.h>
+#include <string.h>
 
 #include "gb-log.h"
 #include "gb-source-formatter.h"
@@ -156,6 +157,411 @@ finish:
   return ret;
 }
 
+/*
+ * The line diff below is computed with a full LCS table, so keep an upper
+ * bound on the number of cells we are willing to allocate. Anything larger
+ * than this (after trimming the common prefix and suffix) is patched as a
+ * single hunk instead.
+ */
+#define MAX_DIFF_CELLS (1 << 20)
+
+typedef struct
+{
+  const gchar *str;
+  gsize        len;
+} Piece;
+
+typedef struct
+{
+  guint old_begin;
+  guint old_end;
+  guint new_begin;
+  guint new_end;
+} Hunk;
+
+static GArray *
+split_pieces (const gchar *text)
+{
+  GArray *pieces;
+  const gchar *iter;
+
+  pieces = g_array_new (FALSE, FALSE, sizeof (Piece));
+
+  /*
+   * Each piece is a line including its trailing delimiter so that the
+   * pieces concatenate back into the original text. Lines are split the
+   * same way as GtkTextBuffer does, so "\r\n", "\r" and U+2029 all end a
+   * line and piece indexes match buffer line numbers.
+   */
+  for (iter = text; *iter;)
+    {
+      gint delimiter;
+      gint next;
+      Piece piece;
+
+      pango_find_paragraph_boundary (iter, -1, &delimiter, &next);
+      piece.str = iter;
+      piece.len = next;
+      g_array_append_val (pieces, piece);
+      iter += piece.len;
+    }
+
+  return pieces;
+}
+
+static inline gboolean
+piece_equal (const Piece *a,
+             const Piece *b)
+{
+  return (a->len == b->len) && (memcmp (a->str, b->str, a->len) == 0);
+}
+
+static void
+push_hunk (GArray *hunks,
+           guint   old_begin,
+           guint   old_end,
+           guint   new_begin,
+           guint   new_end)
+{
+  Hunk hunk = { old_begin, old_end, new_begin, new_end };
+
+  if ((old_begin != old_end) || (new_begin != new_end))
+    g_array_append_val (hunks, hunk);
+}
+
+static GArray *
+diff_pieces (GArray *old_pieces,
+             GArray *new_pieces)
+{
+  const Piece *a = (const Piece *)(gpointer)old_pieces->data;
+  const Piece *b = (const Piece *)(gpointer)new_pieces->data;
+  GArray *hunks;
+  guint32 *table;
+  guint prefix = 0;
+  guint suffix = 0;
+  guint n;
+  guint m;
+  guint width;
+  guint i;
+  guint j;
+  guint hunk_i;
+  guint hunk_j;
+  gboolean in_hunk = FALSE;
+
+  hunks = g_array_new (FALSE, FALSE, sizeof (Hunk));
+
+  while ((prefix < old_pieces->len) &&
+         (prefix < new_pieces->len) &&
+         piece_equal (&a [prefix], &b [prefix]))
+    prefix++;
+
+  while ((suffix < (old_pieces->len - prefix)) &&
+         (suffix < (new_pieces->len - prefix)) &&
+         piece_equal (&a [old_pieces->len - suffix - 1],
+                      &b [new_pieces->len - suffix - 1]))
+    suffix++;
+
+  n = old_pieces->len - prefix - suffix;
+  m = new_pieces->len - prefix - suffix;
+
+  if ((n == 0) || (m == 0) || (((guint64)(n + 1) * (m + 1)) > MAX_DIFF_CELLS))
+    {
+      push_hunk (hunks, prefix, prefix + n, prefix, prefix + m);
+      return hunks;
+    }
+
+  /*
+   * table[i][j] contains the length of the longest common subsequence of
+   * the old lines starting at i and the new lines starting at j.
+   */
+  width = m + 1;
+  table = g_new0 (guint32, (n + 1) * width);
+
+  for (i = n; i-- > 0;)
+    for (j = m; j-- > 0;)
+      {
+        if (piece_equal (&a [prefix + i], &b [prefix + j]))
+          table [i * width + j] = table [(i + 1) * width + j + 1] + 1;
+        else
+          table [i * width + j] = MAX (table [(i + 1) * width + j],
+                                       table [i * width + j + 1]);
+      }
+
+  i = j = hunk_i = hunk_j = 0;
+
+  while ((i < n) && (j < m))
+    {
+      if (piece_equal (&a [prefix + i], &b [prefix + j]))
+        {
+          if (in_hunk)
+            push_hunk (hunks, prefix + hunk_i, prefix + i,
+                       prefix + hunk_j, prefix + j);
+          in_hunk = FALSE;
+          i++;
+          j++;
+          continue;
+        }
+
+      if (!in_hunk)
+        {
+          hunk_i = i;
+          hunk_j = j;
+          in_hunk = TRUE;
+        }
+
+      if (table [(i + 1) * width + j] >= table [i * width + j + 1])
+        i++;
+      else
+        j++;
+    }
+
+  if (!in_hunk)
+    {
+      hunk_i = i;
+      hunk_j = j;
+    }
+
+  push_hunk (hunks, prefix + hunk_i, prefix + n, prefix + hunk_j, prefix + m);
+
+  g_free (table);
+
+  return hunks;
+}
+
+static void
+get_piece_iter (GtkTextBuffer *buffer,
+                guint          first_line,
+                GtkTextMark   *end_mark,
+                guint          n_pieces,
+                guint          piece,
+                GtkTextIter   *iter)
+{
+  if (piece < n_pieces)
+    gtk_text_buffer_get_iter_at_line (buffer, iter, first_line + piece);
+  else
+    gtk_text_buffer_get_iter_at_mark (buffer, iter, end_mark);
+}
+
+static gboolean
+line_is_blank (const GtkTextIter *line_start)
+{
+  GtkTextIter iter = *line_start;
+
+  for (; !gtk_text_iter_ends_line (&iter); gtk_text_iter_forward_char (&iter))
+    if (!g_unichar_isspace (gtk_text_iter_get_char (&iter)))
+      return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Locates the top-level block (a "{" and "}" pair in the first column)
+ * containing @location, including the declaration lines preceding the
+ * opening brace. @begin and @end are placed at the start of the first line
+ * and the start of the line following the closing brace.
+ */
+static gboolean
+find_toplevel_block (GtkTextBuffer     *buffer,
+                     const GtkTextIter *location,
+                     GtkTextIter       *begin,
+                     GtkTextIter       *end)
+{
+  GtkTextIter iter;
+  gunichar ch;
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter,
+                                    gtk_text_iter_get_line (location));
+
+  /*
+   * Walk backwards looking for the opening brace. If we hit the closing
+   * brace of a previous block first, we are not inside of a block.
+   */
+  for (;;)
+    {
+      ch = gtk_text_iter_get_char (&iter);
+
+      if (ch == '{')
+        break;
+
+      if ((ch == '}') &&
+          (gtk_text_iter_get_line (&iter) != gtk_text_iter_get_line (location)))
+        return FALSE;
+
+      if (!gtk_text_iter_backward_line (&iter))
+        return FALSE;
+    }
+
+  *begin = iter;
+
+  while (gtk_text_iter_backward_line (&iter))
+    {
+      ch = gtk_text_iter_get_char (&iter);
+
+      if ((ch == '}') || (ch == '#') || line_is_blank (&iter))
+        break;
+
+      *begin = iter;
+    }
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter,
+                                    MAX (gtk_text_iter_get_line (location),
+                                         gtk_text_iter_get_line (begin) + 1));
+
+  for (;;)
+    {
+      ch = gtk_text_iter_get_char (&iter);
+
+      if (ch == '}')
+        break;
+
+      if ((ch == '{') || !gtk_text_iter_forward_line (&iter))
+        return FALSE;
+    }
+
+  *end = iter;
+
+  if (!gtk_text_iter_forward_line (end))
+    gtk_text_buffer_get_end_iter (buffer, end);
+
+  return TRUE;
+}
+
+/**
+ * gb_source_formatter_format_range:
+ * @formatter: A #GbSourceFormatter.
+ * @buffer: The #GtkTextBuffer to format.
+ * @begin: The beginning of the range to format.
+ * @end: The end of the range to format.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: (allow-none): A location for a #GError or %NULL.
+ *
+ * Formats the lines contained within @begin and @end as a fragment. If
+ * @begin and @end are equal, the top-level block containing them is used
+ * instead, falling back to the whole buffer.
+ *
+ * Rather than replacing the entire range, the formatted text is compared
+ * line-by-line against the original and only the differing lines are
+ * modified, within a single user action. This keeps marks outside of the
+ * changed lines in place and limits the amount of text that needs to be
+ * re-highlighted.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+gb_source_formatter_format_range (GbSourceFormatter  *formatter,
+                                  GtkTextBuffer      *buffer,
+                                  const GtkTextIter  *begin,
+                                  const GtkTextIter  *end,
+                                  GCancellable       *cancellable,
+                                  GError            **error)
+{
+  GtkTextMark *end_mark;
+  GtkTextIter range_begin;
+  GtkTextIter range_end;
+  GArray *old_pieces;
+  GArray *new_pieces;
+  GArray *hunks;
+  gboolean fragment = TRUE;
+  gchar *input;
+  gchar *output = NULL;
+  guint first_line;
+  guint i;
+
+  g_return_val_if_fail (GB_IS_SOURCE_FORMATTER (formatter), FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (begin, FALSE);
+  g_return_val_if_fail (end, FALSE);
+
+  ENTRY;
+
+  range_begin = *begin;
+  range_end = *end;
+  gtk_text_iter_order (&range_begin, &range_end);
+
+  if (gtk_text_iter_equal (&range_begin, &range_end))
+    {
+      if (!find_toplevel_block (buffer, begin, &range_begin, &range_end))
+        {
+          gtk_text_buffer_get_bounds (buffer, &range_begin, &range_end);
+          fragment = FALSE;
+        }
+    }
+  else
+    {
+      /*
+       * Extend the selection to contain whole lines so that the diff
+       * operates on complete lines.
+       */
+      gtk_text_iter_set_line_offset (&range_begin, 0);
+      if (!gtk_text_iter_starts_line (&range_end) &&
+          !gtk_text_iter_forward_line (&range_end))
+        gtk_text_buffer_get_end_iter (buffer, &range_end);
+    }
+
+  input = gtk_text_buffer_get_text (buffer, &range_begin, &range_end, TRUE);
+
+  if (!gb_source_formatter_format (formatter, input, fragment, cancellable,
+                                   &output, error))
+    {
+      g_free (input);
+      RETURN (FALSE);
+    }
+
+  old_pieces = split_pieces (input);
+  new_pieces = split_pieces (output);
+  hunks = diff_pieces (old_pieces, new_pieces);
+
+  first_line = gtk_text_iter_get_line (&range_begin);
+  end_mark = gtk_text_buffer_create_mark (buffer, NULL, &range_end, FALSE);
+
+  gtk_text_buffer_begin_user_action (buffer);
+
+  /*
+   * Apply the hunks back-to-front so that the line numbers of the hunks
+   * that have not yet been applied remain valid.
+   */
+  for (i = hunks->len; i-- > 0;)
+    {
+      const Hunk *hunk = &g_array_index (hunks, Hunk, i);
+      GtkTextIter hunk_begin;
+      GtkTextIter hunk_end;
+      GString *str;
+      guint j;
+
+      get_piece_iter (buffer, first_line, end_mark, old_pieces->len,
+                      hunk->old_begin, &hunk_begin);
+      get_piece_iter (buffer, first_line, end_mark, old_pieces->len,
+                      hunk->old_end, &hunk_end);
+
+      if (!gtk_text_iter_equal (&hunk_begin, &hunk_end))
+        gtk_text_buffer_delete (buffer, &hunk_begin, &hunk_end);
+
+      str = g_string_new (NULL);
+      for (j = hunk->new_begin; j < hunk->new_end; j++)
+        {
+          const Piece *piece = &g_array_index (new_pieces, Piece, j);
+          g_string_append_len (str, piece->str, piece->len);
+        }
+
+      if (str->len)
+        gtk_text_buffer_insert (buffer, &hunk_begin, str->str, str->len);
+
+      g_string_free (str, TRUE);
+    }
+
+  gtk_text_buffer_end_user_action (buffer);
+
+  gtk_text_buffer_delete_mark (buffer, end_mark);
+
+  g_array_unref (hunks);
+  g_array_unref (old_pieces);
+  g_array_unref (new_pieces);
+  g_free (input);
+  g_free (output);
+
+  RETURN (TRUE);
+}
+
 GtkSourceLanguage *
 gb_source_formatter_get_language (GbSourceFormatter *formatter)
 {
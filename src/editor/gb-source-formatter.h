@@ -57,6 +57,12 @@ gboolean           gb_source_formatter_format            (GbSourceFormatter  *fo
                                                           GCancellable       *cancellable,
                                                           gchar             **output,
                                                           GError            **error);
+gboolean           gb_source_formatter_format_range      (GbSourceFormatter  *formatter,
+                                                          GtkTextBuffer      *buffer,
+                                                          const GtkTextIter  *begin,
+                                                          const GtkTextIter  *end,
+                                                          GCancellable       *cancellable,
+                                                          GError            **error);
 
 G_END_DECLS
 
@@ -0,0 +1,512 @@
+/* gb-source-language-sniffer.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "language-sniffer"
+
+#include <string.h>
+
+#include "gb-source-language-sniffer.h"
+
+/*
+ * Language detection only ever looks at a bounded window of the buffer.
+ * In order of preference we use:
+ *
+ *   1) An emacs, vim or kate modeline within the first or last few lines.
+ *   2) The interpreter named by a "#!" line.
+ *   3) g_content_type_guess() on the file name and the head of the buffer.
+ *
+ * The result is cached per (uri, mtime) so that reopening or reloading an
+ * unchanged file does not need to copy any text at all. The cache is only
+ * accessed from the main thread.
+ */
+
+#define SNIFF_WINDOW_CHARS    4096
+#define MODELINE_WINDOW_CHARS 1024
+#define MODELINE_LINES        5
+#define SNIFF_CACHE_MAX       512
+
+typedef struct
+{
+  GTimeVal  mtime;
+  gchar    *lang_id;
+} SniffCacheEntry;
+
+static GHashTable *gSniffCache;
+
+static const struct {
+  const gchar *name;
+  const gchar *lang_id;
+} gAliases [] = {
+  { "bash",         "sh" },
+  { "c++",          "cpp" },
+  { "csharp",       "c-sharp" },
+  { "cs",           "c-sharp" },
+  { "dash",         "sh" },
+  { "gjs",          "js" },
+  { "javascript",   "js" },
+  { "ksh",          "sh" },
+  { "make",         "makefile" },
+  { "node",         "js" },
+  { "nodejs",       "js" },
+  { "py",           "python" },
+  { "seed",         "js" },
+  { "shell-script", "sh" },
+  { "tclsh",        "tcl" },
+  { "wish",         "tcl" },
+  { "zsh",          "sh" },
+};
+
+static void
+sniff_cache_entry_free (gpointer data)
+{
+  SniffCacheEntry *entry = data;
+
+  g_free (entry->lang_id);
+  g_slice_free (SniffCacheEntry, entry);
+}
+
+static GtkSourceLanguage *
+resolve_language (GtkSourceLanguageManager *manager,
+                  const gchar              *name)
+{
+  const gchar * const *ids;
+  GtkSourceLanguage *lang = NULL;
+  gchar *lower;
+  guint i;
+
+  g_assert (GTK_SOURCE_IS_LANGUAGE_MANAGER (manager));
+  g_assert (name);
+
+  lower = g_ascii_strdown (name, -1);
+
+  for (i = 0; i < G_N_ELEMENTS (gAliases); i++)
+    {
+      if (g_str_equal (lower, gAliases [i].name))
+        {
+          lang = gtk_source_language_manager_get_language (manager,
+                                                           gAliases [i].lang_id);
+          break;
+        }
+    }
+
+  if (!lang)
+    lang = gtk_source_language_manager_get_language (manager, lower);
+
+  if (!lang && (ids = gtk_source_language_manager_get_language_ids (manager)))
+    {
+      for (i = 0; ids [i]; i++)
+        {
+          GtkSourceLanguage *candidate;
+
+          candidate = gtk_source_language_manager_get_language (manager, ids [i]);
+          if (!g_ascii_strcasecmp (name, gtk_source_language_get_name (candidate)))
+            {
+              lang = candidate;
+              break;
+            }
+        }
+    }
+
+  g_free (lower);
+
+  return lang;
+}
+
+static gboolean
+is_token_start (const gchar *line,
+                const gchar *pos)
+{
+  return (pos == line) || g_ascii_isspace (pos [-1]);
+}
+
+static gchar *
+parse_emacs_modeline (const gchar *line)
+{
+  const gchar *begin;
+  const gchar *end;
+  gchar *content;
+  gchar *mode;
+  gchar *ret = NULL;
+
+  /* -*- mode: c; indent-tabs-mode: nil -*-  or  -*- c -*- */
+
+  if (!(begin = strstr (line, "-*-")) || !(end = strstr (begin + 3, "-*-")))
+    return NULL;
+
+  content = g_ascii_strdown (begin + 3, end - begin - 3);
+
+  for (mode = strstr (content, "mode:"); mode; mode = strstr (mode + 5, "mode:"))
+    {
+      if ((mode == content) || (mode [-1] == ';') || g_ascii_isspace (mode [-1]))
+        {
+          gchar *semi;
+
+          mode += 5;
+          if ((semi = strchr (mode, ';')))
+            *semi = '\0';
+          ret = g_strdup (g_strstrip (mode));
+          break;
+        }
+    }
+
+  if (!ret && !strchr (content, ':'))
+    ret = g_strdup (g_strstrip (content));
+
+  g_free (content);
+
+  if (ret && !*ret)
+    g_clear_pointer (&ret, g_free);
+
+  return ret;
+}
+
+static gchar *
+parse_vim_modeline (const gchar *line)
+{
+  static const gchar *prefixes [] = { "vim:", "vi:", "ex:" };
+  const gchar *options = NULL;
+  gchar **tokens;
+  gchar *ret = NULL;
+  guint i;
+
+  /* vim: set ft=c ts=8:  or  vim: filetype=c */
+
+  for (i = 0; !options && i < G_N_ELEMENTS (prefixes); i++)
+    {
+      const gchar *pos;
+
+      for (pos = strstr (line, prefixes [i]);
+           pos && !options;
+           pos = strstr (pos + 1, prefixes [i]))
+        {
+          if (is_token_start (line, pos))
+            options = pos + strlen (prefixes [i]);
+        }
+    }
+
+  if (!options)
+    return NULL;
+
+  tokens = g_strsplit_set (options, " \t:", -1);
+
+  for (i = 0; !ret && tokens [i]; i++)
+    {
+      const gchar *value;
+
+      if (g_str_has_prefix (tokens [i], "ft="))
+        value = tokens [i] + 3;
+      else if (g_str_has_prefix (tokens [i], "filetype="))
+        value = tokens [i] + 9;
+      else if (g_str_has_prefix (tokens [i], "syntax="))
+        value = tokens [i] + 7;
+      else if (g_str_has_prefix (tokens [i], "syn="))
+        value = tokens [i] + 4;
+      else
+        continue;
+
+      if (*value)
+        ret = g_strdup (value);
+    }
+
+  g_strfreev (tokens);
+
+  return ret;
+}
+
+static gchar *
+parse_kate_modeline (const gchar *line)
+{
+  const gchar *pos;
+  gchar **tokens;
+  gchar *ret = NULL;
+  guint i;
+
+  /* kate: hl C++; indent-width 4; */
+
+  if (!(pos = strstr (line, "kate:")) || !is_token_start (line, pos))
+    return NULL;
+
+  tokens = g_strsplit (pos + 5, ";", -1);
+
+  for (i = 0; !ret && tokens [i]; i++)
+    {
+      gchar *token = g_strstrip (tokens [i]);
+
+      if (g_str_has_prefix (token, "hl ") && *g_strstrip (token + 3))
+        ret = g_strdup (token + 3);
+    }
+
+  g_strfreev (tokens);
+
+  return ret;
+}
+
+static gchar *
+sniff_modeline (const gchar *text,
+                gboolean     from_end)
+{
+  gchar **lines;
+  gchar *ret = NULL;
+  guint n_lines;
+  guint i;
+
+  g_assert (text);
+
+  lines = g_strsplit (text, "\n", -1);
+  n_lines = g_strv_length (lines);
+
+  if (from_end && n_lines && !*lines [n_lines - 1])
+    n_lines--;
+
+  for (i = 0; !ret && (i < MODELINE_LINES) && (i < n_lines); i++)
+    {
+      const gchar *line = lines [from_end ? (n_lines - 1 - i) : i];
+
+      if (!(ret = parse_emacs_modeline (line)) &&
+          !(ret = parse_vim_modeline (line)))
+        ret = parse_kate_modeline (line);
+    }
+
+  g_strfreev (lines);
+
+  return ret;
+}
+
+static gchar *
+sniff_shebang (const gchar *text)
+{
+  const gchar *eol;
+  gchar **argv;
+  gchar *line;
+  gchar *ret = NULL;
+  guint i;
+
+  g_assert (text);
+
+  /* #!/bin/sh  or  #!/usr/bin/env -S python3 -u */
+
+  if (!g_str_has_prefix (text, "#!"))
+    return NULL;
+
+  text += 2;
+
+  if ((eol = strchr (text, '\n')))
+    line = g_strndup (text, eol - text);
+  else
+    line = g_strdup (text);
+
+  argv = g_strsplit_set (g_strstrip (line), " \t", -1);
+
+  for (i = 0; argv [i]; i++)
+    {
+      gchar *base;
+
+      if (!*argv [i])
+        continue;
+
+      base = g_path_get_basename (argv [i]);
+
+      if (g_str_equal (base, "env"))
+        {
+          g_free (base);
+
+          /* Skip options and VAR=value assignments following env. */
+          for (i++; argv [i]; i++)
+            {
+              if (*argv [i] && (*argv [i] != '-') && !strchr (argv [i], '='))
+                break;
+            }
+
+          if (!argv [i])
+            break;
+
+          base = g_path_get_basename (argv [i]);
+        }
+
+      ret = base;
+      break;
+    }
+
+  g_strfreev (argv);
+  g_free (line);
+
+  return ret;
+}
+
+static GtkSourceLanguage *
+resolve_interpreter (GtkSourceLanguageManager *manager,
+                     const gchar              *interpreter)
+{
+  GtkSourceLanguage *lang;
+  gchar *stripped;
+  gsize len;
+
+  g_assert (GTK_SOURCE_IS_LANGUAGE_MANAGER (manager));
+  g_assert (interpreter);
+
+  if ((lang = resolve_language (manager, interpreter)))
+    return lang;
+
+  /* python3.4 -> python3 -> python */
+
+  stripped = g_strdup (interpreter);
+  len = strlen (stripped);
+
+  while (len && !lang)
+    {
+      if (!g_ascii_isdigit (stripped [len - 1]) && (stripped [len - 1] != '.'))
+        break;
+
+      stripped [--len] = '\0';
+
+      if (len && (stripped [len - 1] != '.'))
+        lang = resolve_language (manager, stripped);
+    }
+
+  g_free (stripped);
+
+  return lang;
+}
+
+/**
+ * gb_source_language_sniffer_guess:
+ * @buffer: A #GtkTextBuffer.
+ * @location: (allow-none): The location of the file backing @buffer.
+ * @mtime: (allow-none): The modification time of @location.
+ *
+ * Guesses the language for @buffer. At most the first few KB and the last
+ * few lines of the buffer are inspected. When both @location and @mtime are
+ * provided, the result is cached and returned without touching the buffer
+ * until the file is modified.
+ *
+ * Returns: (transfer none): A #GtkSourceLanguage or %NULL.
+ */
+GtkSourceLanguage *
+gb_source_language_sniffer_guess (GtkTextBuffer  *buffer,
+                                  GFile          *location,
+                                  const GTimeVal *mtime)
+{
+  GtkSourceLanguageManager *manager;
+  GtkSourceLanguage *lang = NULL;
+  SniffCacheEntry *entry;
+  GtkTextIter begin;
+  GtkTextIter end;
+  gboolean result_uncertain = TRUE;
+  gchar *content_type = NULL;
+  gchar *head = NULL;
+  gchar *name = NULL;
+  gchar *uri = NULL;
+  gchar *sniffed = NULL;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+  g_return_val_if_fail (!location || G_IS_FILE (location), NULL);
+
+  manager = gtk_source_language_manager_get_default ();
+
+  if (location && mtime)
+    {
+      if (!gSniffCache)
+        gSniffCache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, sniff_cache_entry_free);
+
+      uri = g_file_get_uri (location);
+      entry = g_hash_table_lookup (gSniffCache, uri);
+
+      if (entry && !memcmp (&entry->mtime, mtime, sizeof *mtime))
+        {
+          if (entry->lang_id)
+            lang = gtk_source_language_manager_get_language (manager,
+                                                             entry->lang_id);
+          g_free (uri);
+          return lang;
+        }
+    }
+
+  gtk_text_buffer_get_start_iter (buffer, &begin);
+  end = begin;
+  gtk_text_iter_forward_chars (&end, SNIFF_WINDOW_CHARS);
+  head = gtk_text_iter_get_slice (&begin, &end);
+
+  if (!(sniffed = sniff_modeline (head, FALSE)))
+    {
+      if (gtk_text_iter_is_end (&end))
+        sniffed = sniff_modeline (head, TRUE);
+      else
+        {
+          GtkTextIter tail_begin;
+          GtkTextIter tail_end;
+          gchar *tail;
+
+          gtk_text_buffer_get_end_iter (buffer, &tail_end);
+          tail_begin = tail_end;
+          gtk_text_iter_backward_chars (&tail_begin, MODELINE_WINDOW_CHARS);
+          if (gtk_text_iter_compare (&tail_begin, &end) < 0)
+            tail_begin = end;
+
+          tail = gtk_text_iter_get_slice (&tail_begin, &tail_end);
+          sniffed = sniff_modeline (tail, TRUE);
+          g_free (tail);
+        }
+    }
+
+  if (sniffed)
+    {
+      lang = resolve_language (manager, sniffed);
+      g_clear_pointer (&sniffed, g_free);
+    }
+
+  if (!lang && (sniffed = sniff_shebang (head)))
+    {
+      lang = resolve_interpreter (manager, sniffed);
+      g_clear_pointer (&sniffed, g_free);
+    }
+
+  if (!lang)
+    {
+      if (location)
+        name = g_file_get_basename (location);
+
+      content_type = g_content_type_guess (name,
+                                           (const guint8 *)head, strlen (head),
+                                           &result_uncertain);
+      if (result_uncertain)
+        g_clear_pointer (&content_type, g_free);
+
+      lang = gtk_source_language_manager_guess_language (manager, name,
+                                                         content_type);
+    }
+
+  if (uri)
+    {
+      if (g_hash_table_size (gSniffCache) >= SNIFF_CACHE_MAX)
+        g_hash_table_remove_all (gSniffCache);
+
+      entry = g_slice_new0 (SniffCacheEntry);
+      entry->mtime = *mtime;
+      entry->lang_id = lang ? g_strdup (gtk_source_language_get_id (lang)) : NULL;
+      g_hash_table_replace (gSniffCache, uri, entry);
+      uri = NULL;
+    }
+
+  g_free (content_type);
+  g_free (head);
+  g_free (name);
+  g_free (uri);
+
+  return lang;
+}
@@ -64,12 +64,14 @@ struct _GbSourceViewPrivate
   guint                        buffer_delete_range_after_handler;
   guint                        buffer_mark_set_handler;
   guint                        buffer_notify_language_handler;
+  guint                        buffer_notify_large_file_handler;
 
   guint                        auto_indent : 1;
   guint                        enable_word_completion : 1;
   guint                        insert_matching_brace : 1;
   guint                        show_shadow : 1;
   guint                        overwrite_braces : 1;
+  guint                        words_registered : 1;
 };
 
 typedef void (*GbSourceViewMatchFunc) (GbSourceView      *view,
@@ -459,7 +461,7 @@ gb_source_view_indent_selection (GbSourceView *view)
                 NULL);
 
   if (!gtk_text_buffer_get_has_selection (priv->buffer))
-    return;
+    EXIT;
 
   gtk_text_buffer_get_selection_bounds (priv->buffer, &begin, &end);
 
@@ -546,7 +548,7 @@ gb_source_view_unindent_selection (GbSourceView *view)
                 NULL);
 
   if (!gtk_text_buffer_get_has_selection (priv->buffer))
-    return;
+    EXIT;
 
   gtk_text_buffer_get_selection_bounds (priv->buffer, &begin, &end);
 
@@ -1171,6 +1173,51 @@ on_language_set (GtkSourceBuffer *buffer,
   gb_source_view_connect_settings (view);
 }
 
+static void
+gb_source_view_reload_words (GbSourceView *view)
+{
+  GbSourceViewPrivate *priv;
+  gboolean register_words = FALSE;
+
+  g_return_if_fail (GB_IS_SOURCE_VIEW (view));
+
+  priv = view->priv;
+
+  /*
+   * Word completion scans the whole buffer, so don't attach it to large
+   * files until the user has opted out of large file mode.
+   */
+  if (priv->buffer)
+    register_words = !(GB_IS_EDITOR_DOCUMENT (priv->buffer) &&
+                       gb_editor_document_get_large_file (
+                         GB_EDITOR_DOCUMENT (priv->buffer)));
+
+  if (register_words == priv->words_registered)
+    return;
+
+  if (register_words)
+    gtk_source_completion_words_register (
+        GTK_SOURCE_COMPLETION_WORDS (priv->words_provider),
+        priv->buffer);
+  else
+    gtk_source_completion_words_unregister (
+        GTK_SOURCE_COMPLETION_WORDS (priv->words_provider),
+        priv->buffer);
+
+  priv->words_registered = register_words;
+}
+
+static void
+on_large_file_set (GbEditorDocument *document,
+                   GParamSpec       *pspec,
+                   GbSourceView     *view)
+{
+  g_return_if_fail (GB_IS_EDITOR_DOCUMENT (document));
+  g_return_if_fail (GB_IS_SOURCE_VIEW (view));
+
+  gb_source_view_reload_words (view);
+}
+
 static void
 gb_source_view_notify_buffer (GObject    *object,
                               GParamSpec *pspec,
@@ -1207,9 +1254,19 @@ gb_source_view_notify_buffer (GObject    *object,
       priv->buffer_delete_range_after_handler = 0;
       priv->buffer_mark_set_handler = 0;
       priv->buffer_notify_language_handler = 0;
-      gtk_source_completion_words_unregister (
-          GTK_SOURCE_COMPLETION_WORDS (priv->words_provider),
-          GTK_TEXT_BUFFER (priv->buffer));
+      if (priv->buffer_notify_large_file_handler)
+        {
+          g_signal_handler_disconnect (priv->buffer,
+                                       priv->buffer_notify_large_file_handler);
+          priv->buffer_notify_large_file_handler = 0;
+        }
+      if (priv->words_registered)
+        {
+          gtk_source_completion_words_unregister (
+              GTK_SOURCE_COMPLETION_WORDS (priv->words_provider),
+              GTK_TEXT_BUFFER (priv->buffer));
+          priv->words_registered = FALSE;
+        }
       g_object_remove_weak_pointer (G_OBJECT (priv->buffer),
                                     (gpointer *) &priv->buffer);
       priv->buffer = NULL;
@@ -1259,9 +1316,15 @@ gb_source_view_notify_buffer (GObject    *object,
                                  object,
                                  0);
 
-      gtk_source_completion_words_register (
-          GTK_SOURCE_COMPLETION_WORDS (priv->words_provider),
-          GTK_TEXT_BUFFER (buffer));
+      if (GB_IS_EDITOR_DOCUMENT (buffer))
+        priv->buffer_notify_large_file_handler =
+          g_signal_connect_object (buffer,
+                                   "notify::large-file",
+                                   G_CALLBACK (on_large_file_set),
+                                   object,
+                                   0);
+
+      gb_source_view_reload_words (view);
 
       gb_source_view_reload_auto_indenter (view);
       gb_source_view_reload_snippets (view);
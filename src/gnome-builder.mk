@@ -19,6 +19,8 @@ libgnome_builder_la_SOURCES = \
 	src/auto-indent/gb-source-auto-indenter-xml.h \
 	src/auto-indent/gb-source-auto-indenter.c \
 	src/auto-indent/gb-source-auto-indenter.h \
+	src/auto-indent/gb-source-c-line-cache.c \
+	src/auto-indent/gb-source-c-line-cache.h \
 	src/code-assistant/gb-source-code-assistant-renderer.c \
 	src/code-assistant/gb-source-code-assistant-renderer.h \
 	src/code-assistant/gb-source-code-assistant.c \
@@ -85,6 +87,8 @@ libgnome_builder_la_SOURCES = \
 	src/editor/gb-editor-view.h \
 	src/editor/gb-editor-workspace.c \
 	src/editor/gb-editor-workspace.h \
+	src/editor/gb-source-bracket-index.c \
+	src/editor/gb-source-bracket-index.h \
 	src/editor/gb-source-change-gutter-renderer.c \
 	src/editor/gb-source-change-gutter-renderer.h \
 	src/editor/gb-source-change-monitor.c \
@@ -93,6 +97,8 @@ libgnome_builder_la_SOURCES = \
 	src/editor/gb-source-formatter.h \
 	src/editor/gb-source-highlight-menu.c \
 	src/editor/gb-source-highlight-menu.h \
+	src/editor/gb-source-language-sniffer.c \
+	src/editor/gb-source-language-sniffer.h \
 	src/editor/gb-source-search-highlighter.c \
 	src/editor/gb-source-search-highlighter.h \
 	src/editor/gb-source-style-scheme-button.c \
@@ -127,6 +133,8 @@ libgnome_builder_la_SOURCES = \
 	src/keybindings/gb-keybindings.h \
 	src/log/gb-log.c \
 	src/log/gb-log.h \
+	src/log/gb-trace.c \
+	src/log/gb-trace.h \
 	src/markdown/gs-markdown.c \
 	src/markdown/gs-markdown.h \
 	src/nautilus/nautilus-floating-bar.c \
@@ -191,6 +199,8 @@ libgnome_builder_la_SOURCES = \
 	src/trie/trie.h \
 	src/util/gb-cairo.c \
 	src/util/gb-cairo.h \
+	src/util/gb-deferred.c \
+	src/util/gb-deferred.h \
 	src/util/gb-doc-seq.c \
 	src/util/gb-doc-seq.h \
 	src/util/gb-glib.h \
@@ -203,6 +213,8 @@ libgnome_builder_la_SOURCES = \
 	src/util/gb-string.h \
 	src/util/gb-widget.c \
 	src/util/gb-widget.h \
+	src/vim/gb-source-vim-sort.c \
+	src/vim/gb-source-vim-sort.h \
 	src/vim/gb-source-vim.c \
 	src/vim/gb-source-vim.h \
 	src/workbench/gb-workbench-types.h \
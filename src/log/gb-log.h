@@ -21,6 +21,8 @@
 
 #include <glib.h>
 
+#include "gb-trace.h"
+
 G_BEGIN_DECLS
 
 #ifndef G_LOG_LEVEL_TRACE
@@ -38,12 +40,16 @@ G_BEGIN_DECLS
    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_TRACE, " TODO: %s():%d: %s",        \
          G_STRFUNC, __LINE__, _msg)
 #define ENTRY                                                          \
-   g_log(G_LOG_DOMAIN, G_LOG_LEVEL_TRACE, "ENTRY: %s():%d",            \
-         G_STRFUNC, __LINE__)
+   G_STMT_START {                                                      \
+      g_log(G_LOG_DOMAIN, G_LOG_LEVEL_TRACE, "ENTRY: %s():%d",         \
+            G_STRFUNC, __LINE__);                                      \
+      gb_trace_begin (G_STRFUNC);                                      \
+   } G_STMT_END
 #define EXIT                                                           \
    G_STMT_START {                                                      \
       g_log(G_LOG_DOMAIN, G_LOG_LEVEL_TRACE, " EXIT: %s():%d",         \
             G_STRFUNC, __LINE__);                                      \
+      gb_trace_end (G_STRFUNC);                                        \
       return;                                                          \
    } G_STMT_END
 #define GOTO(_l)                                                       \
@@ -56,6 +62,7 @@ G_BEGIN_DECLS
    G_STMT_START {                                                      \
       g_log(G_LOG_DOMAIN, G_LOG_LEVEL_TRACE, " EXIT: %s():%d ",        \
             G_STRFUNC, __LINE__);                                      \
+      gb_trace_end (G_STRFUNC);                                        \
       return _r;                                                       \
    } G_STMT_END
 #else
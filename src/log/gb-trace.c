@@ -0,0 +1,222 @@
+/* gb-trace.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux__
+# include <sys/types.h>
+# include <sys/syscall.h>
+#endif /* __linux__ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "gb-trace.h"
+
+/*
+ * A small tracer for profiling startup. When GB_TRACE_FILE is set in the
+ * environment, begin and end events are recorded with a timestamp and
+ * thread id and written to that file at shutdown in the Chrome trace event
+ * format, which can be loaded by chrome://tracing, Perfetto, or imported
+ * into Sysprof.
+ *
+ * Event names are not copied, so they must be static strings such as
+ * string literals or G_STRFUNC.
+ */
+
+#define MAX_EVENTS (1 << 18)
+
+typedef struct
+{
+  const gchar *name;
+  gint64       time;
+  gint         thread;
+  gchar        phase;
+} GbTraceEvent;
+
+static gboolean  gEnabled;
+static gchar    *gFilename;
+static gint64    gBeginTime;
+static GArray   *gEvents;
+static gboolean  gTruncated;
+
+G_LOCK_DEFINE_STATIC (events);
+
+static inline gint
+gb_trace_get_thread (void)
+{
+#if __linux__
+  return (gint) syscall (SYS_gettid);
+#else
+  return GPOINTER_TO_INT (g_thread_self ());
+#endif /* __linux__ */
+}
+
+static void
+gb_trace_push (const gchar *name,
+               gchar        phase)
+{
+  GbTraceEvent event;
+
+  if (G_LIKELY (!gEnabled))
+    return;
+
+  event.name = name;
+  event.time = g_get_monotonic_time ();
+  event.thread = gb_trace_get_thread ();
+  event.phase = phase;
+
+  G_LOCK (events);
+  if (gEnabled)
+    {
+      if (gEvents->len < MAX_EVENTS)
+        g_array_append_val (gEvents, event);
+      else
+        gTruncated = TRUE;
+    }
+  G_UNLOCK (events);
+}
+
+/**
+ * gb_trace_init:
+ *
+ * Enables tracing if GB_TRACE_FILE is set. This should be called as early
+ * as possible since timestamps are relative to this call.
+ */
+void
+gb_trace_init (void)
+{
+  const gchar *filename;
+
+  if (gEnabled)
+    return;
+
+  filename = g_getenv ("GB_TRACE_FILE");
+
+  if (!filename || !*filename)
+    return;
+
+  gFilename = g_strdup (filename);
+  gBeginTime = g_get_monotonic_time ();
+  gEvents = g_array_new (FALSE, FALSE, sizeof (GbTraceEvent));
+  gEnabled = TRUE;
+}
+
+gboolean
+gb_trace_is_enabled (void)
+{
+  return gEnabled;
+}
+
+void
+gb_trace_begin (const gchar *name)
+{
+  gb_trace_push (name, 'B');
+}
+
+void
+gb_trace_end (const gchar *name)
+{
+  gb_trace_push (name, 'E');
+}
+
+void
+gb_trace_instant (const gchar *name)
+{
+  gb_trace_push (name, 'i');
+}
+
+static void
+append_escaped (GString     *str,
+                const gchar *text)
+{
+  for (; *text; text++)
+    {
+      if ((*text == '"') || (*text == '\\'))
+        g_string_append_c (str, '\\');
+
+      if ((guchar)*text < 0x20)
+        g_string_append_printf (str, "\\u%04x", (guchar)*text);
+      else
+        g_string_append_c (str, *text);
+    }
+}
+
+/**
+ * gb_trace_shutdown:
+ *
+ * Stops tracing and writes the recorded events to the file named by
+ * GB_TRACE_FILE.
+ */
+void
+gb_trace_shutdown (void)
+{
+  const gchar *prgname;
+  GError *error = NULL;
+  GString *str;
+  gint pid;
+  guint i;
+
+  if (!gEnabled)
+    return;
+
+  G_LOCK (events);
+  gEnabled = FALSE;
+  G_UNLOCK (events);
+
+  pid = getpid ();
+  prgname = g_get_prgname ();
+  str = g_string_new ("{\"traceEvents\":[\n");
+
+  g_string_append_printf (str,
+                          "{\"name\":\"process_name\",\"ph\":\"M\","
+                          "\"pid\":%d,\"tid\":%d,"
+                          "\"args\":{\"name\":\"%s\"}}",
+                          pid, pid, prgname ? prgname : "gnome-builder");
+
+  for (i = 0; i < gEvents->len; i++)
+    {
+      GbTraceEvent *event = &g_array_index (gEvents, GbTraceEvent, i);
+
+      g_string_append (str, ",\n{\"name\":\"");
+      append_escaped (str, event->name);
+      g_string_append_printf (str,
+                              "\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ","
+                              "\"pid\":%d,\"tid\":%d",
+                              event->phase,
+                              event->time - gBeginTime,
+                              pid,
+                              event->thread);
+      if (event->phase == 'i')
+        g_string_append (str, ",\"s\":\"t\"");
+      g_string_append_c (str, '}');
+    }
+
+  g_string_append (str, "\n],\"displayTimeUnit\":\"ms\"");
+  if (gTruncated)
+    g_string_append (str, ",\"otherData\":{\"truncated\":\"true\"}");
+  g_string_append (str, "}\n");
+
+  if (!g_file_set_contents (gFilename, str->str, str->len, &error))
+    {
+      g_warning ("Failed to write trace: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  g_string_free (str, TRUE);
+  g_clear_pointer (&gEvents, g_array_unref);
+  g_clear_pointer (&gFilename, g_free);
+}
@@ -0,0 +1,35 @@
+/* gb-trace.h
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_TRACE_H
+#define GB_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void     gb_trace_init       (void);
+void     gb_trace_shutdown   (void);
+gboolean gb_trace_is_enabled (void);
+void     gb_trace_begin      (const gchar *name);
+void     gb_trace_end        (const gchar *name);
+void     gb_trace_instant    (const gchar *name);
+
+G_END_DECLS
+
+#endif /* GB_TRACE_H */
@@ -33,6 +33,9 @@ main (int   argc,
   GApplication *app;
   int ret;
 
+  gb_trace_init ();
+  gb_trace_begin ("main");
+
   g_set_prgname ("gnome-builder");
   g_set_application_name (_("Builder"));
 
@@ -52,6 +55,8 @@ main (int   argc,
   ret = g_application_run (app, argc, argv);
   g_clear_object (&app);
 
+  gb_trace_end ("main");
+  gb_trace_shutdown ();
   gb_log_shutdown ();
 
   return ret;
@@ -28,8 +28,10 @@ struct _GbSourceSnippetChunkPrivate
   guint                   context_changed_handler;
   gint                    tab_stop;
   gchar                  *spec;
+  GbSourceSnippetTemplate *template;
   gchar                  *text;
-  gboolean                text_set;
+  guint                   text_set : 1;
+  guint                   expanded : 1;
 };
 
 enum {
@@ -77,12 +79,31 @@ on_context_changed (GbSourceSnippetContext *context,
 
   priv = chunk->priv;
 
-  if (!priv->text_set)
+  if (priv->text_set)
+    return;
+
+  if (!priv->template)
     {
-      text = gb_source_snippet_context_expand (context, priv->spec);
-      gb_source_snippet_chunk_set_text (chunk, text);
-      g_free (text);
+      const gchar *spec = priv->spec ? priv->spec : "";
+
+      priv->template = gb_source_snippet_context_compile (context, spec);
     }
+
+  /*
+   * The expanded text is kept in priv->text, so only expand again if one of
+   * the variables referenced by the spec has changed.
+   */
+  if (priv->expanded &&
+      !gb_source_snippet_context_template_is_dirty (context, priv->template))
+    return;
+
+  text = gb_source_snippet_context_expand_template (context, priv->template);
+  priv->expanded = TRUE;
+
+  if (!!g_strcmp0 (text, priv->text))
+    gb_source_snippet_chunk_set_text (chunk, text);
+
+  g_free (text);
 }
 
 GbSourceSnippetContext *
@@ -114,6 +135,7 @@ gb_source_snippet_chunk_set_context (GbSourceSnippetChunk   *chunk,
         }
 
       g_clear_object (&chunk->priv->context);
+      priv->expanded = FALSE;
 
       if (context)
         {
@@ -145,6 +167,8 @@ gb_source_snippet_chunk_set_spec (GbSourceSnippetChunk *chunk,
 
   g_free (chunk->priv->spec);
   chunk->priv->spec = g_strdup (spec);
+  g_clear_pointer (&chunk->priv->template, gb_source_snippet_template_free);
+  chunk->priv->expanded = FALSE;
   g_object_notify_by_pspec (G_OBJECT (chunk), gParamSpecs[PROP_SPEC]);
 }
 
@@ -194,7 +218,8 @@ gb_source_snippet_chunk_set_text_set (GbSourceSnippetChunk *chunk,
                                       gboolean              text_set)
 {
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CHUNK (chunk));
-  chunk->priv->text_set = text_set;
+  chunk->priv->text_set = !!text_set;
+  chunk->priv->expanded = FALSE;
   g_object_notify_by_pspec (G_OBJECT (chunk), gParamSpecs[PROP_TEXT_SET]);
 }
 
@@ -206,6 +231,7 @@ gb_source_snippet_chunk_finalize (GObject *object)
   priv = GB_SOURCE_SNIPPET_CHUNK (object)->priv;
 
   g_clear_pointer (&priv->spec, g_free);
+  g_clear_pointer (&priv->template, gb_source_snippet_template_free);
   g_clear_pointer (&priv->text, g_free);
   g_clear_object (&priv->context);
 
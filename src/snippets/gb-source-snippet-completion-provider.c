@@ -22,6 +22,8 @@
 #include "gb-source-snippet-completion-item.h"
 #include "gb-source-snippet-completion-provider.h"
 
+#define MAX_PROPOSALS 100
+
 static void init_provider (GtkSourceCompletionProviderIface *iface);
 
 G_DEFINE_TYPE_EXTENDED (GbSourceSnippetCompletionProvider,
@@ -37,13 +39,6 @@ struct _GbSourceSnippetCompletionProviderPrivate
   GbSourceSnippets *snippets;
 };
 
-typedef struct
-{
-  GtkSourceCompletionProvider *provider;
-  gchar                       *word;
-  GList                       *list;
-} SearchState;
-
 enum {
   PROP_0,
   PROP_SNIPPETS,
@@ -262,30 +257,16 @@ provider_get_name (GtkSourceCompletionProvider *provider)
   return g_strdup (_("Snippets"));
 }
 
-static void
-foreach_snippet (gpointer data,
-                 gpointer user_data)
-{
-  GtkSourceCompletionProposal *item;
-  GbSourceSnippet *snippet = data;
-  SearchState *state = user_data;
-  const char *trigger;
-
-  trigger = gb_source_snippet_get_trigger (snippet);
-  if (!g_str_has_prefix (trigger, state->word))
-    return;
-
-  item = gb_source_snippet_completion_item_new (snippet);
-  state->list = g_list_append (state->list, item);
-}
-
 static void
 provider_populate (GtkSourceCompletionProvider *provider,
                    GtkSourceCompletionContext  *context)
 {
   GbSourceSnippetCompletionProviderPrivate *priv;
-  SearchState state = { 0 };
   GtkTextIter iter;
+  GList *snippets = NULL;
+  GList *list = NULL;
+  GList *l;
+  gchar *word;
 
   priv = GB_SOURCE_SNIPPET_COMPLETION_PROVIDER (provider)->priv;
 
@@ -297,23 +278,29 @@ provider_populate (GtkSourceCompletionProvider *provider,
 
   gtk_source_completion_context_get_iter (context, &iter);
 
-  state.list = NULL;
-  state.provider = provider;
-  state.word = get_word (provider, &iter);
+  word = get_word (provider, &iter);
+
+  /*
+   * The snippets are already sorted and limited for us, so this only costs
+   * as much as the number of proposals we show.
+   */
+  if (word && *word)
+    snippets = gb_source_snippets_query (priv->snippets, word, MAX_PROPOSALS);
 
-  if (state.word && *state.word)
-    gb_source_snippets_foreach (priv->snippets, state.word, foreach_snippet,
-                                &state);
+  for (l = snippets; l; l = l->next)
+    list = g_list_prepend (list, gb_source_snippet_completion_item_new (l->data));
+  list = g_list_reverse (list);
 
   /*
    * XXX: GtkSourceView seems to be warning quite a bit inside here
    *      right now about g_object_ref(). But ... it doesn't seem to be us?
    */
-  gtk_source_completion_context_add_proposals (context, provider, state.list, TRUE);
+  gtk_source_completion_context_add_proposals (context, provider, list, TRUE);
 
-  g_list_foreach (state.list, (GFunc) g_object_unref, NULL);
-  g_list_free (state.list);
-  g_free (state.word);
+  g_list_foreach (list, (GFunc) g_object_unref, NULL);
+  g_list_free (list);
+  g_list_free (snippets);
+  g_free (word);
 }
 
 static gboolean
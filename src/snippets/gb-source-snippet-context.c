@@ -42,9 +42,42 @@ struct _GbSourceSnippetContextPrivate
 {
   GHashTable *shared;
   GHashTable *variables;
+  GHashTable *dirty;
   gchar      *line_prefix;
   gint        tab_width;
   gboolean    use_spaces;
+  gboolean    all_dirty;
+};
+
+typedef enum
+{
+  OP_TEXT,
+  OP_TAB,
+  OP_NEWLINE,
+  OP_VARIABLE,
+  OP_VARIABLE_OR_STOP,
+  OP_VARIABLE_OR_LITERAL,
+  OP_TEMPLATE,
+} OpType;
+
+typedef struct
+{
+  OpType                   type;
+  gchar                   *str;
+  GbSourceSnippetTemplate *template;
+} Op;
+
+/*
+ * A chunk spec compiled into a list of operations, so that expanding it
+ * does not need to rescan the spec or look up filters by name. @keys
+ * contains every variable the template (or a nested template) refers to,
+ * which lets us skip expansion when none of them have changed.
+ */
+struct _GbSourceSnippetTemplate
+{
+  GArray    *ops;
+  GPtrArray *filters;
+  GPtrArray *keys;
 };
 
 enum {
@@ -85,7 +118,11 @@ gb_source_snippet_context_clear_variables (GbSourceSnippetContext *context)
 {
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
 
-  g_hash_table_remove_all (context->priv->variables);
+  if (g_hash_table_size (context->priv->variables))
+    {
+      g_hash_table_remove_all (context->priv->variables);
+      context->priv->all_dirty = TRUE;
+    }
 }
 
 void
@@ -96,9 +133,15 @@ gb_source_snippet_context_add_variable (GbSourceSnippetContext *context,
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
   g_return_if_fail (key);
 
+  /* Only mark the variable dirty if it actually changed. */
+  if (g_hash_table_contains (context->priv->variables, key) &&
+      (g_strcmp0 (g_hash_table_lookup (context->priv->variables, key), value) == 0))
+    return;
+
   g_hash_table_replace (context->priv->variables,
                         g_strdup (key),
                         g_strdup (value));
+  g_hash_table_add (context->priv->dirty, g_strdup (key));
 }
 
 const gchar *
@@ -380,42 +423,6 @@ filter_stripsuffix (const gchar *input)
   return g_strdup (input);
 }
 
-static gchar *
-apply_filter (gchar       *input,
-              const gchar *filter)
-{
-  InputFilter filter_func;
-  gchar *tmp;
-
-  filter_func = g_hash_table_lookup (gFilters, filter);
-  if (filter_func)
-    {
-      tmp = input;
-      input = filter_func (input);
-      g_free (tmp);
-    }
-
-  return input;
-}
-
-static gchar *
-apply_filters (GString     *str,
-               const gchar *filters_list)
-{
-  gchar **filter_names;
-  gchar *input = g_string_free (str, FALSE);
-  gint i;
-
-  filter_names = g_strsplit (filters_list, "|", 0);
-
-  for (i = 0; filter_names[i]; i++)
-    input = apply_filter (input, filter_names[i]);
-
-  g_strfreev (filter_names);
-
-  return input;
-}
-
 static gchar *
 scan_forward (const gchar  *input,
               const gchar **endpos,
@@ -439,28 +446,79 @@ scan_forward (const gchar  *input,
   return NULL;
 }
 
-gchar *
-gb_source_snippet_context_expand (GbSourceSnippetContext *context,
-                                  const gchar            *input)
+static void
+template_flush_text (GbSourceSnippetTemplate *template,
+                     GString                 *text)
 {
-  GbSourceSnippetContextPrivate *priv;
-  const gchar *expand;
-  gunichar c;
+  Op op = { OP_TEXT };
+
+  if (text->len)
+    {
+      op.str = g_strndup (text->str, text->len);
+      g_array_append_val (template->ops, op);
+      g_string_truncate (text, 0);
+    }
+}
+
+static void
+template_add_op (GbSourceSnippetTemplate *template,
+                 GString                 *text,
+                 OpType                   type,
+                 gchar                   *str)
+{
+  Op op = { type, str };
+
+  template_flush_text (template, text);
+  g_array_append_val (template->ops, op);
+
+  if (str && (type != OP_TEXT))
+    g_ptr_array_add (template->keys, g_strdup (str));
+}
+
+static void
+op_clear (gpointer data)
+{
+  Op *op = data;
+
+  g_free (op->str);
+  g_clear_pointer (&op->template, gb_source_snippet_template_free);
+}
+
+void
+gb_source_snippet_template_free (GbSourceSnippetTemplate *template)
+{
+  if (template)
+    {
+      g_array_unref (template->ops);
+      g_clear_pointer (&template->filters, g_ptr_array_unref);
+      g_ptr_array_unref (template->keys);
+      g_free (template);
+    }
+}
+
+static GbSourceSnippetTemplate *
+template_compile (const gchar *input)
+{
+  GbSourceSnippetTemplate *template;
   gboolean is_dynamic;
-  GString *str;
-  gchar key[12];
+  GString *text;
+  gunichar c;
   glong n;
-  gint i;
+  guint i;
 
-  g_return_val_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context), NULL);
-  g_return_val_if_fail (input, NULL);
-
-  priv = context->priv;
+  template = g_new0 (GbSourceSnippetTemplate, 1);
+  template->ops = g_array_new (FALSE, FALSE, sizeof (Op));
+  g_array_set_clear_func (template->ops, op_clear);
+  template->keys = g_ptr_array_new_with_free_func (g_free);
 
   is_dynamic = (*input == '$');
 
-  str = g_string_new (NULL);
+  text = g_string_new (NULL);
 
+  /*
+   * This mirrors the rules that used to be applied while expanding, so see
+   * gb_source_snippet_context_expand_template() for how each op is applied.
+   */
   for (; *input; input = g_utf8_next_char (input))
     {
       c = g_utf8_get_char (input);
@@ -484,46 +542,45 @@ gb_source_snippet_context_expand (GbSourceSnippetContext *context,
               if (((n == LONG_MIN) || (n == LONG_MAX)) && errno == ERANGE)
                 break;
               input--;
-              g_snprintf (key, sizeof key, "%ld", n);
-              key[sizeof key - 1] = '\0';
-              expand = gb_source_snippet_context_get_variable (context, key);
-              if (expand)
-                g_string_append (str, expand);
+              template_add_op (template, text, OP_VARIABLE,
+                               g_strdup_printf ("%ld", n));
+              continue;
+            }
+          else if (strchr (input, '|'))
+            {
+              const gchar *bar = strchr (input, '|');
+
+              template_add_op (template, text, OP_VARIABLE_OR_STOP,
+                               g_strndup (input, bar - input));
+              input = bar - 1;
               continue;
             }
           else
             {
-              if (strchr (input, '|'))
-                {
-                  gchar *lkey;
-
-                  lkey = g_strndup (input, strchr (input, '|') - input);
-                  expand = gb_source_snippet_context_get_variable (context, lkey);
-                  if (expand)
-                    {
-                      g_string_append (str, expand);
-                      input = strchr (input, '|') - 1;
-                    }
-                  else
-                    input += strlen (input) - 1;
-                }
-              else
-                {
-                  expand = gb_source_snippet_context_get_variable (context, input);
-                  if (expand)
-                    g_string_append (str, expand);
-                  else
-                    {
-                      g_string_append_c (str, '$');
-                      g_string_append (str, input);
-                    }
-                  input += strlen (input) - 1;
-                }
+              template_add_op (template, text, OP_VARIABLE_OR_LITERAL,
+                               g_strdup (input));
+              input += strlen (input) - 1;
               continue;
             }
         }
       else if (is_dynamic && c == '|')
-        return apply_filters (str, input + 1);
+        {
+          gchar **filter_names;
+
+          filter_names = g_strsplit (input + 1, "|", 0);
+          template->filters = g_ptr_array_new ();
+
+          for (i = 0; filter_names [i]; i++)
+            {
+              InputFilter filter_func;
+
+              if ((filter_func = g_hash_table_lookup (gFilters, filter_names [i])))
+                g_ptr_array_add (template->filters, filter_func);
+            }
+
+          g_strfreev (filter_names);
+          break;
+        }
       else if (c == '`')
         {
           const gchar *endpos = NULL;
@@ -533,15 +590,18 @@ gb_source_snippet_context_expand (GbSourceSnippetContext *context,
 
           if (slice)
             {
-              gchar *expanded;
+              Op op = { OP_TEMPLATE };
 
               input = endpos;
 
-              expanded = gb_source_snippet_context_expand (context, slice);
+              op.template = template_compile (slice);
+              template_flush_text (template, text);
+              g_array_append_val (template->ops, op);
 
-              g_string_append (str, expanded);
+              for (i = 0; i < op.template->keys->len; i++)
+                g_ptr_array_add (template->keys,
+                                 g_strdup (g_ptr_array_index (op.template->keys, i)));
 
-              g_free (expanded);
               g_free (slice);
 
               continue;
@@ -549,25 +609,184 @@ gb_source_snippet_context_expand (GbSourceSnippetContext *context,
         }
       else if (c == '\t')
         {
-          if (priv->use_spaces)
-            for (i = 0; i < priv->tab_width; i++)
-              g_string_append_c (str, ' ');
-
-          else
-            g_string_append_c (str, '\t');
+          template_add_op (template, text, OP_TAB, NULL);
           continue;
         }
       else if (c == '\n')
         {
+          template_add_op (template, text, OP_NEWLINE, NULL);
+          continue;
+        }
+      g_string_append_unichar (text, c);
+    }
+
+  template_flush_text (template, text);
+  g_string_free (text, TRUE);
+
+  return template;
+}
+
+/**
+ * gb_source_snippet_context_compile:
+ * @context: A #GbSourceSnippetContext.
+ * @spec: The spec of a #GbSourceSnippetChunk.
+ *
+ * Compiles @spec so that it can be expanded repeatedly with
+ * gb_source_snippet_context_expand_template().
+ *
+ * Returns: (transfer full): A #GbSourceSnippetTemplate that should be freed
+ *   with gb_source_snippet_template_free().
+ */
+GbSourceSnippetTemplate *
+gb_source_snippet_context_compile (GbSourceSnippetContext *context,
+                                   const gchar            *spec)
+{
+  g_return_val_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context), NULL);
+  g_return_val_if_fail (spec, NULL);
+
+  return template_compile (spec);
+}
+
+gchar *
+gb_source_snippet_context_expand_template (GbSourceSnippetContext  *context,
+                                           GbSourceSnippetTemplate *template)
+{
+  GbSourceSnippetContextPrivate *priv;
+  const gchar *expand;
+  GString *str;
+  gchar *input;
+  guint i;
+  gint j;
+
+  g_return_val_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context), NULL);
+  g_return_val_if_fail (template, NULL);
+
+  priv = context->priv;
+
+  str = g_string_new (NULL);
+
+  for (i = 0; i < template->ops->len; i++)
+    {
+      const Op *op = &g_array_index (template->ops, Op, i);
+
+      switch (op->type)
+        {
+        case OP_TEXT:
+          g_string_append (str, op->str);
+          break;
+
+        case OP_TAB:
+          if (priv->use_spaces)
+            for (j = 0; j < priv->tab_width; j++)
+              g_string_append_c (str, ' ');
+          else
+            g_string_append_c (str, '\t');
+          break;
+
+        case OP_NEWLINE:
           g_string_append_c (str, '\n');
           if (priv->line_prefix)
             g_string_append (str, priv->line_prefix);
-          continue;
+          break;
+
+        case OP_VARIABLE:
+          if ((expand = gb_source_snippet_context_get_variable (context, op->str)))
+            g_string_append (str, expand);
+          break;
+
+        case OP_VARIABLE_OR_STOP:
+          /* Without the variable, the rest of the spec is dropped. */
+          if (!(expand = gb_source_snippet_context_get_variable (context, op->str)))
+            return g_string_free (str, FALSE);
+          g_string_append (str, expand);
+          break;
+
+        case OP_VARIABLE_OR_LITERAL:
+          if ((expand = gb_source_snippet_context_get_variable (context, op->str)))
+            g_string_append (str, expand);
+          else
+            {
+              g_string_append_c (str, '$');
+              g_string_append (str, op->str);
+            }
+          break;
+
+        case OP_TEMPLATE:
+          input = gb_source_snippet_context_expand_template (context, op->template);
+          g_string_append (str, input);
+          g_free (input);
+          break;
+
+        default:
+          g_assert_not_reached ();
         }
-      g_string_append_unichar (str, c);
     }
 
-  return g_string_free (str, FALSE);
+  input = g_string_free (str, FALSE);
+
+  if (template->filters)
+    {
+      for (i = 0; i < template->filters->len; i++)
+        {
+          InputFilter filter_func = g_ptr_array_index (template->filters, i);
+          gchar *tmp = input;
+
+          input = filter_func (input);
+          g_free (tmp);
+        }
+    }
+
+  return input;
+}
+
+/**
+ * gb_source_snippet_context_template_is_dirty:
+ * @context: A #GbSourceSnippetContext.
+ * @template: A #GbSourceSnippetTemplate.
+ *
+ * Checks if any of the variables used by @template have changed since the
+ * last time #GbSourceSnippetContext::changed was emitted. This is only
+ * meaningful from within a handler of that signal.
+ *
+ * Returns: %TRUE if @template needs to be expanded again.
+ */
+gboolean
+gb_source_snippet_context_template_is_dirty (GbSourceSnippetContext  *context,
+                                             GbSourceSnippetTemplate *template)
+{
+  GbSourceSnippetContextPrivate *priv;
+  guint i;
+
+  g_return_val_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context), TRUE);
+  g_return_val_if_fail (template, TRUE);
+
+  priv = context->priv;
+
+  if (priv->all_dirty)
+    return TRUE;
+
+  for (i = 0; i < template->keys->len; i++)
+    if (g_hash_table_contains (priv->dirty, g_ptr_array_index (template->keys, i)))
+      return TRUE;
+
+  return FALSE;
+}
+
+gchar *
+gb_source_snippet_context_expand (GbSourceSnippetContext *context,
+                                  const gchar            *input)
+{
+  GbSourceSnippetTemplate *template;
+  gchar *ret;
+
+  g_return_val_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context), NULL);
+  g_return_val_if_fail (input, NULL);
+
+  template = template_compile (input);
+  ret = gb_source_snippet_context_expand_template (context, template);
+  gb_source_snippet_template_free (template);
+
+  return ret;
 }
 
 void
@@ -576,6 +795,7 @@ gb_source_snippet_context_set_tab_width (GbSourceSnippetContext *context,
 {
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
   context->priv->tab_width = tab_width;
+  context->priv->all_dirty = TRUE;
 }
 
 void
@@ -584,6 +804,7 @@ gb_source_snippet_context_set_use_spaces (GbSourceSnippetContext *context,
 {
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
   context->priv->use_spaces = use_spaces;
+  context->priv->all_dirty = TRUE;
 }
 
 void
@@ -593,13 +814,19 @@ gb_source_snippet_context_set_line_prefix (GbSourceSnippetContext *context,
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
   g_free (context->priv->line_prefix);
   context->priv->line_prefix = g_strdup (line_prefix);
+  context->priv->all_dirty = TRUE;
 }
 
 void
 gb_source_snippet_context_emit_changed (GbSourceSnippetContext *context)
 {
   g_return_if_fail (GB_IS_SOURCE_SNIPPET_CONTEXT (context));
+
   g_signal_emit (context, gSignals[CHANGED], 0);
+
+  /* Every handler has seen the changes now. */
+  g_hash_table_remove_all (context->priv->dirty);
+  context->priv->all_dirty = FALSE;
 }
 
 static gchar *
@@ -637,6 +864,8 @@ gb_source_snippet_context_finalize (GObject *object)
 
   g_clear_pointer (&priv->shared, (GDestroyNotify) g_hash_table_unref);
   g_clear_pointer (&priv->variables, (GDestroyNotify) g_hash_table_unref);
+  g_clear_pointer (&priv->dirty, (GDestroyNotify) g_hash_table_unref);
+  g_free (priv->line_prefix);
 
   G_OBJECT_CLASS (gb_source_snippet_context_parent_class)->finalize (object);
 }
@@ -690,6 +919,11 @@ gb_source_snippet_context_init (GbSourceSnippetContext *context)
                                                     g_free,
                                                     g_free);
 
+  context->priv->dirty = g_hash_table_new_full (g_str_hash,
+                                                g_str_equal,
+                                                g_free,
+                                                NULL);
+
   context->priv->shared = g_hash_table_new_full (g_str_hash,
                                                  g_str_equal,
                                                  g_free,
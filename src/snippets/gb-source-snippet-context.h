@@ -34,6 +34,7 @@ G_BEGIN_DECLS
 typedef struct _GbSourceSnippetContext        GbSourceSnippetContext;
 typedef struct _GbSourceSnippetContextClass   GbSourceSnippetContextClass;
 typedef struct _GbSourceSnippetContextPrivate GbSourceSnippetContextPrivate;
+typedef struct _GbSourceSnippetTemplate       GbSourceSnippetTemplate;
 
 struct _GbSourceSnippetContext
 {
@@ -48,24 +49,31 @@ struct _GbSourceSnippetContextClass
   GObjectClass parent_class;
 };
 
-GType                   gb_source_snippet_context_get_type        (void);
-GbSourceSnippetContext *gb_source_snippet_context_new             (void);
-void                    gb_source_snippet_context_emit_changed    (GbSourceSnippetContext *context);
-void                    gb_source_snippet_context_clear_variables (GbSourceSnippetContext *context);
-void                    gb_source_snippet_context_add_variable    (GbSourceSnippetContext *context,
-                                                                   const gchar            *key,
-                                                                   const gchar            *value);
-const gchar            *gb_source_snippet_context_get_variable    (GbSourceSnippetContext *context,
-                                                                   const gchar            *key);
-gchar                  *gb_source_snippet_context_expand          (GbSourceSnippetContext *context,
-                                                                   const gchar            *input);
-void                    gb_source_snippet_context_set_tab_width   (GbSourceSnippetContext *context,
-                                                                   gint                    tab_size);
-void                    gb_source_snippet_context_set_use_spaces  (GbSourceSnippetContext *context,
-                                                                   gboolean                use_spaces);
-void                    gb_source_snippet_context_set_line_prefix (GbSourceSnippetContext *context,
-                                                                   const gchar            *line_prefix);
-void                    gb_source_snippet_context_dump            (GbSourceSnippetContext *context);
+GType                    gb_source_snippet_context_get_type          (void);
+GbSourceSnippetContext  *gb_source_snippet_context_new               (void);
+void                     gb_source_snippet_context_emit_changed      (GbSourceSnippetContext  *context);
+void                     gb_source_snippet_context_clear_variables   (GbSourceSnippetContext  *context);
+void                     gb_source_snippet_context_add_variable      (GbSourceSnippetContext  *context,
+                                                                      const gchar             *key,
+                                                                      const gchar             *value);
+const gchar             *gb_source_snippet_context_get_variable      (GbSourceSnippetContext  *context,
+                                                                      const gchar             *key);
+gchar                   *gb_source_snippet_context_expand            (GbSourceSnippetContext  *context,
+                                                                      const gchar             *input);
+GbSourceSnippetTemplate *gb_source_snippet_context_compile           (GbSourceSnippetContext  *context,
+                                                                      const gchar             *spec);
+gchar                   *gb_source_snippet_context_expand_template   (GbSourceSnippetContext  *context,
+                                                                      GbSourceSnippetTemplate *template);
+gboolean                 gb_source_snippet_context_template_is_dirty (GbSourceSnippetContext  *context,
+                                                                      GbSourceSnippetTemplate *template);
+void                     gb_source_snippet_template_free             (GbSourceSnippetTemplate *template);
+void                     gb_source_snippet_context_set_tab_width     (GbSourceSnippetContext  *context,
+                                                                      gint                     tab_size);
+void                     gb_source_snippet_context_set_use_spaces    (GbSourceSnippetContext  *context,
+                                                                      gboolean                 use_spaces);
+void                     gb_source_snippet_context_set_line_prefix   (GbSourceSnippetContext  *context,
+                                                                      const gchar             *line_prefix);
+void                     gb_source_snippet_context_dump              (GbSourceSnippetContext  *context);
 
 G_END_DECLS
 
@@ -627,6 +627,11 @@ gb_source_snippet_rewrite_updated_chunks (GbSourceSnippet *snippet)
   for (i = 0; i < priv->chunks->len; i++)
     {
       chunk = g_ptr_array_index (priv->chunks, i);
+
+      /* Chunks with text-set already have their text taken from the buffer. */
+      if (gb_source_snippet_chunk_get_text_set (chunk))
+        continue;
+
       text = gb_source_snippet_chunk_get_text (chunk);
       real_text = gb_source_snippet_get_nth_text (snippet, i);
       if (!!g_strcmp0 (text, real_text))
@@ -19,107 +19,389 @@
 #define G_LOG_DOMAIN "snippets"
 
 #include <glib/gi18n.h>
+#include <string.h>
 
+#include "gb-source-snippet-chunk.h"
 #include "gb-source-snippets-manager.h"
 
+/*
+ * Snippets are loaded for a language the first time a buffer of that
+ * language asks for them. Parsing happens in a worker thread, and the parsed
+ * snippets are written to a cache in $XDG_CACHE_HOME. The cache records the
+ * mtime and size of every source it was built from, so we only parse again
+ * when one of them changes. Bundled resources have no mtime, so a checksum
+ * of their contents is recorded instead.
+ *
+ * Until loading completes, gb_source_snippets_manager_get_for_language()
+ * returns an empty #GbSourceSnippets which is filled in once the snippets
+ * are available.
+ */
+
 struct _GbSourceSnippetsManagerPrivate
 {
   GHashTable *by_language_id;
 };
 
+typedef struct
+{
+  GPtrArray *sources;
+  gchar     *cache_path;
+} LoadState;
+
 G_DEFINE_TYPE_WITH_PRIVATE (GbSourceSnippetsManager,
                             gb_source_snippets_manager,
                             G_TYPE_OBJECT)
 
 #define SNIPPETS_DIRECTORY "/org/gnome/builder/snippets/"
+#define CACHE_VERSION      2
+#define CACHE_FORMAT       "(ua(sxx)a(sa(si)))"
+#define STAMPS_FORMAT      "a(sxx)"
 
-static gboolean
-gb_source_snippets_manager_load_file (GbSourceSnippetsManager *manager,
-                                      GFile                   *file,
-                                      const gchar             *force_lang,
-                                      GError                 **error)
+static void
+load_state_free (gpointer data)
 {
-  GbSourceSnippets *snippets;
-  gchar *base = NULL;
+  LoadState *state = data;
 
-  g_return_val_if_fail (GB_IS_SOURCE_SNIPPETS_MANAGER (manager), FALSE);
-  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_ptr_array_unref (state->sources);
+  g_free (state->cache_path);
+  g_free (state);
+}
 
-  if (!force_lang)
+static void
+add_sources_for_language (GPtrArray   *sources,
+                          const gchar *language_id)
+{
+  gchar *name;
+  gchar *path;
+
+  name = g_strdup_printf ("%s.snippets", language_id);
+
+  path = g_strdup_printf ("resource://"SNIPPETS_DIRECTORY"%s", name);
+  g_ptr_array_add (sources, g_file_new_for_uri (path));
+  g_free (path);
+
+  path = g_build_filename (g_get_user_config_dir (), "gnome-builder",
+                           "snippets", name, NULL);
+  g_ptr_array_add (sources, g_file_new_for_path (path));
+  g_free (path);
+
+  g_free (name);
+}
+
+/*
+ * Returns the leading 64 bits of the SHA-1 digest of @bytes.
+ */
+static gint64
+resource_checksum (GBytes *bytes)
+{
+  GChecksum *checksum;
+  guint8 digest [20];
+  gsize digest_len = sizeof digest;
+  gint64 ret;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum,
+                     g_bytes_get_data (bytes, NULL),
+                     g_bytes_get_size (bytes));
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  g_checksum_free (checksum);
+
+  memcpy (&ret, digest, sizeof ret);
+
+  return ret;
+}
+
+/*
+ * Builds the list of (uri, mtime or checksum, size) for the sources that
+ * exist. This is compared against the list stored in the cache to determine
+ * if it is stale.
+ */
+static GVariant *
+build_stamps (GPtrArray *sources)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (STAMPS_FORMAT));
+
+  for (i = 0; i < sources->len; i++)
     {
-      base = g_file_get_basename (file);
+      GFile *file = g_ptr_array_index (sources, i);
+      gchar *uri = g_file_get_uri (file);
 
-      if (!base)
+      if (g_file_has_uri_scheme (file, "resource"))
         {
-          g_set_error (error,
-                       G_IO_ERROR,
-                       G_IO_ERROR_INVAL,
-                       _("The file is invalid."));
-          return FALSE;
+          GBytes *bytes;
+
+          /*
+           * Resources are compiled in and have no mtime, and an edit may
+           * not change their size. Use a checksum of their contents instead.
+           */
+          bytes = g_resources_lookup_data (uri + strlen ("resource://"),
+                                           G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                           NULL);
+
+          if (bytes)
+            {
+              g_variant_builder_add (&builder, "(sxx)", uri,
+                                     resource_checksum (bytes),
+                                     (gint64)g_bytes_get_size (bytes));
+              g_bytes_unref (bytes);
+            }
         }
+      else
+        {
+          GFileInfo *info;
 
-      if (strstr (base, "."))
-        *strstr (base, ".") = '\0';
+          info = g_file_query_info (file,
+                                    G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                    G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                    G_FILE_QUERY_INFO_NONE,
+                                    NULL, NULL);
 
-      force_lang = base;
+          if (info)
+            {
+              g_variant_builder_add (&builder, "(sxx)", uri,
+                                     (gint64)g_file_info_get_attribute_uint64 (
+                                       info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                                     (gint64)g_file_info_get_size (info));
+              g_object_unref (info);
+            }
+        }
+
+      g_free (uri);
     }
 
-  snippets = g_hash_table_lookup (manager->priv->by_language_id, force_lang);
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
 
-  if (!snippets)
-    {
-      snippets = gb_source_snippets_new ();
-      g_hash_table_insert (manager->priv->by_language_id,
-                           g_strdup (force_lang),
-                           snippets);
-    }
+static void
+serialize_snippet (gpointer data,
+                   gpointer user_data)
+{
+  GbSourceSnippet *snippet = data;
+  GVariantBuilder *builder = user_data;
+  guint n_chunks;
+  guint i;
 
-  g_free (base);
+  g_variant_builder_open (builder, G_VARIANT_TYPE ("(sa(si))"));
+  g_variant_builder_add (builder, "s", gb_source_snippet_get_trigger (snippet));
+  g_variant_builder_open (builder, G_VARIANT_TYPE ("a(si)"));
 
-  if (!gb_source_snippets_load_from_file (snippets, file, error))
-    return FALSE;
+  n_chunks = gb_source_snippet_get_n_chunks (snippet);
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      GbSourceSnippetChunk *chunk;
+      const gchar *spec;
 
-  return TRUE;
+      chunk = gb_source_snippet_get_nth_chunk (snippet, i);
+      spec = gb_source_snippet_chunk_get_spec (chunk);
+      g_variant_builder_add (builder, "(si)", spec ? spec : "",
+                             gb_source_snippet_chunk_get_tab_stop (chunk));
+    }
+
+  g_variant_builder_close (builder);
+  g_variant_builder_close (builder);
 }
 
 static void
-gb_source_snippets_manager_load_directory (GbSourceSnippetsManager *manager,
-                                           const gchar             *path)
+write_cache (LoadState        *state,
+             GVariant         *stamps,
+             GbSourceSnippets *snippets)
 {
-  const gchar *name;
+  GVariantBuilder builder;
+  GVariant *variant;
   GError *error = NULL;
-  gchar *filename;
-  GFile *file;
-  GDir *dir;
+  gchar *dir;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (CACHE_FORMAT));
+  g_variant_builder_add (&builder, "u", CACHE_VERSION);
+  g_variant_builder_add_value (&builder, stamps);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(sa(si))"));
+  gb_source_snippets_foreach (snippets, NULL, serialize_snippet, &builder);
+  g_variant_builder_close (&builder);
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
 
-  dir = g_dir_open (path, 0, &error);
-  if (!dir)
+  dir = g_path_get_dirname (state->cache_path);
+  g_mkdir_with_parents (dir, 0700);
+
+  if (!g_file_set_contents (state->cache_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
     {
-      g_warning (_("Failed to open directory: %s"),
-                 error->message);
-      g_error_free (error);
-      return;
+      g_message ("Failed to write snippet cache: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  g_free (dir);
+  g_variant_unref (variant);
+}
+
+static GbSourceSnippets *
+read_cache (LoadState *state,
+            GVariant  *stamps)
+{
+  GbSourceSnippets *snippets = NULL;
+  GMappedFile *mapped;
+  GVariantIter *iter = NULL;
+  GVariant *cached_stamps = NULL;
+  GVariant *variant;
+  GBytes *bytes;
+  const gchar *trigger;
+  GVariantIter *chunks;
+  guint version = 0;
+
+  if (!(mapped = g_mapped_file_new (state->cache_path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_FORMAT),
+                                                          bytes, FALSE));
+  g_variant_get (variant, "(u@"STAMPS_FORMAT"a(sa(si)))",
+                 &version, &cached_stamps, &iter);
+
+  if ((version != CACHE_VERSION) || !g_variant_equal (cached_stamps, stamps))
+    goto cleanup;
+
+  snippets = gb_source_snippets_new ();
+
+  while (g_variant_iter_next (iter, "(&sa(si))", &trigger, &chunks))
+    {
+      GbSourceSnippet *snippet;
+      const gchar *spec;
+      gint tab_stop;
+
+      snippet = gb_source_snippet_new (trigger);
+
+      while (g_variant_iter_next (chunks, "(&si)", &spec, &tab_stop))
+        {
+          GbSourceSnippetChunk *chunk;
+
+          chunk = gb_source_snippet_chunk_new ();
+          gb_source_snippet_chunk_set_spec (chunk, spec);
+          gb_source_snippet_chunk_set_tab_stop (chunk, tab_stop);
+          gb_source_snippet_add_chunk (snippet, chunk);
+          g_object_unref (chunk);
+        }
+
+      g_variant_iter_free (chunks);
+
+      gb_source_snippets_add (snippets, snippet);
+      g_object_unref (snippet);
     }
 
-  while ((name = g_dir_read_name (dir)))
+cleanup:
+  g_clear_pointer (&iter, g_variant_iter_free);
+  g_clear_pointer (&cached_stamps, g_variant_unref);
+  g_variant_unref (variant);
+  g_bytes_unref (bytes);
+  g_mapped_file_unref (mapped);
+
+  return snippets;
+}
+
+static void
+gb_source_snippets_manager_load_worker (GTask        *task,
+                                        gpointer      source_object,
+                                        gpointer      task_data,
+                                        GCancellable *cancellable)
+{
+  LoadState *state = task_data;
+  GbSourceSnippets *snippets;
+  GVariant *stamps;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (state);
+
+  stamps = build_stamps (state->sources);
+
+  if (!(snippets = read_cache (state, stamps)))
     {
-      if (g_str_has_suffix (name, ".snippets"))
+      snippets = gb_source_snippets_new ();
+
+      for (i = 0; i < state->sources->len; i++)
         {
-          filename = g_build_filename (path, name, NULL);
-          file = g_file_new_for_path (filename);
-          if (!gb_source_snippets_manager_load_file (manager, file,
-                                                     NULL, &error))
+          GFile *file = g_ptr_array_index (state->sources, i);
+          GError *error = NULL;
+
+          if (!g_file_query_exists (file, NULL))
+            continue;
+
+          if (!gb_source_snippets_load_from_file (snippets, file, &error))
             {
-              g_warning (_("Failed to load file: %s: %s"),
-                         filename, error->message);
+              g_message ("%s", error->message);
               g_clear_error (&error);
             }
-          g_object_unref (file);
-          g_free (filename);
         }
+
+      write_cache (state, stamps, snippets);
     }
 
-  g_dir_close (dir);
+  g_variant_unref (stamps);
+
+  g_task_return_pointer (task, snippets, g_object_unref);
+}
+
+static void
+gb_source_snippets_manager_load_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  GbSourceSnippets *target = user_data;
+  GbSourceSnippets *snippets;
+
+  g_assert (G_IS_TASK (result));
+  g_assert (GB_IS_SOURCE_SNIPPETS (target));
+
+  if ((snippets = g_task_propagate_pointer (G_TASK (result), NULL)))
+    {
+      gb_source_snippets_merge (target, snippets);
+      g_object_unref (snippets);
+    }
+
+  g_object_unref (target);
+}
+
+static void
+gb_source_snippets_manager_load_async (GbSourceSnippetsManager *manager,
+                                       const gchar             *language_id,
+                                       GbSourceSnippets        *target)
+{
+  LoadState *state;
+  GTask *task;
+  gchar *name;
+
+  g_assert (GB_IS_SOURCE_SNIPPETS_MANAGER (manager));
+  g_assert (language_id);
+  g_assert (GB_IS_SOURCE_SNIPPETS (target));
+
+  state = g_new0 (LoadState, 1);
+  state->sources = g_ptr_array_new_with_free_func (g_object_unref);
+
+  /*
+   * chdr is the combination of the "c" snippets and the chdr snippets on
+   * top of that. This way, you don't need to write all of your snippets
+   * twice, for both "c" and "chdr".
+   */
+  if (g_str_equal (language_id, "chdr"))
+    add_sources_for_language (state->sources, "c");
+  add_sources_for_language (state->sources, language_id);
+
+  name = g_strdup_printf ("%s.cache", language_id);
+  state->cache_path = g_build_filename (g_get_user_cache_dir (),
+                                        "gnome-builder", "snippets", name,
+                                        NULL);
+  g_free (name);
+
+  task = g_task_new (manager, NULL, gb_source_snippets_manager_load_cb,
+                     g_object_ref (target));
+  g_task_set_task_data (task, state, load_state_free);
+  g_task_run_in_thread (task, gb_source_snippets_manager_load_worker);
+  g_object_unref (task);
 }
 
 GbSourceSnippetsManager *
@@ -136,7 +418,6 @@ gb_source_snippets_manager_get_default (void)
                                "snippets",
                                NULL);
       g_mkdir_with_parents (path, 0700);
-      gb_source_snippets_manager_load_directory (instance, path);
       g_free (path);
       g_object_add_weak_pointer (G_OBJECT (instance),
                                  (gpointer *) &instance);
@@ -145,6 +426,17 @@ gb_source_snippets_manager_get_default (void)
   return instance;
 }
 
+/**
+ * gb_source_snippets_manager_get_for_language:
+ * @manager: A #GbSourceSnippetsManager.
+ * @language: A #GtkSourceLanguage.
+ *
+ * Gets the snippets for @language. The first time a language is requested,
+ * the snippets are loaded in the background and the returned
+ * #GbSourceSnippets will be populated once they are available.
+ *
+ * Returns: (transfer none): A #GbSourceSnippets.
+ */
 GbSourceSnippets *
 gb_source_snippets_manager_get_for_language (GbSourceSnippetsManager *manager,
                                              GtkSourceLanguage       *language)
@@ -161,78 +453,15 @@ gb_source_snippets_manager_get_for_language (GbSourceSnippetsManager *manager,
   language_id = gtk_source_language_get_id (language);
   snippets = g_hash_table_lookup (priv->by_language_id, language_id);
 
-  if (!snippets && g_str_equal (language_id, "chdr"))
-    snippets = g_hash_table_lookup (priv->by_language_id, "c");
-
-  return snippets;
-}
-
-static void
-gb_source_snippets_manager_preload_c (GbSourceSnippetsManager *manager)
-{
-  GFile *file;
-  gchar *path;
-
-  g_return_if_fail (GB_IS_SOURCE_SNIPPETS_MANAGER (manager));
-
-  file = g_file_new_for_uri ("resource://"SNIPPETS_DIRECTORY"c.snippets");
-  if (g_file_query_exists (file, NULL))
-    gb_source_snippets_manager_load_file (manager, file, "chdr", NULL);
-  g_clear_object (&file);
-
-  path = g_build_filename (g_get_user_config_dir (), "gnome-builder",
-                           "snippets", "c.snippets", NULL);
-  file = g_file_new_for_path (path);
-  if (g_file_query_exists (file, NULL))
-    gb_source_snippets_manager_load_file (manager, file, "chdr", NULL);
-  g_clear_object (&file);
-  g_free (path);
-}
-
-static void
-gb_source_snippets_manager_constructed (GObject *object)
-{
-  GbSourceSnippetsManager *manager = (GbSourceSnippetsManager *)object;
-  GError *error = NULL;
-  GFile *file;
-  gchar *path;
-  gchar **names;
-  guint i;
-
-  g_assert (GB_IS_SOURCE_SNIPPETS_MANAGER (manager));
-
-  /*
-   * We need to preload chdr so that it is the combination of the "c"
-   * snippets and the chdr snippets on top of that. This way, you don't
-   * need to write all of your snippets twice, for both "c" and "chdr".
-   */
-  gb_source_snippets_manager_preload_c (manager);
-
-  names = g_resources_enumerate_children (SNIPPETS_DIRECTORY,
-                                          G_RESOURCE_LOOKUP_FLAGS_NONE,
-                                          &error);
-
-  if (!names)
-    {
-      g_message ("%s", error->message);
-      g_clear_error (&error);
-      return;
-    }
-
-  for (i = 0; names[i]; i++)
+  if (!snippets)
     {
-      path = g_strdup_printf ("resource://"SNIPPETS_DIRECTORY"%s", names[i]);
-      file = g_file_new_for_uri (path);
-      if (!gb_source_snippets_manager_load_file (manager, file, NULL, &error))
-        {
-          g_message ("%s", error->message);
-          g_clear_error (&error);
-        }
-      g_free (path);
-      g_clear_object (&file);
+      snippets = gb_source_snippets_new ();
+      g_hash_table_insert (priv->by_language_id, g_strdup (language_id),
+                           snippets);
+      gb_source_snippets_manager_load_async (manager, language_id, snippets);
     }
 
-  g_strfreev (names);
+  return snippets;
 }
 
 static void
@@ -252,7 +481,6 @@ gb_source_snippets_manager_class_init (GbSourceSnippetsManagerClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
-  object_class->constructed = gb_source_snippets_manager_constructed;
   object_class->finalize = gb_source_snippets_manager_finalize;
 }
 
@@ -165,6 +165,56 @@ gb_source_snippets_foreach (GbSourceSnippets *snippets,
                  (gpointer) closure);
 }
 
+typedef struct
+{
+  GList *list;
+  guint  remaining;
+} QueryState;
+
+static gboolean
+gb_source_snippets_query_cb (Trie        *trie,
+                             const gchar *key,
+                             gpointer     value,
+                             gpointer     user_data)
+{
+  QueryState *state = user_data;
+
+  state->list = g_list_prepend (state->list, value);
+
+  return (--state->remaining == 0);
+}
+
+/**
+ * gb_source_snippets_query:
+ * @snippets: A #GbSourceSnippets.
+ * @prefix: (allow-none): The prefix of the triggers to match.
+ * @max_results: The maximum number of snippets to return, or 0 for no limit.
+ *
+ * Locates the snippets whose trigger begins with @prefix, sorted by trigger.
+ * Only the part of the trie below @prefix is walked, and the walk stops once
+ * @max_results snippets have been found.
+ *
+ * Returns: (transfer container) (element-type GbSourceSnippet): A #GList.
+ */
+GList *
+gb_source_snippets_query (GbSourceSnippets *snippets,
+                          const gchar      *prefix,
+                          guint             max_results)
+{
+  QueryState state = { NULL, max_results ? max_results : G_MAXUINT };
+
+  g_return_val_if_fail (GB_IS_SOURCE_SNIPPETS (snippets), NULL);
+
+  trie_traverse_sorted (snippets->priv->snippets,
+                        prefix ? prefix : "",
+                        G_TRAVERSE_LEAVES,
+                        -1,
+                        gb_source_snippets_query_cb,
+                        &state);
+
+  return g_list_reverse (state.list);
+}
+
 static void
 gb_source_snippets_finalize (GObject *object)
 {
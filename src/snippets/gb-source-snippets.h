@@ -64,6 +64,9 @@ void              gb_source_snippets_foreach        (GbSourceSnippets *snippets,
                                                      const gchar      *prefix,
                                                      GFunc             foreach_func,
                                                      gpointer          user_data);
+GList            *gb_source_snippets_query          (GbSourceSnippets *snippets,
+                                                     const gchar      *prefix,
+                                                     guint             max_results);
 
 G_END_DECLS
 
@@ -66,6 +66,16 @@ typedef struct _TrieNodeChunk TrieNodeChunk;
 #define TRIE_NODE_CHUNK_KEYS(c) (((c)->is_inline) ? 3 : 5)
 #endif
 
+/*
+ * Nodes and chunks are the same size, so they are carved out of slabs of
+ * TRIE_SLAB_BLOCKS blocks that are aligned to TRIE_NODE_SIZE.
+ */
+#define TRIE_BLOCK_SIZE         TRIE_NODE_SIZE
+#define TRIE_SLAB_BLOCKS        64
+
+#define TRIE_IMAGE_MAGIC        0x45495254 /* "TRIE" */
+#define TRIE_IMAGE_VERSION      1
+
 /**
  * TrieNodeChunk:
  * @flags: Flags describing behaviors of the TrieNodeChunk.
@@ -104,24 +114,107 @@ struct _TrieNode
 };
 #pragma pack(pop)
 
+/**
+ * TrieImageHeader:
+ * @magic: TRIE_IMAGE_MAGIC in host byte order.
+ * @version: TRIE_IMAGE_VERSION.
+ * @n_nodes: The number of #TrieImageNode following the header.
+ * @size: The size of the image in bytes, including values.
+ *
+ * The header of a serialized trie. See trie_serialize().
+ */
+typedef struct
+{
+   guint32 magic;
+   guint32 version;
+   guint32 n_nodes;
+   guint32 size;
+} TrieImageHeader;
+
+/**
+ * TrieImageNode:
+ * @value_offset: The offset of the value from the start of the image, or 0
+ *    if the node has no value.
+ * @value_length: The length of the value in bytes.
+ * @first_child: The index of the first child node. Nodes are stored in
+ *    breadth-first order, so the children of a node are contiguous and
+ *    sorted by key.
+ * @n_children: The number of children.
+ * @key: The key of the edge from the parent to this node.
+ *
+ * A node in a serialized trie. Nodes refer to each other by index rather
+ * than by pointer so that the image can be mapped at any address.
+ */
+typedef struct
+{
+   guint32 value_offset;
+   guint32 value_length;
+   guint32 first_child;
+   guint16 n_children;
+   guint8  key;
+   guint8  reserved;
+} TrieImageNode;
+
 /**
  * Trie:
  * @value_destroy: A #GDestroyNotify to free data pointers.
  * @root: The root TrieNode.
+ * @slabs: The slabs that nodes and chunks are allocated from.
+ * @free_list: A chain of released blocks, linked through their first
+ *    pointer.
+ * @slab_pos: The next unused block in the newest slab.
+ * @slab_end: The end of the newest slab.
+ * @mapped: The #GMappedFile for read-only tries created with
+ *    trie_new_from_mapped(), otherwise %NULL.
+ * @image: The contents of @mapped.
+ * @image_nodes: The node table within @image.
  */
 struct _Trie
 {
-   GDestroyNotify  value_destroy;
-   TrieNode       *root;
+   GDestroyNotify       value_destroy;
+   TrieNode            *root;
+   GPtrArray           *slabs;
+   gpointer             free_list;
+   guint8              *slab_pos;
+   guint8              *slab_end;
+   GMappedFile         *mapped;
+   const guint8        *image;
+   const TrieImageNode *image_nodes;
 };
 
+/**
+ * trie_add_slab:
+ * @trie: A #Trie.
+ *
+ * Allocates a new slab of blocks for @trie. The slab is over-allocated by
+ * one block so that the first block can be moved up to a TRIE_BLOCK_SIZE
+ * boundary, placing every node on a cacheline.
+ */
+static void
+trie_add_slab (Trie *trie)
+{
+   guint8 *slab;
+   gsize offset;
+
+   slab = g_malloc(TRIE_BLOCK_SIZE * (TRIE_SLAB_BLOCKS + 1));
+   g_ptr_array_add(trie->slabs, slab);
+
+   offset = GPOINTER_TO_SIZE(slab) % TRIE_BLOCK_SIZE;
+   if (offset) {
+      slab += TRIE_BLOCK_SIZE - offset;
+   }
+
+   trie->slab_pos = slab;
+   trie->slab_end = slab + (TRIE_BLOCK_SIZE * TRIE_SLAB_BLOCKS);
+}
+
 /**
  * trie_malloc0:
  * @trie: A #Trie
  * @size: Number of bytes to allocate.
  *
- * Wrapper function to allocate a memory chunk. This gives us somewhere to
- * perform the abstraction if we want to use mmap()'d I/O at some point.
+ * Wrapper function to allocate a memory chunk. Blocks are reused from the
+ * free list of @trie if possible, otherwise taken from the current slab.
  * The memory will be zero'd before being returned.
  *
  * Returns: A pointer to the allocation.
@@ -130,7 +223,24 @@ static gpointer
 trie_malloc0 (Trie  *trie,
               gsize  size)
 {
-   return g_malloc0(size);
+   gpointer ret;
+
+   g_assert(size <= TRIE_BLOCK_SIZE);
+
+   if (trie->free_list) {
+      ret = trie->free_list;
+      trie->free_list = *(gpointer *)ret;
+   } else {
+      if (trie->slab_pos == trie->slab_end) {
+         trie_add_slab(trie);
+      }
+      ret = trie->slab_pos;
+      trie->slab_pos += TRIE_BLOCK_SIZE;
+   }
+
+   memset(ret, 0, TRIE_BLOCK_SIZE);
+
+   return ret;
 }
 
 /**
@@ -138,13 +248,15 @@ trie_malloc0 (Trie  *trie,
  * @trie: A #Trie.
  * @data: The data to free.
  *
- * Frees a portion of memory allocated by @trie.
+ * Releases a block allocated by @trie back to its free list. The memory
+ * is only returned to the system by trie_destroy().
  */
 static void
 trie_free (Trie     *trie,
            gpointer  data)
 {
-   g_free(data);
+   *(gpointer *)data = trie->free_list;
+   trie->free_list = data;
 }
 
 /**
@@ -156,7 +268,7 @@ trie_free (Trie     *trie,
  * embedded in it that may contain only 4 pointers instead of the full 6 do
  * to the overhead of the TrieNode itself.
  *
- * Returns: A newly allocated TrieNode that should be freed with g_free().
+ * Returns: A newly allocated TrieNode that should be freed with trie_free().
  */
 TrieNode *
 trie_node_new (Trie     *trie,
@@ -353,7 +465,14 @@ trie_find_or_create_node (Trie     *trie,
             return iter->children[i];
          }
       }
-      last = iter;
+      /*
+       * Removals can leave empty chunks at the end of the chain, so append
+       * to the first chunk with a free slot. trie_node_move_to_front()
+       * relies on every chunk before the last used one being full.
+       */
+      if (!last || trie_node_chunk_is_full(last)) {
+         last = iter;
+      }
    }
 
    g_assert(last);
@@ -495,12 +614,73 @@ trie_new (GDestroyNotify value_destroy)
 #endif
 
    trie = g_new0(Trie, 1);
+   trie->slabs = g_ptr_array_new_with_free_func(g_free);
    trie->root = trie_node_new(trie, NULL);
    trie->value_destroy = value_destroy;
 
    return trie;
 }
 
+/**
+ * trie_image_node_value:
+ * @trie: A #Trie created with trie_new_from_mapped().
+ * @inode: A #TrieImageNode.
+ *
+ * Returns: (transfer none): A pointer to the value of @inode within the
+ *    image, or %NULL.
+ */
+static gpointer
+trie_image_node_value (Trie                *trie,
+                       const TrieImageNode *inode)
+{
+   g_assert(trie);
+   g_assert(inode);
+
+   if (!inode->value_offset) {
+      return NULL;
+   }
+
+   return (gpointer)(trie->image + inode->value_offset);
+}
+
+/**
+ * trie_image_find_node:
+ * @trie: A #Trie created with trie_new_from_mapped().
+ * @key: The key to find.
+ *
+ * Walks the image from the root node following @key.
+ *
+ * Returns: The #TrieImageNode for @key, or %NULL.
+ */
+static const TrieImageNode *
+trie_image_find_node (Trie        *trie,
+                      const gchar *key)
+{
+   const TrieImageNode *inode;
+   const TrieImageNode *child;
+   guint i;
+
+   g_assert(trie);
+   g_assert(key);
+
+   inode = &trie->image_nodes[0];
+
+   for (; *key; key++) {
+      child = &trie->image_nodes[inode->first_child];
+      for (i = 0; i < inode->n_children; i++) {
+         if (child[i].key >= (guint8)*key) {
+            break;
+         }
+      }
+      if ((i == inode->n_children) || (child[i].key != (guint8)*key)) {
+         return NULL;
+      }
+      inode = &child[i];
+   }
+
+   return inode;
+}
+
 /**
  * trie_insert:
  * @trie: A #Trie.
@@ -517,6 +697,7 @@ trie_insert (Trie        *trie,
    TrieNode *node;
 
    g_return_if_fail(trie);
+   g_return_if_fail(!trie->mapped);
    g_return_if_fail(key);
    g_return_if_fail(value);
 
@@ -555,6 +736,13 @@ trie_lookup (Trie        *trie,
    g_return_val_if_fail(trie, NULL);
    g_return_val_if_fail(key, NULL);
 
+   if (trie->mapped) {
+      const TrieImageNode *inode;
+
+      inode = trie_image_find_node(trie, key);
+      return inode ? trie_image_node_value(trie, inode) : NULL;
+   }
+
    node = trie->root;
 
    while (*key && node) {
@@ -582,6 +770,7 @@ trie_remove (Trie        *trie,
    TrieNode *node;
 
    g_return_val_if_fail(trie, FALSE);
+   g_return_val_if_fail(!trie->mapped, FALSE);
    g_return_val_if_fail(key, FALSE);
 
    node = trie->root;
@@ -736,6 +925,79 @@ trie_traverse_node_post_order (Trie             *trie,
    return ret;
 }
 
+/**
+ * trie_image_traverse_node:
+ * @trie: A #Trie created with trie_new_from_mapped().
+ * @inode: A #TrieImageNode.
+ * @str: The prefix for this node.
+ * @order: %G_PRE_ORDER or %G_POST_ORDER.
+ * @flags: The flags for which nodes to callback.
+ * @max_depth: the maximum depth to process.
+ * @func: The func to execute for each matching node.
+ * @user_data: User data for @func.
+ *
+ * Traverses a node of a mapped trie. Children are stored sorted by key, so
+ * this also implements trie_traverse_sorted() for mapped tries.
+ *
+ * Returns: %TRUE if traversal was cancelled; otherwise %FALSE.
+ */
+static gboolean
+trie_image_traverse_node (Trie                *trie,
+                          const TrieImageNode *inode,
+                          GString             *str,
+                          GTraverseType        order,
+                          GTraverseFlags       flags,
+                          gint                 max_depth,
+                          TrieTraverseFunc     func,
+                          gpointer             user_data)
+{
+   const TrieImageNode *child;
+   gpointer value;
+   gboolean matches;
+   guint i;
+
+   g_assert(trie);
+   g_assert(inode);
+   g_assert(str);
+
+   if (!max_depth) {
+      return FALSE;
+   }
+
+   value = trie_image_node_value(trie, inode);
+   matches = ((!value && (flags & G_TRAVERSE_NON_LEAVES)) ||
+              (value && (flags & G_TRAVERSE_LEAVES)));
+
+   if (matches && (order == G_PRE_ORDER)) {
+      if (func(trie, str->str, value, user_data)) {
+         return TRUE;
+      }
+   }
+
+   child = &trie->image_nodes[inode->first_child];
+
+   for (i = 0; i < inode->n_children; i++) {
+      g_string_append_c(str, child[i].key);
+      if (trie_image_traverse_node(trie,
+                                   &child[i],
+                                   str,
+                                   order,
+                                   flags,
+                                   max_depth - 1,
+                                   func,
+                                   user_data)) {
+         return TRUE;
+      }
+      g_string_truncate(str, str->len - 1);
+   }
+
+   if (matches && (order == G_POST_ORDER)) {
+      return func(trie, str->str, value, user_data);
+   }
+
+   return FALSE;
+}
+
 /**
  * trie_traverse:
  * @trie: A #Trie.
@@ -774,6 +1036,19 @@ trie_traverse (Trie             *trie,
 
    str = g_string_new(key);
 
+   if (trie->mapped) {
+      const TrieImageNode *inode;
+
+      if ((order != G_PRE_ORDER) && (order != G_POST_ORDER)) {
+         g_warning(_("Traversal order %u is not supported on Trie."), order);
+      } else if ((inode = trie_image_find_node(trie, key))) {
+         trie_image_traverse_node(trie, inode, str, order, flags,
+                                  max_depth, func, user_data);
+      }
+      g_string_free(str, TRUE);
+      return;
+   }
+
    while (*key && node) {
       node = trie_find_node(trie, node, *key);
       key++;
@@ -794,17 +1069,447 @@ trie_traverse (Trie             *trie,
    g_string_free(str, TRUE);
 }
 
+/**
+ * trie_node_get_sorted_children:
+ * @node: A #TrieNode.
+ * @keys: (out): Location for up to 256 keys.
+ * @children: (out): Location for up to 256 children.
+ *
+ * Collects the children of @node, sorted by their key.
+ *
+ * Returns: The number of children stored in @keys and @children.
+ */
+static guint
+trie_node_get_sorted_children (TrieNode  *node,
+                               guint8    *keys,
+                               TrieNode **children)
+{
+   TrieNodeChunk *iter;
+   guint n_children = 0;
+   guint i;
+   guint j;
+
+   g_assert(node);
+   g_assert(keys);
+   g_assert(children);
+
+   /*
+    * Nodes rarely have more than a handful of children, so an insertion
+    * sort on the stack is cheaper than anything fancier.
+    */
+   for (iter = &node->chunk; iter; iter = iter->next) {
+      for (i = 0; i < iter->count; i++) {
+         for (j = n_children; (j > 0) && (keys[j - 1] > iter->keys[i]); j--) {
+            keys[j] = keys[j - 1];
+            children[j] = children[j - 1];
+         }
+         keys[j] = iter->keys[i];
+         children[j] = iter->children[i];
+         n_children++;
+      }
+   }
+
+   return n_children;
+}
+
+/**
+ * trie_traverse_node_sorted:
+ * @trie: A #Trie.
+ * @node: A #TrieNode.
+ * @str: The prefix for this node.
+ * @flags: The flags for which nodes to callback.
+ * @max_depth: the maximum depth to process.
+ * @func: The func to execute for each matching node.
+ * @user_data: User data for @func.
+ *
+ * Like trie_traverse_node_pre_order() but visits the children of each node
+ * in order of their key, rather than the order they are stored in (which
+ * changes as nodes are moved to the front of their chunk chain).
+ *
+ * Returns: %TRUE if traversal was cancelled; otherwise %FALSE.
+ */
+static gboolean
+trie_traverse_node_sorted (Trie             *trie,
+                           TrieNode         *node,
+                           GString          *str,
+                           GTraverseFlags    flags,
+                           gint              max_depth,
+                           TrieTraverseFunc  func,
+                           gpointer          user_data)
+{
+   TrieNode *children[256];
+   guint8 keys[256];
+   guint n_children;
+   guint i;
+
+   g_assert(trie);
+   g_assert(node);
+   g_assert(str);
+
+   if (!max_depth) {
+      return FALSE;
+   }
+
+   if ((!node->value && (flags & G_TRAVERSE_NON_LEAVES)) ||
+       (node->value && (flags & G_TRAVERSE_LEAVES))) {
+      if (func(trie, str->str, node->value, user_data)) {
+         return TRUE;
+      }
+   }
+
+   n_children = trie_node_get_sorted_children(node, keys, children);
+
+   for (i = 0; i < n_children; i++) {
+      g_string_append_c(str, keys[i]);
+      if (trie_traverse_node_sorted(trie,
+                                    children[i],
+                                    str,
+                                    flags,
+                                    max_depth - 1,
+                                    func,
+                                    user_data)) {
+         return TRUE;
+      }
+      g_string_truncate(str, str->len - 1);
+   }
+
+   return FALSE;
+}
+
+/**
+ * trie_traverse_sorted:
+ * @trie: A #Trie.
+ * @key: The key to start traversal from.
+ * @flags: The flags for which nodes to callback.
+ * @max_depth: the maximum depth to process.
+ * @func: The func to execute for each matching node.
+ * @user_data: User data for @func.
+ *
+ * Traverses the nodes of @trie that are prefixed with @key in the byte order
+ * of their keys, so matches are visited in the same order strcmp() would
+ * sort them. Only the nodes below @key are visited, and traversal stops as
+ * soon as @func returns %TRUE, so the cost of collecting the first N matches
+ * does not depend on the size of @trie.
+ *
+ * If @max_depth is less than zero, the entire tree will be traversed.
+ */
+void
+trie_traverse_sorted (Trie             *trie,
+                      const gchar      *key,
+                      GTraverseFlags    flags,
+                      gint              max_depth,
+                      TrieTraverseFunc  func,
+                      gpointer          user_data)
+{
+   TrieNode *node;
+   GString *str;
+
+   g_return_if_fail(trie);
+   g_return_if_fail(func);
+
+   node = trie->root;
+   key = key ? key : "";
+
+   str = g_string_new(key);
+
+   if (trie->mapped) {
+      const TrieImageNode *inode;
+
+      if ((inode = trie_image_find_node(trie, key))) {
+         trie_image_traverse_node(trie, inode, str, G_PRE_ORDER, flags,
+                                  max_depth, func, user_data);
+      }
+      g_string_free(str, TRUE);
+      return;
+   }
+
+   while (*key && node) {
+      node = trie_find_node(trie, node, *key);
+      key++;
+   }
+
+   if (node) {
+      trie_traverse_node_sorted(trie, node, str, flags,
+                                max_depth, func, user_data);
+   }
+
+   g_string_free(str, TRUE);
+}
+
+/**
+ * trie_serialize:
+ * @trie: A #Trie.
+ * @func: (allow-none): A #TrieSerializeFunc, or %NULL.
+ * @user_data: User data for @func.
+ *
+ * Flattens @trie into a position independent image that can be written to
+ * disk and loaded again with trie_new_from_mapped().
+ *
+ * Nodes are stored breadth-first with the children of each node contiguous
+ * and sorted by key, and refer to each other by index. @func is called to
+ * convert each value into the bytes that will be stored in the image. If
+ * @func is %NULL, values are assumed to be nul-terminated strings.
+ *
+ * The image uses the host byte order.
+ *
+ * Returns: (transfer full): A #GBytes containing the image.
+ */
+GBytes *
+trie_serialize (Trie              *trie,
+                TrieSerializeFunc  func,
+                gpointer           user_data)
+{
+   TrieImageHeader header = { 0 };
+   TrieImageNode *inode;
+   TrieNode *children[256];
+   TrieNode *node;
+   GByteArray *values;
+   GByteArray *image;
+   GPtrArray *queue;
+   GArray *nodes;
+   GBytes *bytes;
+   guint8 keys[256];
+   gsize base;
+   guint n_children;
+   guint i;
+   guint j;
+
+   g_return_val_if_fail(trie, NULL);
+
+   if (trie->mapped) {
+      return g_bytes_new(trie->image,
+                         ((const TrieImageHeader *)trie->image)->size);
+   }
+
+   queue = g_ptr_array_new();
+   nodes = g_array_new(FALSE, TRUE, sizeof(TrieImageNode));
+   values = g_byte_array_new();
+
+   g_ptr_array_add(queue, trie->root);
+   g_array_set_size(nodes, 1);
+
+   for (i = 0; i < queue->len; i++) {
+      node = g_ptr_array_index(queue, i);
+      bytes = NULL;
+
+      if (node->value) {
+         if (func) {
+            bytes = func(node->value, user_data);
+         } else {
+            bytes = g_bytes_new_static(node->value, strlen(node->value) + 1);
+         }
+      }
+
+      n_children = trie_node_get_sorted_children(node, keys, children);
+
+      inode = &g_array_index(nodes, TrieImageNode, i);
+      inode->first_child = queue->len;
+      inode->n_children = n_children;
+
+      /*
+       * The offset of the value region is not known until every node has
+       * been added, so store the offset within it plus one for now.
+       */
+      if (bytes) {
+         while (values->len % 8) {
+            g_byte_array_append(values, (const guint8 *)"", 1);
+         }
+         inode->value_offset = values->len + 1;
+         inode->value_length = g_bytes_get_size(bytes);
+         g_byte_array_append(values,
+                             g_bytes_get_data(bytes, NULL),
+                             g_bytes_get_size(bytes));
+         g_bytes_unref(bytes);
+      }
+
+      for (j = 0; j < n_children; j++) {
+         g_ptr_array_add(queue, children[j]);
+         g_array_set_size(nodes, nodes->len + 1);
+         g_array_index(nodes, TrieImageNode, nodes->len - 1).key = keys[j];
+      }
+   }
+
+   base = sizeof header + (nodes->len * sizeof(TrieImageNode));
+
+   for (i = 0; i < nodes->len; i++) {
+      inode = &g_array_index(nodes, TrieImageNode, i);
+      if (inode->value_offset) {
+         inode->value_offset += base - 1;
+      }
+   }
+
+   header.magic = TRIE_IMAGE_MAGIC;
+   header.version = TRIE_IMAGE_VERSION;
+   header.n_nodes = nodes->len;
+   header.size = base + values->len;
+
+   image = g_byte_array_sized_new(header.size);
+   g_byte_array_append(image, (const guint8 *)&header, sizeof header);
+   g_byte_array_append(image, (const guint8 *)nodes->data,
+                       nodes->len * sizeof(TrieImageNode));
+   g_byte_array_append(image, values->data, values->len);
+
+   g_ptr_array_unref(queue);
+   g_array_unref(nodes);
+   g_byte_array_unref(values);
+
+   return g_byte_array_free_to_bytes(image);
+}
+
+/**
+ * trie_image_validate:
+ * @data: The image contents.
+ * @size: The size of @data in bytes.
+ *
+ * Checks that every offset in the image is within bounds, and that every
+ * node only refers to children after itself so that traversal terminates.
+ *
+ * Returns: %TRUE if the image can be used.
+ */
+static gboolean
+trie_image_validate (const guint8 *data,
+                     gsize         size)
+{
+   const TrieImageHeader *header;
+   const TrieImageNode *nodes;
+   guint64 nodes_end;
+   guint i;
+
+   if (size < sizeof *header) {
+      return FALSE;
+   }
+
+   header = (const TrieImageHeader *)data;
+
+   if ((header->magic != TRIE_IMAGE_MAGIC) ||
+       (header->version != TRIE_IMAGE_VERSION) ||
+       (header->size != size) ||
+       (header->n_nodes == 0)) {
+      return FALSE;
+   }
+
+   nodes_end = sizeof *header + ((guint64)header->n_nodes * sizeof *nodes);
+   if (nodes_end > size) {
+      return FALSE;
+   }
+
+   nodes = (const TrieImageNode *)(data + sizeof *header);
+
+   for (i = 0; i < header->n_nodes; i++) {
+      if (nodes[i].n_children &&
+          ((nodes[i].first_child <= i) ||
+           (((guint64)nodes[i].first_child + nodes[i].n_children) >
+            header->n_nodes))) {
+         return FALSE;
+      }
+      if (nodes[i].value_offset &&
+          ((nodes[i].value_offset < nodes_end) ||
+           (((guint64)nodes[i].value_offset + nodes[i].value_length) > size))) {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+/**
+ * trie_new_from_mapped:
+ * @mapped_file: A #GMappedFile containing an image from trie_serialize().
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Creates a read-only #Trie backed by @mapped_file. Nothing is copied, so
+ * the pages of the image can be shared between processes and are only
+ * faulted in as they are visited.
+ *
+ * Values returned from trie_lookup() and passed to #TrieTraverseFunc point
+ * into the image and must not be modified. trie_insert() and trie_remove()
+ * may not be used on the resulting #Trie.
+ *
+ * Returns: (transfer full): A #Trie that should be freed with
+ *   trie_destroy(), or %NULL if the image is invalid.
+ */
+Trie *
+trie_new_from_mapped (GMappedFile  *mapped_file,
+                      GError      **error)
+{
+   const guint8 *data;
+   Trie *trie;
+   gsize size;
+
+   g_return_val_if_fail(mapped_file, NULL);
+
+   data = (const guint8 *)g_mapped_file_get_contents(mapped_file);
+   size = g_mapped_file_get_length(mapped_file);
+
+   if (!data || !trie_image_validate(data, size)) {
+      g_set_error(error,
+                  G_FILE_ERROR,
+                  G_FILE_ERROR_INVAL,
+                  _("The file does not contain a valid Trie image."));
+      return NULL;
+   }
+
+   trie = g_new0(Trie, 1);
+   trie->mapped = g_mapped_file_ref(mapped_file);
+   trie->image = data;
+   trie->image_nodes = (const TrieImageNode *)(data + sizeof(TrieImageHeader));
+
+   return trie;
+}
+
+/**
+ * trie_destroy_values:
+ * @node: A #TrieNode.
+ * @value_destroy: A #GDestroyNotify.
+ *
+ * Calls @value_destroy for the value of @node and each of its children,
+ * children first. The nodes themselves are left in place.
+ */
+static void
+trie_destroy_values (TrieNode       *node,
+                     GDestroyNotify  value_destroy)
+{
+   TrieNodeChunk *iter;
+   guint i;
+
+   g_assert(node);
+   g_assert(value_destroy);
+
+   for (iter = &node->chunk; iter; iter = iter->next) {
+      for (i = 0; i < iter->count; i++) {
+         trie_destroy_values(iter->children[i], value_destroy);
+      }
+   }
+
+   if (node->value) {
+      value_destroy(node->value);
+   }
+}
+
 /**
  * trie_destroy:
  * @trie: A #Trie or %NULL.
  *
- * Frees @trie and all associated memory.
+ * Frees @trie and all associated memory. Since every node lives in the
+ * slabs of @trie, only the values need to be visited.
  */
 void
 trie_destroy (Trie *trie)
 {
    if (trie) {
-      trie_destroy_node(trie, trie->root, trie->value_destroy);
+      if (trie->mapped) {
+         g_mapped_file_unref(trie->mapped);
+         trie->mapped = NULL;
+         trie->image = NULL;
+         trie->image_nodes = NULL;
+         g_free(trie);
+         return;
+      }
+      if (trie->value_destroy) {
+         trie_destroy_values(trie->root, trie->value_destroy);
+      }
+      g_ptr_array_unref(trie->slabs);
+      trie->slabs = NULL;
       trie->root = NULL;
       trie->value_destroy = NULL;
       g_free(trie);
@@ -30,22 +30,36 @@ typedef gboolean (*TrieTraverseFunc) (Trie        *trie,
                                       gpointer     value,
                                       gpointer     user_data);
 
-void      trie_destroy  (Trie             *trie);
-void      trie_insert   (Trie             *trie,
-                         const gchar      *key,
-                         gpointer          value);
-gpointer  trie_lookup   (Trie             *trie,
-                         const gchar      *key);
-Trie     *trie_new      (GDestroyNotify    value_destroy);
-gboolean  trie_remove   (Trie             *trie,
-                         const gchar      *key);
-void      trie_traverse (Trie             *trie,
-                         const gchar      *key,
-                         GTraverseType     order,
-                         GTraverseFlags    flags,
-                         gint              max_depth,
-                         TrieTraverseFunc  func,
-                         gpointer          user_data);
+typedef GBytes  *(*TrieSerializeFunc) (gpointer     value,
+                                       gpointer     user_data);
+
+void      trie_destroy         (Trie              *trie);
+void      trie_insert          (Trie              *trie,
+                                const gchar       *key,
+                                gpointer           value);
+gpointer  trie_lookup          (Trie              *trie,
+                                const gchar       *key);
+Trie     *trie_new             (GDestroyNotify     value_destroy);
+Trie     *trie_new_from_mapped (GMappedFile       *mapped_file,
+                                GError           **error);
+gboolean  trie_remove          (Trie              *trie,
+                                const gchar       *key);
+GBytes   *trie_serialize       (Trie              *trie,
+                                TrieSerializeFunc  func,
+                                gpointer           user_data);
+void      trie_traverse        (Trie              *trie,
+                                const gchar       *key,
+                                GTraverseType      order,
+                                GTraverseFlags     flags,
+                                gint               max_depth,
+                                TrieTraverseFunc   func,
+                                gpointer           user_data);
+void      trie_traverse_sorted (Trie              *trie,
+                                const gchar       *key,
+                                GTraverseFlags     flags,
+                                gint               max_depth,
+                                TrieTraverseFunc   func,
+                                gpointer           user_data);
 
 G_END_DECLS
 
@@ -0,0 +1,157 @@
+/* gb-deferred.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "deferred"
+
+#include "gb-deferred.h"
+#include "gb-log.h"
+
+/*
+ * GbDeferred wraps a piece of initialization that does not need to happen
+ * before the first window is shown. It runs exactly once, either when
+ * gb_deferred_ensure() is called by its first user, or from an idle
+ * handler after gb_deferred_schedule(), whichever comes first.
+ *
+ * Scheduled items run one per main loop iteration at G_PRIORITY_LOW so
+ * that they do not delay input or drawing.
+ *
+ * The name must be a static string; it is used for the startup tracer.
+ */
+
+struct _GbDeferred
+{
+  const gchar    *name;
+  GbDeferredFunc  func;
+  gpointer        user_data;
+  guint           scheduled : 1;
+  guint           done : 1;
+};
+
+static GQueue gPending = G_QUEUE_INIT;
+static guint  gIdleHandler;
+
+GbDeferred *
+gb_deferred_new (const gchar    *name,
+                 GbDeferredFunc  func,
+                 gpointer        user_data)
+{
+  GbDeferred *deferred;
+
+  g_return_val_if_fail (name, NULL);
+  g_return_val_if_fail (func, NULL);
+
+  deferred = g_slice_new0 (GbDeferred);
+  deferred->name = name;
+  deferred->func = func;
+  deferred->user_data = user_data;
+
+  return deferred;
+}
+
+void
+gb_deferred_free (GbDeferred *deferred)
+{
+  if (!deferred)
+    return;
+
+  if (deferred->scheduled)
+    g_queue_remove (&gPending, deferred);
+
+  if (!gPending.length && gIdleHandler)
+    {
+      g_source_remove (gIdleHandler);
+      gIdleHandler = 0;
+    }
+
+  g_slice_free (GbDeferred, deferred);
+}
+
+gboolean
+gb_deferred_is_done (GbDeferred *deferred)
+{
+  g_return_val_if_fail (deferred, FALSE);
+
+  return deferred->done;
+}
+
+/**
+ * gb_deferred_ensure:
+ *
+ * Runs the initialization now unless it has already run.
+ */
+void
+gb_deferred_ensure (GbDeferred *deferred)
+{
+  g_return_if_fail (deferred);
+
+  if (deferred->done)
+    return;
+
+  if (deferred->scheduled)
+    {
+      g_queue_remove (&gPending, deferred);
+      deferred->scheduled = FALSE;
+    }
+
+  deferred->done = TRUE;
+
+  g_debug ("Initializing %s", deferred->name);
+
+  gb_trace_begin (deferred->name);
+  deferred->func (deferred->user_data);
+  gb_trace_end (deferred->name);
+}
+
+static gboolean
+gb_deferred_idle_cb (gpointer user_data)
+{
+  GbDeferred *deferred;
+
+  if ((deferred = g_queue_peek_head (&gPending)))
+    gb_deferred_ensure (deferred);
+
+  if (!gPending.length)
+    {
+      gIdleHandler = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * gb_deferred_schedule:
+ *
+ * Queues the initialization to run when the main loop is idle.
+ */
+void
+gb_deferred_schedule (GbDeferred *deferred)
+{
+  g_return_if_fail (deferred);
+
+  if (deferred->done || deferred->scheduled)
+    return;
+
+  deferred->scheduled = TRUE;
+  g_queue_push_tail (&gPending, deferred);
+
+  if (!gIdleHandler)
+    gIdleHandler = g_idle_add_full (G_PRIORITY_LOW,
+                                    gb_deferred_idle_cb,
+                                    NULL, NULL);
+}
@@ -0,0 +1,40 @@
+/* gb-deferred.h
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_DEFERRED_H
+#define GB_DEFERRED_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GbDeferred GbDeferred;
+
+typedef void (*GbDeferredFunc) (gpointer user_data);
+
+GbDeferred *gb_deferred_new      (const gchar    *name,
+                                  GbDeferredFunc  func,
+                                  gpointer        user_data);
+void        gb_deferred_free     (GbDeferred     *deferred);
+void        gb_deferred_ensure   (GbDeferred     *deferred);
+void        gb_deferred_schedule (GbDeferred     *deferred);
+gboolean    gb_deferred_is_done  (GbDeferred     *deferred);
+
+G_END_DECLS
+
+#endif /* GB_DEFERRED_H */
@@ -16,36 +16,79 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "gb-doc-seq.h"
 
-static GHashTable *seq;
+/*
+ * Sequence ids are tracked in a bitmap where bit N is set when id N + 1 is
+ * in use. first_free is the index of the first word that may contain a
+ * clear bit; every word before it is full. Acquiring an id is therefore a
+ * find-first-zero within, in practice, a single word.
+ */
+
+#define BITS_PER_WORD (sizeof (gulong) * 8)
+
+G_LOCK_DEFINE_STATIC (seq);
+
+static gulong *seq_words;
+static guint   seq_n_words;
+static guint   seq_first_free;
 
 guint
 gb_doc_seq_acquire (void)
 {
   guint seq_id;
+  guint bit;
+  guint i;
 
-  if (!seq)
-    seq = g_hash_table_new (g_direct_hash, g_direct_equal);
+  G_LOCK (seq);
 
-  for (seq_id = 1; seq_id < G_MAXUINT; seq_id++)
+  for (i = seq_first_free; i < seq_n_words; i++)
     {
-      gpointer key;
+      if (seq_words [i] != G_MAXULONG)
+        break;
+    }
 
-      key = GINT_TO_POINTER (seq_id);
+  if (i == seq_n_words)
+    {
+      guint n_words = MAX (4, seq_n_words * 2);
 
-      if (!g_hash_table_lookup (seq, key))
-        {
-          g_hash_table_insert (seq, key, GINT_TO_POINTER (TRUE));
-          return seq_id;
-        }
+      seq_words = g_renew (gulong, seq_words, n_words);
+      memset (&seq_words [seq_n_words], 0,
+              (n_words - seq_n_words) * sizeof (gulong));
+      seq_n_words = n_words;
     }
 
-  return 0;
+  bit = g_bit_nth_lsf (~seq_words [i], -1);
+  seq_words [i] |= (1UL << bit);
+  seq_first_free = i;
+
+  seq_id = (i * BITS_PER_WORD) + bit + 1;
+
+  G_UNLOCK (seq);
+
+  return seq_id;
 }
 
 void
 gb_doc_seq_release (guint seq_id)
 {
-  g_hash_table_remove (seq, GINT_TO_POINTER (seq_id));
+  guint word;
+  guint bit;
+
+  g_return_if_fail (seq_id > 0);
+
+  word = (seq_id - 1) / BITS_PER_WORD;
+  bit = (seq_id - 1) % BITS_PER_WORD;
+
+  G_LOCK (seq);
+
+  if (word < seq_n_words)
+    {
+      seq_words [word] &= ~(1UL << bit);
+      seq_first_free = MIN (seq_first_free, word);
+    }
+
+  G_UNLOCK (seq);
 }
@@ -0,0 +1,457 @@
+/* gb-source-vim-sort.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "vim-sort"
+
+#include <string.h>
+
+#include "gb-source-vim-sort.h"
+
+/*
+ * Runs shorter than this are sorted with an insertion sort, and inputs with
+ * fewer lines than PARALLEL_THRESHOLD are sorted on the calling thread.
+ */
+#define INSERTION_THRESHOLD 16
+#define PARALLEL_THRESHOLD  16384
+#define MAX_SORT_THREADS    8
+
+/*
+ * Each line is a slice of the snapshot text rather than a copy of it. A key
+ * is only created when the comparison cannot be performed on the raw bytes.
+ */
+typedef struct
+{
+  const gchar *str;
+  gsize        len;
+  gchar       *key;
+  gint64       number;
+  guint        has_number : 1;
+} SortLine;
+
+typedef struct
+{
+  GbSourceVimSortFlags flags;
+} SortContext;
+
+typedef struct
+{
+  const SortContext *ctx;
+  SortLine          *src;
+  SortLine          *dst;
+  gsize              offset;
+  gsize              len;
+  gsize              len2;
+} SortJob;
+
+gboolean
+gb_source_vim_sort_parse_flags (const gchar          *command_text,
+                                GbSourceVimSortFlags *flags)
+{
+  GbSourceVimSortFlags ret = GB_SOURCE_VIM_SORT_NONE;
+
+  g_return_val_if_fail (command_text, FALSE);
+  g_return_val_if_fail (flags, FALSE);
+
+  if (!g_str_has_prefix (command_text, "sort"))
+    return FALSE;
+
+  command_text += strlen ("sort");
+
+  if (*command_text == '!')
+    {
+      ret |= GB_SOURCE_VIM_SORT_REVERSE;
+      command_text++;
+    }
+
+  for (; *command_text; command_text++)
+    {
+      switch (*command_text)
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+          break;
+
+        case 'i':
+          ret |= GB_SOURCE_VIM_SORT_IGNORE_CASE;
+          break;
+
+        case 'l':
+          ret |= GB_SOURCE_VIM_SORT_LOCALE;
+          break;
+
+        case 'n':
+          ret |= GB_SOURCE_VIM_SORT_NUMERIC;
+          break;
+
+        case 'r':
+          ret |= GB_SOURCE_VIM_SORT_REVERSE;
+          break;
+
+        case 'u':
+          ret |= GB_SOURCE_VIM_SORT_UNIQUE;
+          break;
+
+        default:
+          return FALSE;
+        }
+    }
+
+  *flags = ret;
+
+  return TRUE;
+}
+
+static void
+sort_line_prepare (SortLine             *line,
+                   GbSourceVimSortFlags  flags)
+{
+  if ((flags & GB_SOURCE_VIM_SORT_NUMERIC) != 0)
+    {
+      const gchar *iter;
+      const gchar *end = line->str + line->len;
+
+      /*
+       * Like VIM, sort on the first decimal number in the line including a
+       * leading '-'. Lines without a number sort before those with one.
+       */
+      for (iter = line->str; iter < end; iter++)
+        {
+          if (g_ascii_isdigit (*iter))
+            {
+              if ((iter > line->str) && (iter [-1] == '-'))
+                iter--;
+              line->number = g_ascii_strtoll (iter, NULL, 10);
+              line->has_number = TRUE;
+              break;
+            }
+        }
+
+      return;
+    }
+
+  if ((flags & GB_SOURCE_VIM_SORT_IGNORE_CASE) != 0)
+    line->key = g_utf8_casefold (line->str, line->len);
+
+  if ((flags & GB_SOURCE_VIM_SORT_LOCALE) != 0)
+    {
+      gchar *key;
+
+      if (line->key)
+        key = g_utf8_collate_key (line->key, -1);
+      else
+        key = g_utf8_collate_key (line->str, line->len);
+
+      g_free (line->key);
+      line->key = key;
+    }
+}
+
+static gint
+sort_line_compare (const SortLine    *a,
+                   const SortLine    *b,
+                   const SortContext *ctx)
+{
+  gint ret;
+
+  if ((ctx->flags & GB_SOURCE_VIM_SORT_NUMERIC) != 0)
+    {
+      if (a->has_number != b->has_number)
+        ret = a->has_number ? 1 : -1;
+      else if (!a->has_number || (a->number == b->number))
+        ret = 0;
+      else
+        ret = (a->number < b->number) ? -1 : 1;
+    }
+  else if (a->key)
+    {
+      ret = strcmp (a->key, b->key);
+    }
+  else
+    {
+      ret = memcmp (a->str, b->str, MIN (a->len, b->len));
+      if (ret == 0)
+        ret = (a->len < b->len) ? -1 : (a->len > b->len);
+    }
+
+  if ((ctx->flags & GB_SOURCE_VIM_SORT_REVERSE) != 0)
+    ret = -ret;
+
+  return ret;
+}
+
+/*
+ * Merges the sorted runs a and b into dst. Ties are taken from a first so
+ * that the sort is stable.
+ */
+static void
+merge_runs (const SortLine    *a,
+            gsize              a_len,
+            const SortLine    *b,
+            gsize              b_len,
+            SortLine          *dst,
+            const SortContext *ctx)
+{
+  gsize i = 0;
+  gsize j = 0;
+
+  while ((i < a_len) && (j < b_len))
+    {
+      if (sort_line_compare (&b [j], &a [i], ctx) < 0)
+        *dst++ = b [j++];
+      else
+        *dst++ = a [i++];
+    }
+
+  if (i < a_len)
+    memcpy (dst, &a [i], (a_len - i) * sizeof (SortLine));
+  if (j < b_len)
+    memcpy (dst, &b [j], (b_len - j) * sizeof (SortLine));
+}
+
+/*
+ * Sorts lines in place using tmp (of the same length) as scratch space.
+ */
+static void
+merge_sort (SortLine          *lines,
+            SortLine          *tmp,
+            gsize              len,
+            const SortContext *ctx)
+{
+  gsize half;
+
+  if (len <= INSERTION_THRESHOLD)
+    {
+      gsize i;
+
+      for (i = 1; i < len; i++)
+        {
+          SortLine line = lines [i];
+          gsize j = i;
+
+          for (; (j > 0) && (sort_line_compare (&line, &lines [j - 1], ctx) < 0); j--)
+            lines [j] = lines [j - 1];
+
+          lines [j] = line;
+        }
+
+      return;
+    }
+
+  half = len / 2;
+
+  merge_sort (lines, tmp, half, ctx);
+  merge_sort (lines + half, tmp + half, len - half, ctx);
+  merge_runs (lines, half, lines + half, len - half, tmp, ctx);
+  memcpy (lines, tmp, len * sizeof (SortLine));
+}
+
+static gpointer
+sort_job_sort (gpointer data)
+{
+  SortJob *job = data;
+
+  merge_sort (job->src + job->offset, job->dst + job->offset, job->len, job->ctx);
+
+  return NULL;
+}
+
+static gpointer
+sort_job_merge (gpointer data)
+{
+  SortJob *job = data;
+
+  merge_runs (job->src + job->offset, job->len,
+              job->src + job->offset + job->len, job->len2,
+              job->dst + job->offset, job->ctx);
+
+  return NULL;
+}
+
+static void
+run_jobs (SortJob      *jobs,
+          guint         n_jobs,
+          GThreadFunc   func)
+{
+  GThread *threads [MAX_SORT_THREADS];
+  guint i;
+
+  g_assert (n_jobs <= MAX_SORT_THREADS);
+
+  /* The calling thread performs the first job itself. */
+  for (i = 1; i < n_jobs; i++)
+    threads [i] = g_thread_new ("vim-sort", func, &jobs [i]);
+
+  func (&jobs [0]);
+
+  for (i = 1; i < n_jobs; i++)
+    g_thread_join (threads [i]);
+}
+
+/*
+ * Sorts the lines by splitting them into runs which are sorted by separate
+ * threads, and then merging pairs of runs in parallel until a single run
+ * remains. Returns the array containing the result, which is either lines
+ * or tmp.
+ */
+static SortLine *
+parallel_merge_sort (SortLine          *lines,
+                     SortLine          *tmp,
+                     gsize              len,
+                     const SortContext *ctx)
+{
+  SortJob jobs [MAX_SORT_THREADS];
+  gsize offsets [MAX_SORT_THREADS + 1];
+  guint n_runs;
+  guint i;
+
+  n_runs = CLAMP (g_get_num_processors (), 1, MAX_SORT_THREADS);
+
+  if ((len < PARALLEL_THRESHOLD) || (n_runs == 1))
+    {
+      merge_sort (lines, tmp, len, ctx);
+      return lines;
+    }
+
+  for (i = 0; i <= n_runs; i++)
+    offsets [i] = len * i / n_runs;
+
+  for (i = 0; i < n_runs; i++)
+    {
+      jobs [i].ctx = ctx;
+      jobs [i].src = lines;
+      jobs [i].dst = tmp;
+      jobs [i].offset = offsets [i];
+      jobs [i].len = offsets [i + 1] - offsets [i];
+      jobs [i].len2 = 0;
+    }
+
+  run_jobs (jobs, n_runs, sort_job_sort);
+
+  while (n_runs > 1)
+    {
+      SortLine *swap;
+      guint n_jobs = 0;
+
+      for (i = 0; i + 1 < n_runs; i += 2)
+        {
+          jobs [n_jobs].ctx = ctx;
+          jobs [n_jobs].src = lines;
+          jobs [n_jobs].dst = tmp;
+          jobs [n_jobs].offset = offsets [i];
+          jobs [n_jobs].len = offsets [i + 1] - offsets [i];
+          jobs [n_jobs].len2 = offsets [i + 2] - offsets [i + 1];
+          n_jobs++;
+        }
+
+      run_jobs (jobs, n_jobs, sort_job_merge);
+
+      /* An odd run out has nothing to merge with, carry it over. */
+      if (n_runs & 1)
+        memcpy (tmp + offsets [n_runs - 1], lines + offsets [n_runs - 1],
+                (len - offsets [n_runs - 1]) * sizeof (SortLine));
+
+      for (i = 0; i < n_jobs; i++)
+        offsets [i] = offsets [i * 2];
+      if (n_runs & 1)
+        offsets [n_jobs++] = offsets [n_runs - 1];
+      offsets [n_jobs] = len;
+
+      n_runs = n_jobs;
+
+      swap = lines;
+      lines = tmp;
+      tmp = swap;
+    }
+
+  return lines;
+}
+
+/**
+ * gb_source_vim_sort_lines:
+ * @text: The text to sort, with lines separated by "\n".
+ * @flags: A #GbSourceVimSortFlags.
+ *
+ * Sorts the lines within @text. The lines are referenced as slices of @text
+ * rather than being copied, and large inputs are sorted using multiple
+ * threads.
+ *
+ * This function does not use any GTK+ API and may be called from a worker
+ * thread.
+ *
+ * Returns: (transfer full): A newly allocated string containing the sorted
+ *   lines.
+ */
+gchar *
+gb_source_vim_sort_lines (const gchar          *text,
+                          GbSourceVimSortFlags  flags)
+{
+  SortContext ctx = { flags };
+  SortLine *lines;
+  SortLine *tmp;
+  SortLine *sorted;
+  const gchar *iter;
+  GString *str;
+  gsize n_lines = 1;
+  gsize i;
+
+  g_return_val_if_fail (text, NULL);
+
+  for (iter = text; (iter = strchr (iter, '\n')); iter++)
+    n_lines++;
+
+  lines = g_new0 (SortLine, n_lines);
+  tmp = g_new (SortLine, n_lines);
+
+  for (i = 0, iter = text; i < n_lines; i++)
+    {
+      const gchar *nl = strchr (iter, '\n');
+
+      lines [i].str = iter;
+      lines [i].len = nl ? (gsize)(nl - iter) : strlen (iter);
+      sort_line_prepare (&lines [i], flags);
+
+      iter += lines [i].len + 1;
+    }
+
+  sorted = parallel_merge_sort (lines, tmp, n_lines, &ctx);
+
+  str = g_string_sized_new (strlen (text));
+
+  for (i = 0; i < n_lines; i++)
+    {
+      if (((flags & GB_SOURCE_VIM_SORT_UNIQUE) != 0) &&
+          (i > 0) &&
+          (sort_line_compare (&sorted [i - 1], &sorted [i], &ctx) == 0))
+        continue;
+
+      if (i > 0)
+        g_string_append_c (str, '\n');
+      g_string_append_len (str, sorted [i].str, sorted [i].len);
+    }
+
+  /* sorted contains each line exactly once, lines and tmp may not. */
+  for (i = 0; i < n_lines; i++)
+    g_free (sorted [i].key);
+
+  g_free (lines);
+  g_free (tmp);
+
+  return g_string_free (str, FALSE);
+}
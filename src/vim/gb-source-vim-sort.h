@@ -0,0 +1,43 @@
+/* gb-source-vim-sort.h
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_SOURCE_VIM_SORT_H
+#define GB_SOURCE_VIM_SORT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GB_SOURCE_VIM_SORT_NONE        = 0,
+  GB_SOURCE_VIM_SORT_NUMERIC     = 1 << 0,
+  GB_SOURCE_VIM_SORT_UNIQUE      = 1 << 1,
+  GB_SOURCE_VIM_SORT_IGNORE_CASE = 1 << 2,
+  GB_SOURCE_VIM_SORT_REVERSE     = 1 << 3,
+  GB_SOURCE_VIM_SORT_LOCALE      = 1 << 4,
+} GbSourceVimSortFlags;
+
+gboolean  gb_source_vim_sort_parse_flags (const gchar          *command_text,
+                                          GbSourceVimSortFlags *flags);
+gchar    *gb_source_vim_sort_lines       (const gchar          *text,
+                                          GbSourceVimSortFlags  flags);
+
+G_END_DECLS
+
+#endif /* GB_SOURCE_VIM_SORT_H */
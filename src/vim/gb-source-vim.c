@@ -18,6 +18,8 @@
 
 #define G_LOG_DOMAIN "vim"
 #define SCROLL_OFF 3
+#define SUBSTITUTE_ASYNC_THRESHOLD (256 * 1024)
+#define SORT_ASYNC_THRESHOLD (256 * 1024)
 
 #include <errno.h>
 #include <glib/gi18n.h>
@@ -26,8 +28,10 @@
 #include <stdlib.h>
 
 #include "gb-source-vim.h"
+#include "gb-source-vim-sort.h"
 
 #ifndef GB_SOURCE_VIM_EXTERNAL
+# include "gb-source-bracket-index.h"
 # include "gb-source-view.h"
 #endif
 
@@ -79,10 +83,12 @@ struct _GbSourceVimPrivate
   GtkTextMark             *selection_anchor_end;
   GtkSourceSearchContext  *search_context;
   GtkSourceSearchSettings *search_settings;
-  GPtrArray               *captured_events;
+  GArray                  *recorded_edits;
+  GdkWindow               *batch_window;
   GbSourceVimMode          mode;
   gulong                   key_press_event_handler;
-  gulong                   key_release_event_handler;
+  gulong                   insert_text_handler;
+  gulong                   record_delete_range_handler;
   gulong                   focus_in_event_handler;
   gulong                   mark_set_handler;
   gulong                   delete_range_handler;
@@ -90,12 +96,18 @@ struct _GbSourceVimPrivate
   guint                    stash_line;
   guint                    stash_line_offset;
   guint                    anim_timeout;
+  guint                    batch_depth;
+  guint                    busy_count;
+  gint                     recording_cursor;
+  gint                     recording_tail_delta;
   gchar                    recording_trigger;
   gchar                    recording_modifier;
   guint                    enabled : 1;
   guint                    connected : 1;
   guint                    recording : 1;
   guint                    in_replay : 1;
+  guint                    in_command : 1;
+  guint                    recording_escaped : 1;
 };
 
 typedef enum
@@ -139,6 +151,30 @@ typedef struct
   GbSourceVimCommandFlags flags;
 } GbSourceVimCommand;
 
+typedef enum
+{
+  GB_SOURCE_VIM_EDIT_INSERT,
+  GB_SOURCE_VIM_EDIT_DELETE,
+} GbSourceVimEditType;
+
+/**
+ * GbSourceVimEdit:
+ *
+ * A change to the buffer that was recorded while in insert mode so that it
+ * can be replayed by the "." command without re-dispatching key events.
+ * @offset is relative to the cursor so that the edit can be applied at a new
+ * location, and @cursor_delta is how far the cursor moved since the previous
+ * edit was applied.
+ */
+typedef struct
+{
+  GbSourceVimEditType  type;
+  gint                 cursor_delta;
+  gint                 offset;
+  gint                 length;
+  gchar               *text;
+} GbSourceVimEdit;
+
 typedef enum
 {
   GB_SOURCE_VIM_PHRASE_FAILED,
@@ -163,6 +199,7 @@ typedef struct
 enum
 {
   PROP_0,
+  PROP_BUSY,
   PROP_ENABLED,
   PROP_MODE,
   PROP_PHRASE,
@@ -209,6 +246,7 @@ static void gb_source_vim_cmd_delete_to_end (GbSourceVim *vim,
 static void gb_source_vim_cmd_insert_before_line (GbSourceVim *vim,
                                                   guint        count,
                                                   gchar        modifier);
+static void gb_source_vim_move_backward (GbSourceVim *vim);
 
 GbSourceVim *
 gb_source_vim_new (GtkTextView *text_view)
@@ -220,11 +258,33 @@ gb_source_vim_new (GtkTextView *text_view)
                        NULL);
 }
 
+static void
+gb_source_vim_edit_clear (gpointer data)
+{
+  GbSourceVimEdit *edit = data;
+
+  g_free (edit->text);
+}
+
+static gint
+gb_source_vim_get_insert_offset (GbSourceVim *vim)
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark *insert;
+  GtkTextIter iter;
+
+  buffer = gtk_text_view_get_buffer (vim->priv->text_view);
+  insert = gtk_text_buffer_get_insert (buffer);
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, insert);
+
+  return gtk_text_iter_get_offset (&iter);
+}
+
 /**
  * gb_source_vim_recording_begin:
  * @trigger: the character used to trigger recording
  *
- * This begins capturing keys so that they may be replayed later using a
+ * This begins capturing changes so that they may be replayed later using a
  * command such as ".". @trigger is the key that was used to begin this
  * recording such as (A, a, i, I, s, etc).
  *
@@ -241,36 +301,111 @@ gb_source_vim_recording_begin (GbSourceVim *vim,
   if (vim->priv->in_replay)
     return;
 
-  if (vim->priv->captured_events->len)
-    g_ptr_array_remove_range (vim->priv->captured_events, 0,
-                              vim->priv->captured_events->len);
-
-  g_assert (vim->priv->captured_events->len == 0);
+  if (vim->priv->recorded_edits->len)
+    g_array_set_size (vim->priv->recorded_edits, 0);
 
   vim->priv->recording = TRUE;
+  vim->priv->recording_escaped = FALSE;
   vim->priv->recording_trigger = trigger;
   vim->priv->recording_modifier = modifier;
+  vim->priv->recording_cursor = gb_source_vim_get_insert_offset (vim);
+  vim->priv->recording_tail_delta = 0;
 }
 
+/**
+ * gb_source_vim_recording_anchor:
+ *
+ * Resets the position that the first recorded edit is relative to. This is
+ * used once the triggering command has completed, since some commands move
+ * the cursor after they have started recording.
+ */
 static void
-gb_source_vim_recording_capture (GbSourceVim *vim,
-                                 GdkEvent    *event)
+gb_source_vim_recording_anchor (GbSourceVim *vim)
 {
-  GdkEvent *copy;
+  g_assert (GB_IS_SOURCE_VIM (vim));
+
+  if (vim->priv->recording && !vim->priv->recorded_edits->len)
+    vim->priv->recording_cursor = gb_source_vim_get_insert_offset (vim);
+}
+
+static gboolean
+gb_source_vim_recording_is_active (GbSourceVim *vim)
+{
+  return (vim->priv->recording &&
+          !vim->priv->in_replay &&
+          !vim->priv->in_command &&
+          (vim->priv->mode == GB_SOURCE_VIM_INSERT));
+}
+
+static void
+gb_source_vim_recording_capture (GbSourceVim         *vim,
+                                 GbSourceVimEditType  type,
+                                 gint                 begin,
+                                 gint                 length,
+                                 const gchar         *text)
+{
+  GbSourceVimEdit edit;
+  gint cursor;
 
   g_return_if_fail (GB_IS_SOURCE_VIM (vim));
-  g_return_if_fail (event);
-  g_return_if_fail ((event->type == GDK_KEY_PRESS) ||
-                    (event->type == GDK_KEY_RELEASE));
 
-  copy = gdk_event_copy (event);
-  g_ptr_array_add (vim->priv->captured_events, copy);
+  cursor = gb_source_vim_get_insert_offset (vim);
+
+  edit.type = type;
+  edit.cursor_delta = cursor - vim->priv->recording_cursor;
+  edit.offset = begin - cursor;
+  edit.length = length;
+  edit.text = g_strdup (text);
+
+  g_array_append_val (vim->priv->recorded_edits, edit);
+
+  /*
+   * Track where the cursor will land once the change has been applied. The
+   * insert mark has right gravity, so it is pushed forward by insertions at
+   * the cursor and pulled back by deletions that contain it.
+   */
+  if (type == GB_SOURCE_VIM_EDIT_INSERT)
+    {
+      if (cursor >= begin)
+        cursor += length;
+    }
+  else
+    {
+      if (cursor >= begin + length)
+        cursor -= length;
+      else if (cursor > begin)
+        cursor = begin;
+    }
+
+  vim->priv->recording_cursor = cursor;
+}
+
+static gint
+gb_source_vim_replay_move_cursor (GbSourceVim *vim,
+                                  gint         delta)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  gint cursor;
+
+  cursor = gb_source_vim_get_insert_offset (vim);
+
+  if (delta != 0)
+    {
+      buffer = gtk_text_view_get_buffer (vim->priv->text_view);
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, MAX (0, cursor + delta));
+      gtk_text_buffer_select_range (buffer, &iter, &iter);
+      cursor = gtk_text_iter_get_offset (&iter);
+    }
+
+  return cursor;
 }
 
 static void
 gb_source_vim_recording_replay (GbSourceVim *vim)
 {
   GbSourceVimCommand *cmd;
+  GtkTextBuffer *buffer;
   guint i;
 
   g_return_if_fail (GB_IS_SOURCE_VIM (vim));
@@ -282,27 +417,132 @@ gb_source_vim_recording_replay (GbSourceVim *vim)
   if (!cmd)
     return;
 
+  buffer = gtk_text_view_get_buffer (vim->priv->text_view);
+
   vim->priv->in_replay = TRUE;
 
   cmd->func (vim, 1, vim->priv->recording_modifier);
 
-  for (i = 0; i < vim->priv->captured_events->len; i++)
+  /*
+   * Apply the recorded changes directly to the buffer. This avoids running
+   * each key through keybindings, completion and the auto-indenter since
+   * their results were captured as part of the recording.
+   */
+  for (i = 0; i < vim->priv->recorded_edits->len; i++)
     {
-      GdkEventKey *event;
+      GbSourceVimEdit *edit;
+      GtkTextIter begin;
+      GtkTextIter end;
+      gint cursor;
+
+      edit = &g_array_index (vim->priv->recorded_edits, GbSourceVimEdit, i);
+
+      cursor = gb_source_vim_replay_move_cursor (vim, edit->cursor_delta);
+      gtk_text_buffer_get_iter_at_offset (buffer, &begin,
+                                          MAX (0, cursor + edit->offset));
 
-      event = g_ptr_array_index (vim->priv->captured_events, i);
-      event->time = GDK_CURRENT_TIME;
-      gtk_widget_event (GTK_WIDGET (vim->priv->text_view), (GdkEvent *)event);
+      if (edit->type == GB_SOURCE_VIM_EDIT_INSERT)
+        {
+          gtk_text_buffer_insert (buffer, &begin, edit->text, -1);
+        }
+      else
+        {
+          end = begin;
+          gtk_text_iter_forward_chars (&end, edit->length);
+          gtk_text_buffer_delete (buffer, &begin, &end);
+        }
     }
 
+  gb_source_vim_replay_move_cursor (vim, vim->priv->recording_tail_delta);
+
+  if (vim->priv->recording_escaped)
+    gb_source_vim_move_backward (vim);
+
+  gb_source_vim_set_mode (vim, GB_SOURCE_VIM_NORMAL);
+
   vim->priv->in_replay = FALSE;
 }
 
+/**
+ * gb_source_vim_begin_batch:
+ *
+ * Begins a batch of edits, such as replaying a recording. Until the matching
+ * call to gb_source_vim_end_batch(), all changes are coalesced into a single
+ * user action, interactive completion is blocked, and updates to the text
+ * view are frozen so that we do not redraw after every change.
+ *
+ * Batches may be nested.
+ */
+static void
+gb_source_vim_begin_batch (GbSourceVim *vim)
+{
+  GtkTextBuffer *buffer;
+  GdkWindow *window;
+
+  g_assert (GB_IS_SOURCE_VIM (vim));
+
+  if (vim->priv->batch_depth++ > 0)
+    return;
+
+  buffer = gtk_text_view_get_buffer (vim->priv->text_view);
+  gtk_text_buffer_begin_user_action (buffer);
+
+  if (GTK_SOURCE_IS_VIEW (vim->priv->text_view))
+    {
+      GtkSourceCompletion *completion;
+
+      completion = gtk_source_view_get_completion (GTK_SOURCE_VIEW (vim->priv->text_view));
+      gtk_source_completion_block_interactive (completion);
+    }
+
+  window = gtk_widget_get_window (GTK_WIDGET (vim->priv->text_view));
+  if (window)
+    {
+      vim->priv->batch_window = g_object_ref (window);
+      gdk_window_freeze_updates (window);
+    }
+}
+
+static void
+gb_source_vim_end_batch (GbSourceVim *vim)
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark *insert;
+
+  g_assert (GB_IS_SOURCE_VIM (vim));
+  g_return_if_fail (vim->priv->batch_depth > 0);
+
+  if (--vim->priv->batch_depth > 0)
+    return;
+
+  if (vim->priv->batch_window)
+    {
+      gdk_window_thaw_updates (vim->priv->batch_window);
+      g_clear_object (&vim->priv->batch_window);
+    }
+
+  if (GTK_SOURCE_IS_VIEW (vim->priv->text_view))
+    {
+      GtkSourceCompletion *completion;
+
+      completion = gtk_source_view_get_completion (GTK_SOURCE_VIEW (vim->priv->text_view));
+      gtk_source_completion_unblock_interactive (completion);
+    }
+
+  buffer = gtk_text_view_get_buffer (vim->priv->text_view);
+  gtk_text_buffer_end_user_action (buffer);
+
+  insert = gtk_text_buffer_get_insert (buffer);
+  gtk_text_view_scroll_mark_onscreen (vim->priv->text_view, insert);
+}
+
 static void
 gb_source_vim_recording_end (GbSourceVim *vim)
 {
   g_return_if_fail (vim->priv->recording);
 
+  vim->priv->recording_tail_delta =
+    gb_source_vim_get_insert_offset (vim) - vim->priv->recording_cursor;
   vim->priv->recording = FALSE;
 }
 
@@ -1219,6 +1459,28 @@ bracket_predicate (gunichar ch,
   return (state->depth == 0);
 }
 
+#ifndef GB_SOURCE_VIM_EXTERNAL
+static gboolean
+iter_in_string_or_comment (GtkTextBuffer     *buffer,
+                           const GtkTextIter *iter)
+{
+  GtkSourceBuffer *source_buffer;
+
+  g_assert (GTK_IS_TEXT_BUFFER (buffer));
+  g_assert (iter);
+
+  if (!GTK_SOURCE_IS_BUFFER (buffer))
+    return FALSE;
+
+  source_buffer = GTK_SOURCE_BUFFER (buffer);
+
+  return (gtk_source_buffer_iter_has_context_class (source_buffer, iter,
+                                                    "string") ||
+          gtk_source_buffer_iter_has_context_class (source_buffer, iter,
+                                                    "comment"));
+}
+#endif
+
 static void
 gb_source_vim_move_matching_bracket (GbSourceVim *vim)
 {
@@ -1275,12 +1537,25 @@ gb_source_vim_move_matching_bracket (GbSourceVim *vim)
       return;
     }
 
-  if (is_forward)
-    ret = gtk_text_iter_forward_find_char (&iter, bracket_predicate, &state,
-                                           NULL);
-  else
-    ret = gtk_text_iter_backward_find_char (&iter, bracket_predicate, &state,
-                                            NULL);
+#ifndef GB_SOURCE_VIM_EXTERNAL
+  /*
+   * Use the bracket index so we don't walk the buffer. It skips strings and
+   * comments, so only walk for brackets within them. Any other bracket the
+   * index could not match is unmatched.
+   */
+  ret = gb_source_bracket_index_find_match (
+      gb_source_bracket_index_get_for_buffer (buffer), &iter, &iter);
+
+  if (!ret && iter_in_string_or_comment (buffer, &iter))
+#endif
+    {
+      if (is_forward)
+        ret = gtk_text_iter_forward_find_char (&iter, bracket_predicate,
+                                               &state, NULL);
+      else
+        ret = gtk_text_iter_backward_find_char (&iter, bracket_predicate,
+                                                &state, NULL);
+    }
 
   if (ret)
     {
@@ -2993,10 +3268,19 @@ gb_source_vim_handle_normal (GbSourceVim *vim,
 
       gb_source_vim_clear_phrase (vim);
 
+      /*
+       * Edits made by the command itself, such as the newline and indentation
+       * inserted by "o", are not recorded. Replaying runs the command again.
+       */
+      vim->priv->in_command = TRUE;
       cmd->func (vim, phrase.count, phrase.modifier);
+      vim->priv->in_command = FALSE;
+
       if (cmd->flags & GB_SOURCE_VIM_COMMAND_FLAG_VISUAL)
         gb_source_vim_clear_selection (vim);
 
+      gb_source_vim_recording_anchor (vim);
+
       break;
 
     case GB_SOURCE_VIM_PHRASE_NEED_MORE:
@@ -3015,9 +3299,6 @@ static gboolean
 gb_source_vim_handle_insert (GbSourceVim *vim,
                              GdkEventKey *event)
 {
-  if (!vim->priv->in_replay)
-    gb_source_vim_recording_capture (vim, (GdkEvent *)event);
-
   switch (event->keyval)
     {
     case GDK_KEY_bracketleft:
@@ -3027,8 +3308,14 @@ gb_source_vim_handle_insert (GbSourceVim *vim,
     case GDK_KEY_Escape:
       /*
        * First move back onto the last character we entered, and then
-       * return to NORMAL mode.
+       * return to NORMAL mode. The recording is completed first so that
+       * the replay knows to perform the same movement.
        */
+      if (gb_source_vim_recording_is_active (vim))
+        {
+          gb_source_vim_recording_end (vim);
+          vim->priv->recording_escaped = TRUE;
+        }
       gb_source_vim_move_backward (vim);
       gb_source_vim_set_mode (vim, GB_SOURCE_VIM_NORMAL);
       return FALSE;
@@ -3121,21 +3408,6 @@ gb_source_vim_key_press_event_cb (GtkTextView *text_view,
   return ret;
 }
 
-static gboolean
-gb_source_vim_key_release_event_cb (GtkTextView *text_view,
-                                    GdkEventKey *event,
-                                    GbSourceVim *vim)
-{
-  g_return_val_if_fail (GTK_IS_TEXT_VIEW (text_view), FALSE);
-  g_return_val_if_fail (event, FALSE);
-  g_return_val_if_fail (GB_IS_SOURCE_VIM (vim), FALSE);
-
-  if ((vim->priv->mode == GB_SOURCE_VIM_INSERT) && vim->priv->recording)
-    gb_source_vim_recording_capture (vim, (GdkEvent *)event);
-
-  return FALSE;
-}
-
 static gboolean
 gb_source_vim_focus_in_event_cb (GtkTextView *text_view,
                                  GdkEvent    *event,
@@ -3199,6 +3471,55 @@ gb_source_vim_mark_set_cb (GtkTextBuffer *buffer,
   gb_source_vim_maybe_adjust_insert (vim);
 }
 
+static void
+gb_source_vim_insert_text_cb (GtkTextBuffer *buffer,
+                              GtkTextIter   *location,
+                              gchar         *text,
+                              gint           len,
+                              GbSourceVim   *vim)
+{
+  gchar *copy;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (location);
+  g_return_if_fail (text);
+  g_return_if_fail (GB_IS_SOURCE_VIM (vim));
+
+  if (!gb_source_vim_recording_is_active (vim))
+    return;
+
+  copy = g_strndup (text, len);
+  gb_source_vim_recording_capture (vim, GB_SOURCE_VIM_EDIT_INSERT,
+                                   gtk_text_iter_get_offset (location),
+                                   g_utf8_strlen (copy, -1), copy);
+  g_free (copy);
+}
+
+static void
+gb_source_vim_record_delete_range_cb (GtkTextBuffer *buffer,
+                                      GtkTextIter   *begin,
+                                      GtkTextIter   *end,
+                                      GbSourceVim   *vim)
+{
+  gint begin_offset;
+  gint end_offset;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (begin);
+  g_return_if_fail (end);
+  g_return_if_fail (GB_IS_SOURCE_VIM (vim));
+
+  if (!gb_source_vim_recording_is_active (vim))
+    return;
+
+  begin_offset = gtk_text_iter_get_offset (begin);
+  end_offset = gtk_text_iter_get_offset (end);
+
+  gb_source_vim_recording_capture (vim, GB_SOURCE_VIM_EDIT_DELETE,
+                                   MIN (begin_offset, end_offset),
+                                   ABS (end_offset - begin_offset), NULL);
+}
+
 static void
 gb_source_vim_delete_range_cb (GtkTextBuffer *buffer,
                                GtkTextIter   *begin,
@@ -3239,31 +3560,132 @@ gb_source_vim_delete_range_cb (GtkTextBuffer *buffer,
     }
 }
 
-static int
-str_compare_qsort (const void *aptr,
-                   const void *bptr)
+typedef struct
+{
+  GtkTextBuffer        *buffer;
+  GtkTextMark          *begin_mark;
+  GtkTextMark          *end_mark;
+  gchar                *text;
+  gchar                *sorted;
+  GbSourceVimSortFlags  flags;
+  gint                  cursor_offset;
+  gulong                changed_handler;
+  gboolean              invalidated;
+} SortState;
+
+static void
+sort_state_release_buffer (SortState *state)
+{
+  if (state->changed_handler)
+    {
+      g_signal_handler_disconnect (state->buffer, state->changed_handler);
+      state->changed_handler = 0;
+    }
+
+  gtk_text_buffer_delete_mark (state->buffer, state->begin_mark);
+  gtk_text_buffer_delete_mark (state->buffer, state->end_mark);
+  g_clear_object (&state->begin_mark);
+  g_clear_object (&state->end_mark);
+  g_clear_object (&state->buffer);
+}
+
+static void
+sort_state_free (gpointer data)
+{
+  SortState *state = data;
+
+  g_assert (!state->buffer);
+
+  g_free (state->text);
+  g_free (state->sorted);
+  g_free (state);
+}
+
+static void
+sort_state_invalidate (GtkTextBuffer *buffer,
+                       SortState     *state)
 {
-  const gchar * const *a = aptr;
-  const gchar * const *b = bptr;
+  state->invalidated = TRUE;
+}
 
-  return g_strcmp0 (*a, *b);
+static void
+gb_source_vim_sort_worker (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+  SortState *state = task_data;
+
+  state->sorted = gb_source_vim_sort_lines (state->text, state->flags);
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+gb_source_vim_sort_apply (GbSourceVim *vim,
+                          SortState   *state)
+{
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (GB_IS_SOURCE_VIM (vim));
+  g_assert (state);
+
+  gtk_text_buffer_get_iter_at_mark (state->buffer, &begin, state->begin_mark);
+  gtk_text_buffer_get_iter_at_mark (state->buffer, &end, state->end_mark);
+
+  gb_source_vim_begin_batch (vim);
+
+  gtk_text_buffer_delete (state->buffer, &begin, &end);
+  gtk_text_buffer_insert (state->buffer, &begin, state->sorted, -1);
+
+  gtk_text_buffer_get_iter_at_offset (state->buffer, &begin,
+                                      state->cursor_offset);
+  gtk_text_buffer_select_range (state->buffer, &begin, &begin);
+
+  gb_source_vim_end_batch (vim);
+}
+
+static void
+gb_source_vim_sort_cb (GObject      *object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  GbSourceVim *vim = (GbSourceVim *)object;
+  SortState *state;
+
+  g_assert (GB_IS_SOURCE_VIM (vim));
+  g_assert (G_IS_TASK (result));
+
+  gb_source_vim_set_busy (vim, FALSE);
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (state->invalidated)
+    g_warning (_("Buffer was modified during sort, ignoring."));
+  else if (g_task_propagate_boolean (G_TASK (result), NULL))
+    gb_source_vim_sort_apply (vim, state);
+
+  sort_state_release_buffer (state);
 }
 
 static void
 gb_source_vim_op_sort (GbSourceVim *vim,
                        const gchar *command_text)
 {
+  GbSourceVimSortFlags flags;
   GtkTextBuffer *buffer;
   GtkTextMark *insert;
   GtkTextIter begin;
   GtkTextIter end;
   GtkTextIter cursor;
-  guint cursor_offset;
-  gchar *text;
-  gchar **parts;
+  SortState *state;
+  GTask *task;
 
   g_assert (GB_IS_SOURCE_VIM (vim));
 
+  if (!gb_source_vim_sort_parse_flags (command_text, &flags))
+    return;
+
   buffer = gtk_text_view_get_buffer (vim->priv->text_view);
   gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
 
@@ -3272,7 +3694,6 @@ gb_source_vim_op_sort (GbSourceVim *vim,
 
   insert = gtk_text_buffer_get_insert (buffer);
   gtk_text_buffer_get_iter_at_mark (buffer, &cursor, insert);
-  cursor_offset = gtk_text_iter_get_offset (&cursor);
 
   if (gtk_text_iter_compare (&begin, &end) > 0)
     text_iter_swap (&begin, &end);
@@ -3280,21 +3701,38 @@ gb_source_vim_op_sort (GbSourceVim *vim,
   if (gtk_text_iter_starts_line (&end))
     gtk_text_iter_backward_char (&end);
 
-  text = gtk_text_iter_get_slice (&begin, &end);
-  parts = g_strsplit (text, "\n", 0);
-  g_free (text);
-
-  qsort (parts, g_strv_length (parts), sizeof (gchar *),
-         str_compare_qsort);
-
-  text = g_strjoinv ("\n", parts);
-  gtk_text_buffer_delete (buffer, &begin, &end);
-  gtk_text_buffer_insert (buffer, &begin, text, -1);
-  g_free (text);
-  g_strfreev (parts);
+  state = g_new0 (SortState, 1);
+  state->buffer = g_object_ref (buffer);
+  state->begin_mark = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL,
+                                                                 &begin, TRUE));
+  state->end_mark = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL,
+                                                               &end, FALSE));
+  state->text = gtk_text_iter_get_slice (&begin, &end);
+  state->flags = flags;
+  state->cursor_offset = gtk_text_iter_get_offset (&cursor);
+
+  task = g_task_new (vim, NULL, gb_source_vim_sort_cb, NULL);
+  g_task_set_task_data (task, state, sort_state_free);
+
+  if ((gtk_text_iter_get_offset (&end) - gtk_text_iter_get_offset (&begin)) <
+      SORT_ASYNC_THRESHOLD)
+    {
+      g_task_run_in_thread_sync (task, gb_source_vim_sort_worker);
+      if (g_task_propagate_boolean (task, NULL))
+        gb_source_vim_sort_apply (vim, state);
+      sort_state_release_buffer (state);
+    }
+  else
+    {
+      state->changed_handler =
+        g_signal_connect (buffer, "changed",
+                          G_CALLBACK (sort_state_invalidate),
+                          state);
+      gb_source_vim_set_busy (vim, TRUE);
+      g_task_run_in_thread (task, gb_source_vim_sort_worker);
+    }
 
-  gtk_text_buffer_get_iter_at_offset (buffer, &begin, cursor_offset);
-  gtk_text_buffer_select_range (buffer, &begin, &begin);
+  g_object_unref (task);
 }
 
 static void
@@ -3314,13 +3752,6 @@ gb_source_vim_connect (GbSourceVim *vim)
                              vim,
                              0);
 
-  vim->priv->key_release_event_handler =
-    g_signal_connect_object (vim->priv->text_view,
-                             "key-release-event",
-                             G_CALLBACK (gb_source_vim_key_release_event_cb),
-                             vim,
-                             0);
-
   vim->priv->focus_in_event_handler =
     g_signal_connect_object (vim->priv->text_view,
                              "focus-in-event",
@@ -3342,6 +3773,20 @@ gb_source_vim_connect (GbSourceVim *vim)
                             vim,
                             G_CONNECT_AFTER);
 
+  vim->priv->insert_text_handler =
+    g_signal_connect_object (buffer,
+                            "insert-text",
+                            G_CALLBACK (gb_source_vim_insert_text_cb),
+                            vim,
+                            0);
+
+  vim->priv->record_delete_range_handler =
+    g_signal_connect_object (buffer,
+                            "delete-range",
+                            G_CALLBACK (gb_source_vim_record_delete_range_cb),
+                            vim,
+                            0);
+
   if (GTK_SOURCE_IS_BUFFER (buffer))
     vim->priv->search_context =
       gtk_source_search_context_new (GTK_SOURCE_BUFFER (buffer),
@@ -3365,10 +3810,6 @@ gb_source_vim_disconnect (GbSourceVim *vim)
                                vim->priv->key_press_event_handler);
   vim->priv->key_press_event_handler = 0;
 
-  g_signal_handler_disconnect (vim->priv->text_view,
-                               vim->priv->key_release_event_handler);
-  vim->priv->key_release_event_handler = 0;
-
   g_signal_handler_disconnect (vim->priv->text_view,
                                vim->priv->focus_in_event_handler);
   vim->priv->focus_in_event_handler = 0;
@@ -3381,6 +3822,14 @@ gb_source_vim_disconnect (GbSourceVim *vim)
                                vim->priv->delete_range_handler);
   vim->priv->delete_range_handler = 0;
 
+  g_signal_handler_disconnect (gtk_text_view_get_buffer (vim->priv->text_view),
+                               vim->priv->insert_text_handler);
+  vim->priv->insert_text_handler = 0;
+
+  g_signal_handler_disconnect (gtk_text_view_get_buffer (vim->priv->text_view),
+                               vim->priv->record_delete_range_handler);
+  vim->priv->record_delete_range_handler = 0;
+
   g_clear_object (&vim->priv->search_context);
 
   vim->priv->mode = 0;
@@ -3388,6 +3837,37 @@ gb_source_vim_disconnect (GbSourceVim *vim)
   vim->priv->connected = FALSE;
 }
 
+/**
+ * gb_source_vim_get_busy:
+ *
+ * Checks if a long running operation, such as a substitution on a large
+ * buffer, is being performed in the background.
+ *
+ * Returns: %TRUE if the VIM engine is busy.
+ */
+gboolean
+gb_source_vim_get_busy (GbSourceVim *vim)
+{
+  g_return_val_if_fail (GB_IS_SOURCE_VIM (vim), FALSE);
+
+  return (vim->priv->busy_count > 0);
+}
+
+static void
+gb_source_vim_set_busy (GbSourceVim *vim,
+                        gboolean     busy)
+{
+  g_assert (GB_IS_SOURCE_VIM (vim));
+
+  if (busy)
+    vim->priv->busy_count++;
+  else
+    vim->priv->busy_count--;
+
+  if (vim->priv->busy_count == (busy ? 1 : 0))
+    g_object_notify_by_pspec (G_OBJECT (vim), gParamSpecs [PROP_BUSY]);
+}
+
 gboolean
 gb_source_vim_get_enabled (GbSourceVim *vim)
 {
@@ -3519,27 +3999,207 @@ gb_source_vim_op_colorscheme (GbSourceVim *vim,
     gtk_source_buffer_set_style_scheme (GTK_SOURCE_BUFFER (buffer), scheme);
 }
 
-static gboolean
-gb_source_vim_match_is_selected (GbSourceVim *vim,
-                                 GtkTextIter *match_begin,
-                                 GtkTextIter *match_end)
+typedef struct
 {
-  GtkTextIter sel_begin;
-  GtkTextIter sel_end;
+  gint begin;
+  gint end;
+} Substitution;
 
-  g_return_val_if_fail (GB_IS_SOURCE_VIM (vim), FALSE);
-  g_return_val_if_fail (match_begin, FALSE);
-  g_return_val_if_fail (match_end, FALSE);
+typedef struct
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark   *begin_mark;
+  gchar         *text;
+  gchar         *search_text;
+  gchar         *replace_text;
+  GArray        *matches;
+  gulong         changed_handler;
+  gboolean       invalidated;
+} SubstituteState;
+
+/*
+ * The task may be finalized from the worker thread, so the buffer must be
+ * released from the main thread once we are done with it.
+ */
+static void
+substitute_state_release_buffer (SubstituteState *state)
+{
+  if (state->changed_handler)
+    {
+      g_signal_handler_disconnect (state->buffer, state->changed_handler);
+      state->changed_handler = 0;
+    }
+
+  if (state->begin_mark)
+    {
+      gtk_text_buffer_delete_mark (state->buffer, state->begin_mark);
+      g_clear_object (&state->begin_mark);
+    }
+
+  g_clear_object (&state->buffer);
+}
+
+static void
+substitute_state_free (gpointer data)
+{
+  SubstituteState *state = data;
+
+  g_assert (!state->buffer);
+
+  g_clear_pointer (&state->matches, g_array_unref);
+  g_free (state->text);
+  g_free (state->search_text);
+  g_free (state->replace_text);
+  g_free (state);
+}
+
+static void
+substitute_state_invalidate (GtkTextBuffer   *buffer,
+                             SubstituteState *state)
+{
+  state->invalidated = TRUE;
+}
+
+/*
+ * Locates all of the matches within the snapshot of the buffer. This does
+ * not touch the buffer, so it is safe to call from a worker thread.
+ */
+static void
+gb_source_vim_substitute_worker (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+  SubstituteState *state = task_data;
+  GMatchInfo *match_info = NULL;
+  GRegex *regex;
+  GError *error = NULL;
+  gchar *escaped;
+  gint last_pos = 0;
+  gint last_offset = 0;
+
+  escaped = g_regex_escape_string (state->search_text, -1);
+  regex = g_regex_new (escaped, G_REGEX_OPTIMIZE, 0, &error);
+  g_free (escaped);
+
+  if (!regex)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  state->matches = g_array_new (FALSE, FALSE, sizeof (Substitution));
+
+  g_regex_match (regex, state->text, 0, &match_info);
+
+  while (g_match_info_matches (match_info))
+    {
+      Substitution sub;
+      gint begin_pos;
+      gint end_pos;
+
+      if (g_task_return_error_if_cancelled (task))
+        goto cleanup;
+
+      g_match_info_fetch_pos (match_info, 0, &begin_pos, &end_pos);
+
+      /*
+       * Convert byte positions into character offsets, walking only the
+       * text since the previous match.
+       */
+      sub.begin = last_offset + g_utf8_strlen (state->text + last_pos,
+                                               begin_pos - last_pos);
+      sub.end = sub.begin + g_utf8_strlen (state->text + begin_pos,
+                                           end_pos - begin_pos);
+      g_array_append_val (state->matches, sub);
+
+      last_pos = end_pos;
+      last_offset = sub.end;
+
+      g_match_info_next (match_info, NULL);
+    }
+
+  g_task_return_boolean (task, TRUE);
+
+cleanup:
+  g_match_info_free (match_info);
+  g_regex_unref (regex);
+}
+
+static void
+gb_source_vim_substitute_apply (GbSourceVim     *vim,
+                                SubstituteState *state)
+{
+  GtkTextIter begin;
+  GtkTextIter end;
+  gint base;
+  guint i;
+
+  g_assert (GB_IS_SOURCE_VIM (vim));
+  g_assert (state);
+
+  gtk_text_buffer_get_iter_at_mark (state->buffer, &begin, state->begin_mark);
+  base = gtk_text_iter_get_offset (&begin);
+
+  gb_source_vim_begin_batch (vim);
+
+  /*
+   * Apply the replacements from the end of the range to the beginning so
+   * that the offsets of the remaining matches are not affected.
+   */
+  for (i = state->matches->len; i-- > 0;)
+    {
+      const Substitution *sub = &g_array_index (state->matches, Substitution, i);
+
+      gtk_text_buffer_get_iter_at_offset (state->buffer, &begin, base + sub->begin);
+      gtk_text_buffer_get_iter_at_offset (state->buffer, &end, base + sub->end);
+      gtk_text_buffer_delete (state->buffer, &begin, &end);
+      gtk_text_buffer_insert (state->buffer, &begin, state->replace_text, -1);
+    }
+
+  gb_source_vim_end_batch (vim);
+
+  /*
+   * Update the search settings last so that the search context does not
+   * rescan the buffer after every replacement.
+   */
+  gtk_source_search_settings_set_search_text (vim->priv->search_settings,
+                                              state->search_text);
+  gtk_source_search_settings_set_case_sensitive (vim->priv->search_settings,
+                                                 TRUE);
+}
+
+static void
+gb_source_vim_substitute_cb (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  GbSourceVim *vim = (GbSourceVim *)object;
+  SubstituteState *state;
+  GError *error = NULL;
 
-  gb_source_vim_get_selection_bounds (vim, &sel_begin, &sel_end);
+  g_assert (GB_IS_SOURCE_VIM (vim));
+  g_assert (G_IS_TASK (result));
 
-  if (gtk_text_iter_compare (&sel_begin, &sel_end) > 0)
-    text_iter_swap (&sel_begin, &sel_end);
+  gb_source_vim_set_busy (vim, FALSE);
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+  else if (state->invalidated)
+    {
+      g_warning (_("Buffer was modified during substitution, ignoring."));
+    }
+  else
+    {
+      gb_source_vim_substitute_apply (vim, state);
+    }
 
-  return ((gtk_text_iter_compare (&sel_begin, match_begin) <= 0) &&
-          (gtk_text_iter_compare (&sel_begin, match_end) < 0) &&
-          (gtk_text_iter_compare (&sel_end, match_begin) > 0) &&
-          (gtk_text_iter_compare (&sel_end, match_end) >= 0));
+  substitute_state_release_buffer (state);
 }
 
 static void
@@ -3547,23 +4207,21 @@ gb_source_vim_do_search_and_replace (GbSourceVim *vim,
                                      GtkTextIter *begin,
                                      GtkTextIter *end,
                                      const gchar *search_text,
-                                     const gchar *replace_text,
-                                     gboolean     is_global)
+                                     const gchar *replace_text)
 {
+  SubstituteState *state;
   GtkTextBuffer *buffer;
-  GtkTextMark *mark;
   GtkTextIter tmp1;
   GtkTextIter tmp2;
-  GtkTextIter match_begin;
-  GtkTextIter match_end;
   GError *error = NULL;
+  GTask *task;
 
   g_assert (GB_IS_SOURCE_VIM (vim));
   g_assert (search_text);
   g_assert (replace_text);
   g_assert ((!begin && !end) || (begin && end));
 
-  if (!vim->priv->search_context)
+  if (!*search_text)
     return;
 
   buffer = gtk_text_view_get_buffer (vim->priv->text_view);
@@ -3580,43 +4238,50 @@ gb_source_vim_do_search_and_replace (GbSourceVim *vim,
       end = &tmp2;
     }
 
-  mark = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
-
-  gtk_source_search_settings_set_search_text (vim->priv->search_settings,
-                                              search_text);
-  gtk_source_search_settings_set_case_sensitive (vim->priv->search_settings,
-                                                 TRUE);
-
-  while (gtk_source_search_context_forward (vim->priv->search_context, begin,
-                                            &match_begin, &match_end))
+  /*
+   * Snapshot the range so that the matches can be located without touching
+   * the buffer. Using a slice keeps character offsets in sync with the
+   * buffer even if it contains embedded objects.
+   */
+  state = g_new0 (SubstituteState, 1);
+  state->buffer = g_object_ref (buffer);
+  state->begin_mark = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL,
+                                                                 begin, TRUE));
+  state->text = gtk_text_buffer_get_slice (buffer, begin, end, TRUE);
+  state->search_text = g_strdup (search_text);
+  state->replace_text = g_strdup (replace_text);
+
+  task = g_task_new (vim, NULL, gb_source_vim_substitute_cb, NULL);
+  g_task_set_task_data (task, state, substitute_state_free);
+
+  if ((gtk_text_iter_get_offset (end) - gtk_text_iter_get_offset (begin)) <
+      SUBSTITUTE_ASYNC_THRESHOLD)
     {
-      if (is_global ||
-          gb_source_vim_match_is_selected (vim, &match_begin, &match_end))
+      g_task_run_in_thread_sync (task, gb_source_vim_substitute_worker);
+      if (g_task_propagate_boolean (task, &error))
+        gb_source_vim_substitute_apply (vim, state);
+      else
         {
-          GtkTextMark *mark2;
-
-          mark2 = gtk_text_buffer_create_mark (buffer, NULL, &match_end, FALSE);
-
-          if (!gtk_source_search_context_replace (vim->priv->search_context,
-                                                  &match_begin, &match_end,
-                                                  replace_text, -1, &error))
-            {
-              g_warning ("%s", error->message);
-              g_clear_error (&error);
-              gtk_text_buffer_delete_mark (buffer, mark2);
-              break;
-            }
-
-          gtk_text_buffer_get_iter_at_mark (buffer, &match_end, mark2);
-          gtk_text_buffer_delete_mark (buffer, mark2);
+          g_warning ("%s", error->message);
+          g_clear_error (&error);
         }
-
-      *begin = match_end;
-
-      gtk_text_buffer_get_iter_at_mark (buffer, end, mark);
+      substitute_state_release_buffer (state);
+    }
+  else
+    {
+      /*
+       * Large ranges are scanned in a worker thread. If the buffer changes
+       * in the mean time, the results are discarded.
+       */
+      state->changed_handler =
+        g_signal_connect (buffer, "changed",
+                          G_CALLBACK (substitute_state_invalidate),
+                          state);
+      gb_source_vim_set_busy (vim, TRUE);
+      g_task_run_in_thread (task, gb_source_vim_substitute_worker);
     }
 
-  gtk_text_buffer_delete_mark (buffer, mark);
+  g_object_unref (task);
 }
 
 static void
@@ -3721,11 +4386,11 @@ gb_source_vim_op_search_and_replace (GbSourceVim *vim,
       if (gtk_text_iter_compare (&begin, &end) > 0)
         text_iter_swap (&begin, &end);
       gb_source_vim_do_search_and_replace (vim, &begin, &end, search_text,
-                                           replace_text, FALSE);
+                                           replace_text);
     }
   else
     gb_source_vim_do_search_and_replace (vim, NULL, NULL, search_text,
-                                         replace_text, TRUE);
+                                         replace_text);
 
   g_free (search_text);
   g_free (replace_text);
@@ -3838,9 +4503,11 @@ gb_source_vim_op_set (GbSourceVim *vim,
 static GbSourceVimOperation
 gb_source_vim_parse_operation (const gchar *command_text)
 {
+  GbSourceVimSortFlags sort_flags;
+
   g_return_val_if_fail (command_text, NULL);
 
-  if (g_str_equal (command_text, "sort"))
+  if (gb_source_vim_sort_parse_flags (command_text, &sort_flags))
     return gb_source_vim_op_sort;
   else if (g_str_equal (command_text, "nohl"))
     return gb_source_vim_op_nohl;
@@ -3878,6 +4545,7 @@ gb_source_vim_execute_command (GbSourceVim *vim,
 {
   GbSourceVimOperation func;
   GtkTextBuffer *buffer;
+  const gchar *text;
   gboolean ret = FALSE;
   gchar *copy;
 
@@ -3887,11 +4555,18 @@ gb_source_vim_execute_command (GbSourceVim *vim,
   copy = g_strstrip (g_strdup (command));
   func = gb_source_vim_parse_operation (copy);
 
+  /*
+   * Trailing whitespace may be part of a replacement such as ":s/a/b ", so
+   * only skip the leading whitespace of the text given to the operation.
+   */
+  for (text = command; g_ascii_isspace (*text); text++)
+    ;
+
   if (func)
     {
       buffer = gtk_text_view_get_buffer (vim->priv->text_view);
       gtk_text_buffer_begin_user_action (buffer);
-      func (vim, command);
+      func (vim, text);
       gb_source_vim_clear_selection (vim);
       gb_source_vim_set_mode (vim, GB_SOURCE_VIM_NORMAL);
       gtk_text_buffer_end_user_action (buffer);
@@ -3927,7 +4602,7 @@ gb_source_vim_finalize (GObject *object)
   g_string_free (priv->phrase, TRUE);
   priv->phrase = NULL;
 
-  g_clear_pointer (&priv->captured_events, g_ptr_array_unref);
+  g_clear_pointer (&priv->recorded_edits, g_array_unref);
 
   G_OBJECT_CLASS (gb_source_vim_parent_class)->finalize (object);
 }
@@ -3942,6 +4617,10 @@ gb_source_vim_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_BUSY:
+      g_value_set_boolean (value, gb_source_vim_get_busy (vim));
+      break;
+
     case PROP_ENABLED:
       g_value_set_boolean (value, gb_source_vim_get_enabled (vim));
       break;
@@ -3991,22 +4670,24 @@ gb_source_vim_cmd_repeat (GbSourceVim *vim,
                           guint        count,
                           gchar        modifier)
 {
-  GtkSourceCompletion *completion;
-  GtkSourceView *source_view;
+  guint i;
 
   g_return_if_fail (GB_IS_SOURCE_VIM (vim));
 
   if (!GTK_SOURCE_IS_VIEW (vim->priv->text_view) ||
-      !vim->priv->recording_trigger ||
-      !vim->priv->captured_events->len)
+      !vim->priv->recording_trigger)
     return;
 
-  source_view = GTK_SOURCE_VIEW (vim->priv->text_view);
-  completion = gtk_source_view_get_completion (source_view);
+  count = MAX (1, count);
 
-  gtk_source_completion_block_interactive (completion);
-  gb_source_vim_recording_replay (vim);
-  gtk_source_completion_unblock_interactive (completion);
+  /*
+   * Replay the recording inside of a batch so that all of the repetitions
+   * result in a single undo action and a single redraw.
+   */
+  gb_source_vim_begin_batch (vim);
+  for (i = 0; i < count; i++)
+    gb_source_vim_recording_replay (vim);
+  gb_source_vim_end_batch (vim);
 }
 
 static void
@@ -4213,6 +4894,10 @@ gb_source_vim_cmd_change (GbSourceVim *vim,
     {
       gb_source_vim_cmd_delete (vim, count, 'd');
       gb_source_vim_cmd_insert_before_line (vim, 0, '\0');
+
+      /* Repeat as "cc" rather than the "O" used to open the line. */
+      vim->priv->recording_trigger = 'c';
+      vim->priv->recording_modifier = 'c';
     }
   else if (modifier != 'd')
     {
@@ -4912,6 +5597,16 @@ gb_source_vim_class_init (GbSourceVimClass *klass)
   object_class->get_property = gb_source_vim_get_property;
   object_class->set_property = gb_source_vim_set_property;
 
+  gParamSpecs [PROP_BUSY] =
+    g_param_spec_boolean ("busy",
+                          _("Busy"),
+                          _("If a long running operation is in progress."),
+                          FALSE,
+                          (G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_BUSY,
+                                   gParamSpecs [PROP_BUSY]);
+
   gParamSpecs [PROP_ENABLED] =
     g_param_spec_boolean ("enabled",
                           _("Enabled"),
@@ -5227,8 +5922,8 @@ gb_source_vim_init (GbSourceVim *vim)
   vim->priv->mode = 0;
   vim->priv->phrase = g_string_new (NULL);
   vim->priv->search_settings = gtk_source_search_settings_new ();
-  vim->priv->captured_events =
-    g_ptr_array_new_with_free_func ((GDestroyNotify)gdk_event_free);
+  vim->priv->recorded_edits = g_array_new (FALSE, FALSE, sizeof (GbSourceVimEdit));
+  g_array_set_clear_func (vim->priv->recorded_edits, gb_source_vim_edit_clear);
 }
 
 GType
@@ -73,6 +73,7 @@ GType            gb_source_vim_get_type         (void);
 GType            gb_source_vim_mode_get_type    (void);
 GbSourceVim     *gb_source_vim_new              (GtkTextView     *text_view);
 GbSourceVimMode  gb_source_vim_get_mode         (GbSourceVim     *vim);
+gboolean         gb_source_vim_get_busy         (GbSourceVim     *vim);
 void             gb_source_vim_set_mode         (GbSourceVim     *vim,
                                                  GbSourceVimMode  mode);
 const gchar     *gb_source_vim_get_phrase       (GbSourceVim     *vim);
@@ -27,6 +27,7 @@
 #include "gb-command-vim-provider.h"
 #include "gb-close-confirmation-dialog.h"
 #include "gb-credits-widget.h"
+#include "gb-deferred.h"
 #include "gb-document-manager.h"
 #include "gb-editor-workspace.h"
 #include "gb-git-search-provider.h"
@@ -44,6 +45,7 @@ struct _GbWorkbenchPrivate
   GbDocumentManager      *document_manager;
   GbNavigationList       *navigation_list;
   GbSearchManager        *search_manager;
+  GbDeferred             *search_init;
 
   guint                   search_timeout;
   guint                   disposing;
@@ -130,6 +132,39 @@ gb_workbench_get_navigation_list (GbWorkbench *workbench)
   return workbench->priv->navigation_list;
 }
 
+/*
+ * Opening the repository and indexing it for the git search provider is not
+ * needed to show the window, so this is deferred until the search box is
+ * first used or the window has been drawn.
+ */
+static void
+gb_workbench_init_search (GbWorkbench *workbench)
+{
+  GbWorkbenchPrivate *priv;
+  GbSearchProvider *provider;
+  GgitRepository *repository;
+  GFile *file;
+
+  g_assert (GB_IS_WORKBENCH (workbench));
+
+  priv = workbench->priv;
+
+  priv->search_manager = gb_search_manager_new ();
+
+  /* TODO: Keep repository in sync with loaded project */
+  file = g_file_new_for_path (".");
+  repository = ggit_repository_open (file, NULL);
+  provider = g_object_new (GB_TYPE_GIT_SEARCH_PROVIDER,
+                           "repository", repository,
+                           NULL);
+  gb_search_manager_add_provider (priv->search_manager, provider);
+  g_clear_object (&file);
+  g_clear_object (&repository);
+  g_clear_object (&provider);
+
+  gb_search_box_set_search_manager (priv->search_box, priv->search_manager);
+}
+
 GbSearchManager *
 gb_workbench_get_search_manager (GbWorkbench *workbench)
 {
@@ -139,25 +174,8 @@ gb_workbench_get_search_manager (GbWorkbench *workbench)
 
   priv = workbench->priv;
 
-  if (!priv->search_manager)
-    {
-      GbSearchProvider *provider;
-      GgitRepository *repository;
-      GFile *file;
-
-      priv->search_manager = gb_search_manager_new ();
-
-      /* TODO: Keep repository in sync with loaded project */
-      file = g_file_new_for_path (".");
-      repository = ggit_repository_open (file, NULL);
-      provider = g_object_new (GB_TYPE_GIT_SEARCH_PROVIDER,
-                               "repository", repository,
-                               NULL);
-      gb_search_manager_add_provider (priv->search_manager, provider);
-      g_clear_object (&file);
-      g_clear_object (&repository);
-      g_clear_object (&provider);
-    }
+  if (priv->search_init)
+    gb_deferred_ensure (priv->search_init);
 
   return priv->search_manager;
 }
@@ -342,6 +360,7 @@ gb_workbench_action_global_search (GSimpleAction *action,
 
   g_return_if_fail (GB_IS_WORKBENCH (workbench));
 
+  gb_workbench_get_search_manager (workbench);
   gtk_widget_grab_focus (GTK_WIDGET (workbench->priv->search_box));
 }
 
@@ -617,6 +636,12 @@ gb_workbench_set_focus (GtkWindow *window,
 
   GTK_WINDOW_CLASS (gb_workbench_parent_class)->set_focus (window, widget);
 
+  /* Searching needs the search manager, create it if it was deferred. */
+  if (widget &&
+      workbench->priv->search_init &&
+      gtk_widget_is_ancestor (widget, GTK_WIDGET (workbench->priv->search_box)))
+    gb_deferred_ensure (workbench->priv->search_init);
+
   if (!widget && !workbench->priv->disposing)
     {
       GbWorkspace *workspace;
@@ -634,6 +659,23 @@ gb_workbench_set_focus (GtkWindow *window,
     }
 }
 
+static gboolean
+gb_workbench_on_first_draw (GbWorkbench *workbench,
+                            cairo_t     *cr,
+                            gpointer     user_data)
+{
+  g_assert (GB_IS_WORKBENCH (workbench));
+
+  if (workbench->priv->search_init)
+    gb_deferred_schedule (workbench->priv->search_init);
+
+  g_signal_handlers_disconnect_by_func (workbench,
+                                        gb_workbench_on_first_draw,
+                                        user_data);
+
+  return FALSE;
+}
+
 static void
 gb_workbench_constructed (GObject *object)
 {
@@ -648,7 +690,6 @@ gb_workbench_constructed (GObject *object)
   };
   GbWorkbenchPrivate *priv;
   GbWorkbench *workbench = (GbWorkbench *)object;
-  GbSearchManager *search_manager;
   GtkApplication *app;
   GAction *action;
   GMenu *menu;
@@ -693,9 +734,9 @@ gb_workbench_constructed (GObject *object)
                     G_CALLBACK (on_command_bar_notify_child_revealed),
                     workbench);
 
-  search_manager = gb_workbench_get_search_manager (workbench);
-  gb_search_box_set_search_manager (workbench->priv->search_box,
-                                    search_manager);
+  g_signal_connect_after (workbench, "draw",
+                          G_CALLBACK (gb_workbench_on_first_draw),
+                          NULL);
 
   gb_workbench_stack_child_changed (workbench, NULL, priv->stack);
 
@@ -721,6 +762,7 @@ gb_workbench_dispose (GObject *object)
   g_clear_object (&priv->document_manager);
   g_clear_object (&priv->navigation_list);
   g_clear_object (&priv->search_manager);
+  g_clear_pointer (&priv->search_init, gb_deferred_free);
 
   G_OBJECT_CLASS (gb_workbench_parent_class)->dispose (object);
 
@@ -838,6 +880,11 @@ gb_workbench_init (GbWorkbench *workbench)
 {
   workbench->priv = gb_workbench_get_instance_private (workbench);
 
+  workbench->priv->search_init =
+    gb_deferred_new ("search-manager",
+                     (GbDeferredFunc)gb_workbench_init_search,
+                     workbench);
+
   workbench->priv->document_manager = gb_document_manager_new ();
   workbench->priv->command_manager = gb_command_manager_new ();
   workbench->priv->navigation_list = gb_navigation_list_new (workbench);
@@ -0,0 +1,294 @@
+/* bench-auto-indenter.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <gtksourceview/gtksource.h>
+#include <stdlib.h>
+
+#include "gb-source-auto-indenter-c.h"
+#include "gb-source-auto-indenter-python.h"
+#include "gb-source-auto-indenter-xml.h"
+
+/*
+ * Measures how long the auto-indenters take to respond to each trigger
+ * character. Every corpus given on the command line is loaded into a
+ * GtkSourceBuffer, and at evenly spaced lines we type each trigger key at the
+ * end of the line, just like GbSourceView does, and then revert the buffer.
+ *
+ *   bench-auto-indenter [--samples=N] FILE...
+ */
+
+typedef struct
+{
+  guint        keyval;
+  const gchar *text;
+  const gchar *name;
+  GArray      *latencies;
+} Trigger;
+
+static gint gSamples = 500;
+
+static GOptionEntry gEntries[] = {
+  { "samples", 's', 0, G_OPTION_ARG_INT, &gSamples,
+    "Number of lines to type at in each file", "N" },
+  { NULL }
+};
+
+static Trigger gTriggers[] = {
+  { GDK_KEY_Return,      "\n", "Return" },
+  { GDK_KEY_braceright,  "}",  "}" },
+  { GDK_KEY_parenright,  ")",  ")" },
+  { GDK_KEY_colon,       ":",  ":" },
+  { GDK_KEY_numbersign,  "#",  "#" },
+  { GDK_KEY_slash,       "/",  "/" },
+};
+
+static GbSourceAutoIndenter *
+create_indenter (const gchar *path)
+{
+  if (g_str_has_suffix (path, ".c") || g_str_has_suffix (path, ".h"))
+    return gb_source_auto_indenter_c_new ();
+  else if (g_str_has_suffix (path, ".py"))
+    return gb_source_auto_indenter_python_new ();
+  else if (g_str_has_suffix (path, ".xml") || g_str_has_suffix (path, ".ui"))
+    return gb_source_auto_indenter_xml_new ();
+
+  return NULL;
+}
+
+static void
+type_trigger (GbSourceAutoIndenter *indenter,
+              GtkTextView          *view,
+              GtkTextBuffer        *buffer,
+              guint                 line,
+              Trigger              *trigger)
+{
+  GdkEventKey event = { 0 };
+  GtkTextMark *insert;
+  GtkTextIter begin;
+  GtkTextIter end;
+  gint64 before;
+  gdouble elapsed;
+  gint cursor_offset = 0;
+  gint offset;
+  gchar *indent;
+  gchar *saved;
+
+  event.type = GDK_KEY_PRESS;
+  event.keyval = trigger->keyval;
+
+  if (!gb_source_auto_indenter_is_trigger (indenter, &event))
+    return;
+
+  /* Indenters may rewrite the current line, so save it to restore later. */
+  gtk_text_buffer_get_iter_at_line (buffer, &begin, line);
+  offset = gtk_text_iter_get_offset (&begin);
+  end = begin;
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+  saved = gtk_text_iter_get_slice (&begin, &end);
+  begin = end;
+
+  gtk_text_buffer_insert (buffer, &begin, trigger->text, -1);
+  gtk_text_buffer_select_range (buffer, &begin, &begin);
+
+  insert = gtk_text_buffer_get_insert (buffer);
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, insert);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, insert);
+
+  before = g_get_monotonic_time ();
+  indent = gb_source_auto_indenter_format (indenter, view, buffer,
+                                           &begin, &end, &cursor_offset,
+                                           &event);
+  elapsed = g_get_monotonic_time () - before;
+
+  g_array_append_val (trigger->latencies, elapsed);
+
+  if (indent)
+    {
+      if (!gtk_text_iter_equal (&begin, &end))
+        gtk_text_buffer_delete (buffer, &begin, &end);
+      gtk_text_buffer_insert (buffer, &begin, indent, -1);
+      g_free (indent);
+    }
+
+  /* Put the buffer back the way we found it for the next sample. */
+  gtk_text_buffer_get_iter_at_offset (buffer, &begin, offset);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, insert);
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_delete (buffer, &begin, &end);
+  gtk_text_buffer_insert (buffer, &begin, saved, -1);
+  g_free (saved);
+}
+
+static gboolean
+bench_file (const gchar *path)
+{
+  GtkSourceLanguageManager *manager;
+  GtkSourceLanguage *language;
+  GbSourceAutoIndenter *indenter;
+  GtkSourceBuffer *buffer;
+  GtkWidget *view;
+  GError *error = NULL;
+  gchar *contents;
+  gsize length;
+  guint n_lines;
+  guint step;
+  guint line;
+  guint i;
+
+  if (!(indenter = create_indenter (path)))
+    {
+      g_printerr ("%s: No auto-indenter for file type, skipping.\n", path);
+      return FALSE;
+    }
+
+  if (!g_file_get_contents (path, &contents, &length, &error))
+    {
+      g_printerr ("%s: %s\n", path, error->message);
+      g_clear_error (&error);
+      g_object_unref (indenter);
+      return FALSE;
+    }
+
+  manager = gtk_source_language_manager_get_default ();
+  language = gtk_source_language_manager_guess_language (manager, path, NULL);
+
+  buffer = gtk_source_buffer_new (NULL);
+  gtk_source_buffer_set_language (buffer, language);
+  gtk_source_buffer_begin_not_undoable_action (buffer);
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), contents, length);
+
+  view = g_object_ref_sink (gtk_source_view_new_with_buffer (buffer));
+
+  n_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (buffer));
+  step = MAX (1, n_lines / MAX (1, gSamples));
+
+  for (line = 0; line < n_lines; line += step)
+    for (i = 0; i < G_N_ELEMENTS (gTriggers); i++)
+      type_trigger (indenter, GTK_TEXT_VIEW (view), GTK_TEXT_BUFFER (buffer),
+                    line, &gTriggers [i]);
+
+  gtk_source_buffer_end_not_undoable_action (buffer);
+
+  g_object_unref (view);
+  g_object_unref (buffer);
+  g_object_unref (indenter);
+  g_free (contents);
+
+  return TRUE;
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble da = *(const gdouble *)a;
+  gdouble db = *(const gdouble *)b;
+
+  return (da < db) ? -1 : (da > db) ? 1 : 0;
+}
+
+static gdouble
+percentile (GArray  *sorted,
+            gdouble  p)
+{
+  guint i;
+
+  i = MIN (sorted->len - 1, (guint)(p * sorted->len));
+
+  return g_array_index (sorted, gdouble, i);
+}
+
+static void
+report (const gchar *path)
+{
+  guint i;
+
+  g_print ("%s\n", path);
+  g_print ("  %-8s %8s %10s %10s %10s\n",
+           "trigger", "samples", "p50 (us)", "p99 (us)", "max (us)");
+
+  for (i = 0; i < G_N_ELEMENTS (gTriggers); i++)
+    {
+      GArray *latencies = gTriggers [i].latencies;
+
+      if (latencies->len == 0)
+        continue;
+
+      g_array_sort (latencies, compare_double);
+
+      g_print ("  %-8s %8u %10.1f %10.1f %10.1f\n",
+               gTriggers [i].name,
+               latencies->len,
+               percentile (latencies, 0.50),
+               percentile (latencies, 0.99),
+               g_array_index (latencies, gdouble, latencies->len - 1));
+
+      g_array_set_size (latencies, 0);
+    }
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  guint i;
+  gint j;
+
+  context = g_option_context_new ("FILE... - benchmark the auto-indenters");
+  g_option_context_add_main_entries (context, gEntries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (FALSE));
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      g_option_context_free (context);
+      return EXIT_FAILURE;
+    }
+
+  g_option_context_free (context);
+
+  if (argc < 2)
+    {
+      g_printerr ("usage: %s [--samples=N] FILE...\n", argv [0]);
+      return EXIT_FAILURE;
+    }
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_printerr ("Failed to initialize gtk, is a display available?\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (gTriggers); i++)
+    gTriggers [i].latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+  for (j = 1; j < argc; j++)
+    if (bench_file (argv [j]))
+      report (argv [j]);
+
+  for (i = 0; i < G_N_ELEMENTS (gTriggers); i++)
+    g_array_unref (gTriggers [i].latencies);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+/* bench-c-parse-helper.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-parse-helper.h"
+
+/*
+ * Compares the time taken and the number of heap allocations made by the
+ * previous parser, which allocates every parameter and its strings on each
+ * call, with parse_parameters() and parse_parameters_arena() reusing a
+ * single arena.
+ *
+ * g_mem_set_vtable() does nothing since GLib 2.46, so allocations are
+ * counted by interposing malloc(), calloc() and realloc(). This relies on
+ * the glibc __libc_* entry points; elsewhere only the timings are reported.
+ */
+
+#define ITERATIONS 100000
+
+static const gchar *gPrototype =
+  "GbSourceAutoIndenter *indenter, GtkTextView *view, "
+  "GtkTextBuffer *buffer, GtkTextIter *begin, GtkTextIter *end, "
+  "gint *cursor_offset, GdkEventKey *event, gpointer user_data, "
+  "GCancellable *cancellable, GError **error, ...";
+
+static guint gAllocations;
+
+#ifdef __GLIBC__
+# define HAVE_ALLOCATION_COUNT 1
+
+extern void *__libc_malloc  (size_t n_bytes);
+extern void *__libc_calloc  (size_t n_blocks,
+                             size_t n_block_bytes);
+extern void *__libc_realloc (void   *mem,
+                             size_t  n_bytes);
+
+void *
+malloc (size_t n_bytes)
+{
+  gAllocations++;
+  return __libc_malloc (n_bytes);
+}
+
+void *
+calloc (size_t n_blocks,
+        size_t n_block_bytes)
+{
+  gAllocations++;
+  return __libc_calloc (n_blocks, n_block_bytes);
+}
+
+void *
+realloc (void   *mem,
+         size_t  n_bytes)
+{
+  gAllocations++;
+  return __libc_realloc (mem, n_bytes);
+}
+#endif
+
+/*
+ * The parser as it was before parse_parameters_arena(), kept here so that
+ * the benchmark has something to compare against.
+ */
+static void
+legacy_parameter_compute (Parameter *param)
+{
+  const gchar *tmp;
+  gchar *rev;
+  guint n_star = 0;
+
+  rev = g_utf8_strreverse (param->type, -1);
+
+  for (tmp = rev; tmp; tmp = g_utf8_next_char (tmp))
+    {
+      switch (g_utf8_get_char (tmp))
+        {
+        case ' ':
+          break;
+
+        case '*':
+          n_star++;
+          break;
+
+        default:
+          if (n_star)
+            {
+              gchar *cleaned;
+
+              cleaned = g_strstrip (g_utf8_strreverse (tmp, -1));
+              g_free (param->type);
+              param->type = cleaned;
+            }
+          goto finish;
+        }
+    }
+
+finish:
+  param->n_star = n_star;
+
+  g_free (rev);
+}
+
+static GSList *
+legacy_parse_parameters (const gchar *text)
+{
+  GSList *ret = NULL;
+  gchar **parts = NULL;
+  guint i;
+
+  parts = g_strsplit (text, ",", 0);
+
+  for (i = 0; parts [i]; i++)
+    {
+      const gchar *tmp;
+      const gchar *word;
+
+      word = g_strstrip (parts [i]);
+
+      if (!*word)
+        goto failure;
+
+      if (g_strcmp0 (word, "...") == 0)
+        {
+          Parameter param = { NULL, NULL, TRUE };
+          ret = g_slist_append (ret, parameter_copy (&param));
+          continue;
+        }
+
+      for (tmp = word; *tmp; tmp = g_utf8_next_char (tmp))
+        {
+          gunichar ch;
+
+          ch = g_utf8_get_char (tmp);
+
+          switch (ch)
+            {
+            case '\t':
+            case ' ':
+            case '*':
+            case '_':
+            case '[':
+            case ']':
+              break;
+
+            default:
+              if (g_unichar_isalnum (ch))
+                break;
+
+              goto failure;
+            }
+        }
+
+      if (!strchr (word, '[') || !strchr (word, ']'))
+        {
+          const gchar *name_sep;
+          Parameter param = { 0 };
+          gboolean success = FALSE;
+          gchar *reversed = NULL;
+          gchar *name_rev = NULL;
+
+          reversed = g_utf8_strreverse (word, -1);
+          name_sep = strpbrk (reversed, "\t\n *");
+
+          if (name_sep && *name_sep && *(name_sep + 1))
+            {
+              name_rev = g_strndup (reversed, name_sep - reversed);
+
+              param.name = g_strstrip (g_utf8_strreverse (name_rev, -1));
+              param.type = g_strstrip (g_utf8_strreverse (name_sep, -1));
+
+              legacy_parameter_compute (&param);
+
+              if (parameter_validate (&param))
+                {
+                  ret = g_slist_append (ret, parameter_copy (&param));
+                  success = TRUE;
+                }
+
+              g_free (param.name);
+              g_free (param.type);
+              g_free (name_rev);
+            }
+
+          g_free (reversed);
+
+          if (success)
+            continue;
+        }
+
+      goto failure;
+    }
+
+  goto cleanup;
+
+failure:
+  g_slist_foreach (ret, (GFunc)parameter_free, NULL);
+  g_clear_pointer (&ret, g_slist_free);
+
+cleanup:
+  g_strfreev (parts);
+
+  return ret;
+}
+
+static void
+report (const gchar *name,
+        gint64       usec,
+        guint        allocations)
+{
+#ifdef HAVE_ALLOCATION_COUNT
+  g_print ("%-28s %8.3f usec/call %8.2f allocations/call\n",
+           name,
+           usec / (gdouble)ITERATIONS,
+           allocations / (gdouble)ITERATIONS);
+#else
+  g_print ("%-28s %8.3f usec/call\n", name, usec / (gdouble)ITERATIONS);
+#endif
+}
+
+static void
+free_params (GSList *params)
+{
+  if (!params)
+    g_error ("Failed to parse prototype");
+
+  g_slist_foreach (params, (GFunc)parameter_free, NULL);
+  g_slist_free (params);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  ParameterArena *arena;
+  guint allocations;
+  gint64 begin;
+  guint i;
+
+  /* Use malloc() for GSList nodes too, so that they are counted. */
+  setenv ("G_SLICE", "always-malloc", TRUE);
+
+  allocations = gAllocations;
+  begin = g_get_monotonic_time ();
+
+  for (i = 0; i < ITERATIONS; i++)
+    free_params (legacy_parse_parameters (gPrototype));
+
+  report ("legacy parse_parameters",
+          g_get_monotonic_time () - begin,
+          gAllocations - allocations);
+
+  allocations = gAllocations;
+  begin = g_get_monotonic_time ();
+
+  for (i = 0; i < ITERATIONS; i++)
+    free_params (parse_parameters (gPrototype));
+
+  report ("parse_parameters",
+          g_get_monotonic_time () - begin,
+          gAllocations - allocations);
+
+  arena = parameter_arena_new ();
+
+  allocations = gAllocations;
+  begin = g_get_monotonic_time ();
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      guint n_params;
+
+      if (!parse_parameters_arena (arena, gPrototype, &n_params))
+        g_error ("Failed to parse prototype");
+    }
+
+  report ("parse_parameters_arena",
+          g_get_monotonic_time () - begin,
+          gAllocations - allocations);
+
+  parameter_arena_free (arena);
+
+  return EXIT_SUCCESS;
+}
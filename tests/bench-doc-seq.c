@@ -0,0 +1,126 @@
+/* bench-doc-seq.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "gb-doc-seq.h"
+
+/*
+ * Measures gb_doc_seq_acquire() and gb_doc_seq_release() with many ids
+ * held at once, as happens when scripts create thousands of scratch
+ * buffers. The hash table probing implementation it replaced is included
+ * as a baseline.
+ */
+
+#define N_IDS 20000
+
+static GHashTable *gProbeSeq;
+
+static guint
+probe_acquire (void)
+{
+  guint seq_id;
+
+  for (seq_id = 1; seq_id < G_MAXUINT; seq_id++)
+    {
+      gpointer key = GINT_TO_POINTER (seq_id);
+
+      if (!g_hash_table_lookup (gProbeSeq, key))
+        {
+          g_hash_table_insert (gProbeSeq, key, GINT_TO_POINTER (TRUE));
+          return seq_id;
+        }
+    }
+
+  return 0;
+}
+
+static void
+probe_release (guint seq_id)
+{
+  g_hash_table_remove (gProbeSeq, GINT_TO_POINTER (seq_id));
+}
+
+static void
+report (const gchar *name,
+        gint64       usec,
+        guint        calls)
+{
+  g_print ("%-32s %8.3f usec/call\n", name, usec / (gdouble)calls);
+}
+
+static void
+run (const gchar *name,
+     guint      (*acquire) (void),
+     void       (*release) (guint))
+{
+  guint *ids;
+  gchar *label;
+  gint64 begin;
+  guint i;
+
+  ids = g_new0 (guint, N_IDS);
+
+  /* Fill up from empty. */
+  begin = g_get_monotonic_time ();
+  for (i = 0; i < N_IDS; i++)
+    ids [i] = acquire ();
+  label = g_strdup_printf ("%s acquire", name);
+  report (label, g_get_monotonic_time () - begin, N_IDS);
+  g_free (label);
+
+  /* Fragment by releasing every other id, then fill the holes again. */
+  begin = g_get_monotonic_time ();
+  for (i = 0; i < N_IDS; i += 2)
+    release (ids [i]);
+  for (i = 0; i < N_IDS; i += 2)
+    ids [i] = acquire ();
+  label = g_strdup_printf ("%s fragmented", name);
+  report (label, g_get_monotonic_time () - begin, N_IDS);
+  g_free (label);
+
+  /* Churn a single id with everything else still held. */
+  begin = g_get_monotonic_time ();
+  for (i = 0; i < N_IDS; i++)
+    {
+      release (ids [N_IDS / 2]);
+      ids [N_IDS / 2] = acquire ();
+    }
+  label = g_strdup_printf ("%s churn", name);
+  report (label, g_get_monotonic_time () - begin, N_IDS * 2);
+  g_free (label);
+
+  for (i = 0; i < N_IDS; i++)
+    release (ids [i]);
+
+  g_free (ids);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  gProbeSeq = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  run ("hash probe", probe_acquire, probe_release);
+  run ("gb_doc_seq", gb_doc_seq_acquire, gb_doc_seq_release);
+
+  g_hash_table_unref (gProbeSeq);
+
+  return EXIT_SUCCESS;
+}
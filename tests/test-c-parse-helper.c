@@ -73,6 +73,44 @@ test_parse_parameters2 (void)
   g_assert (!ret);
 }
 
+static void
+test_parse_parameters_arena (void)
+{
+  ParameterArena *arena;
+  const Parameter *p;
+  guint n_params = 0;
+
+  arena = parameter_arena_new ();
+
+  p = parse_parameters_arena (arena, "Item *a , Item **b, ...", &n_params);
+  g_assert (p);
+  g_assert_cmpint (n_params, ==, 3);
+  g_assert_cmpstr (p [0].type, ==, "Item");
+  g_assert_cmpstr (p [0].name, ==, "a");
+  g_assert_cmpint (p [0].n_star, ==, 1);
+  g_assert_cmpstr (p [1].type, ==, "Item");
+  g_assert_cmpstr (p [1].name, ==, "b");
+  g_assert_cmpint (p [1].n_star, ==, 2);
+  g_assert_cmpint (p [2].ellipsis, ==, 1);
+
+  /* The arena is reused by the next call. */
+  p = parse_parameters_arena (arena, "gpointer u, GError ** error", &n_params);
+  g_assert (p);
+  g_assert_cmpint (n_params, ==, 2);
+  g_assert_cmpstr (p [0].type, ==, "gpointer");
+  g_assert_cmpstr (p [0].name, ==, "u");
+  g_assert_cmpint (p [0].n_star, ==, 0);
+  g_assert_cmpstr (p [1].type, ==, "GError");
+  g_assert_cmpstr (p [1].name, ==, "error");
+  g_assert_cmpint (p [1].n_star, ==, 2);
+
+  p = parse_parameters_arena (arena, "abc, def, ghi", &n_params);
+  g_assert (!p);
+  g_assert_cmpint (n_params, ==, 0);
+
+  parameter_arena_free (arena);
+}
+
 int
 main (int argc,
       char *argv[])
@@ -80,5 +118,6 @@ main (int argc,
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Parser/C/parse_parameters1", test_parse_parameters1);
   g_test_add_func ("/Parser/C/parse_parameters2", test_parse_parameters2);
+  g_test_add_func ("/Parser/C/parse_parameters_arena", test_parse_parameters_arena);
   return g_test_run ();
 }
@@ -0,0 +1,104 @@
+/* test-doc-seq.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gb-doc-seq.h"
+
+#define BITS_PER_WORD (sizeof (gulong) * 8)
+
+/*
+ * Sequence ids are process wide, so every test releases the ids it acquired
+ * before returning.
+ */
+
+static void
+test_doc_seq_lowest_free (void)
+{
+  guint i;
+
+  for (i = 1; i <= 5; i++)
+    g_assert_cmpint (gb_doc_seq_acquire (), ==, i);
+
+  gb_doc_seq_release (4);
+  gb_doc_seq_release (2);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 2);
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 4);
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 6);
+
+  for (i = 1; i <= 6; i++)
+    gb_doc_seq_release (i);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 1);
+  gb_doc_seq_release (1);
+}
+
+static void
+test_doc_seq_growth (void)
+{
+  guint n_ids = (5 * BITS_PER_WORD) + 1;
+  guint late = (3 * BITS_PER_WORD) + 7;
+  guint i;
+
+  for (i = 1; i <= n_ids; i++)
+    g_assert_cmpint (gb_doc_seq_acquire (), ==, i);
+
+  /* Free ids in an earlier word are found before growing again. */
+  gb_doc_seq_release (late);
+  gb_doc_seq_release (BITS_PER_WORD);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, BITS_PER_WORD);
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, late);
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, n_ids + 1);
+
+  for (i = 1; i <= n_ids + 1; i++)
+    gb_doc_seq_release (i);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 1);
+  gb_doc_seq_release (1);
+}
+
+static void
+test_doc_seq_release_unknown (void)
+{
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 1);
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 2);
+
+  /* Neither id was handed out, so nothing in use may be freed. */
+  gb_doc_seq_release (3);
+  gb_doc_seq_release (1000 * BITS_PER_WORD);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 3);
+
+  gb_doc_seq_release (1);
+  gb_doc_seq_release (2);
+  gb_doc_seq_release (3);
+
+  g_assert_cmpint (gb_doc_seq_acquire (), ==, 1);
+  gb_doc_seq_release (1);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/DocSeq/lowest_free", test_doc_seq_lowest_free);
+  g_test_add_func ("/DocSeq/growth", test_doc_seq_growth);
+  g_test_add_func ("/DocSeq/release_unknown", test_doc_seq_release_unknown);
+  return g_test_run ();
+}
@@ -0,0 +1,161 @@
+/* test-source-vim.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtksourceview/gtksource.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gb-source-vim.h"
+
+typedef struct
+{
+  GtkWidget     *window;
+  GtkWidget     *text_view;
+  GtkTextBuffer *buffer;
+  GbSourceVim   *vim;
+} Fixture;
+
+static void
+fixture_init (Fixture     *fixture,
+              const gchar *text,
+              guint        line)
+{
+  GtkTextIter iter;
+
+  fixture->window = gtk_offscreen_window_new ();
+  fixture->text_view = gtk_source_view_new ();
+  gtk_container_add (GTK_CONTAINER (fixture->window), fixture->text_view);
+  gtk_widget_show_all (fixture->window);
+
+  fixture->buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (fixture->text_view));
+  gtk_text_buffer_set_text (fixture->buffer, text, -1);
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &iter, line);
+  gtk_text_buffer_select_range (fixture->buffer, &iter, &iter);
+
+  fixture->vim = gb_source_vim_new (GTK_TEXT_VIEW (fixture->text_view));
+  gb_source_vim_set_enabled (fixture->vim, TRUE);
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  g_clear_object (&fixture->vim);
+  gtk_widget_destroy (fixture->window);
+}
+
+/*
+ * Feeds @keys to the view. "\033" is sent as Escape. While in insert mode,
+ * printable characters are inserted at the cursor like the text view would.
+ */
+static void
+send_keys (Fixture     *fixture,
+           const gchar *keys)
+{
+  for (; *keys; keys++)
+    {
+      GdkEventKey *event;
+      gboolean ret = FALSE;
+
+      if ((*keys != '\033') &&
+          (gb_source_vim_get_mode (fixture->vim) == GB_SOURCE_VIM_INSERT))
+        {
+          gtk_text_buffer_insert_interactive_at_cursor (fixture->buffer,
+                                                        keys, 1, TRUE);
+          continue;
+        }
+
+      event = (GdkEventKey *)gdk_event_new (GDK_KEY_PRESS);
+      event->window = g_object_ref (gtk_widget_get_window (fixture->text_view));
+      event->time = GDK_CURRENT_TIME;
+
+      if (*keys == '\033')
+        {
+          event->keyval = GDK_KEY_Escape;
+          event->string = g_strdup ("");
+        }
+      else
+        {
+          event->keyval = gdk_unicode_to_keyval (*keys);
+          event->string = g_strndup (keys, 1);
+        }
+
+      event->length = strlen (event->string);
+
+      g_signal_emit_by_name (fixture->text_view, "key-press-event", event, &ret);
+      gdk_event_free ((GdkEvent *)event);
+    }
+}
+
+static void
+assert_repeat (const gchar *text,
+               guint        line,
+               const gchar *keys,
+               const gchar *expected)
+{
+  Fixture fixture = { 0 };
+  GtkTextIter begin;
+  GtkTextIter end;
+  gchar *result;
+
+  fixture_init (&fixture, text, line);
+  send_keys (&fixture, keys);
+
+  gtk_text_buffer_get_bounds (fixture.buffer, &begin, &end);
+  result = gtk_text_buffer_get_text (fixture.buffer, &begin, &end, TRUE);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_repeat_open_below (void)
+{
+  assert_repeat ("foo\nbar\n", 0, "ox\033.", "foo\nx\nx\nbar\n");
+}
+
+static void
+test_repeat_open_above (void)
+{
+  assert_repeat ("foo\n", 0, "Ox\033.", "x\nx\nfoo\n");
+}
+
+static void
+test_repeat_change_line (void)
+{
+  assert_repeat ("foo\nbar\nbaz\n", 0, "ccx\033j.", "x\nx\nbaz\n");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_print ("1..0 # SKIP No display available\n");
+      return EXIT_SUCCESS;
+    }
+
+  g_test_add_func ("/SourceVim/repeat/open-below", test_repeat_open_below);
+  g_test_add_func ("/SourceVim/repeat/open-above", test_repeat_open_above);
+  g_test_add_func ("/SourceVim/repeat/change-line", test_repeat_change_line);
+
+  return g_test_run ();
+}
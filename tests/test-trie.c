@@ -0,0 +1,264 @@
+/* test-trie.c
+ *
+ * Copyright (C) 2014 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trie.h"
+
+/* Layout of the image written by trie_serialize(), see trie.c. */
+#define IMAGE_HEADER_SIZE      16
+#define IMAGE_NODE_SIZE        16
+#define IMAGE_NODE_VALUE       0
+#define IMAGE_NODE_FIRST_CHILD 8
+
+static const gchar *keys[] = {
+  "a", "ab", "abc", "abd", "b", "ba", "zz", NULL
+};
+
+static Trie *
+build_trie (void)
+{
+  Trie *trie;
+  guint i;
+
+  trie = trie_new (g_free);
+
+  /* Insert out of order so the image has to sort the children. */
+  for (i = G_N_ELEMENTS (keys) - 1; i > 0; i--)
+    trie_insert (trie, keys [i - 1], g_strdup (keys [i - 1]));
+
+  return trie;
+}
+
+static Trie *
+map_image (const guint8  *data,
+           gsize          size,
+           GError       **error)
+{
+  GMappedFile *mapped;
+  Trie *trie;
+  gchar *path = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("test-trie-XXXXXX", &path, error);
+  g_assert_cmpint (fd, !=, -1);
+  close (fd);
+
+  g_assert (g_file_set_contents (path, (const gchar *)data, size, NULL));
+
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  g_assert (mapped);
+
+  /* The mapping outlives the file. */
+  g_unlink (path);
+  g_free (path);
+
+  trie = trie_new_from_mapped (mapped, error);
+  g_mapped_file_unref (mapped);
+
+  return trie;
+}
+
+static gboolean
+collect_cb (Trie        *trie,
+            const gchar *key,
+            gpointer     value,
+            gpointer     user_data)
+{
+  GPtrArray *ar = user_data;
+
+  g_assert_cmpstr (key, ==, value);
+  g_ptr_array_add (ar, g_strdup (key));
+
+  return FALSE;
+}
+
+static gboolean
+collect_two_cb (Trie        *trie,
+                const gchar *key,
+                gpointer     value,
+                gpointer     user_data)
+{
+  GPtrArray *ar = user_data;
+
+  collect_cb (trie, key, value, user_data);
+
+  return (ar->len == 2);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const gchar **)a, *(const gchar **)b);
+}
+
+static void
+assert_keys (GPtrArray    *ar,
+             const gchar **expected)
+{
+  guint i;
+
+  for (i = 0; expected [i]; i++)
+    {
+      g_assert_cmpint (i, <, ar->len);
+      g_assert_cmpstr (g_ptr_array_index (ar, i), ==, expected [i]);
+    }
+
+  g_assert_cmpint (i, ==, ar->len);
+}
+
+static void
+test_trie_round_trip (void)
+{
+  static const gchar *prefixed[] = { "ab", "abc", "abd", NULL };
+  static const gchar *first_two[] = { "a", "ab", NULL };
+  GPtrArray *ar;
+  GBytes *bytes;
+  GError *error = NULL;
+  Trie *trie;
+  Trie *mapped;
+  guint i;
+
+  trie = build_trie ();
+  bytes = trie_serialize (trie, NULL, NULL);
+  g_assert (bytes);
+
+  mapped = map_image (g_bytes_get_data (bytes, NULL),
+                      g_bytes_get_size (bytes),
+                      &error);
+  g_assert_no_error (error);
+  g_assert (mapped);
+
+  for (i = 0; keys [i]; i++)
+    g_assert_cmpstr (trie_lookup (mapped, keys [i]), ==, keys [i]);
+
+  g_assert (!trie_lookup (mapped, ""));
+  g_assert (!trie_lookup (mapped, "z"));
+  g_assert (!trie_lookup (mapped, "abx"));
+  g_assert (!trie_lookup (mapped, "abcd"));
+
+  /* Sorted traversal visits keys in strcmp() order. */
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse_sorted (mapped, NULL, G_TRAVERSE_LEAVES, -1, collect_cb, ar);
+  assert_keys (ar, keys);
+  g_ptr_array_unref (ar);
+
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse_sorted (mapped, "ab", G_TRAVERSE_LEAVES, -1, collect_cb, ar);
+  assert_keys (ar, prefixed);
+  g_ptr_array_unref (ar);
+
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse_sorted (mapped, NULL, G_TRAVERSE_LEAVES, -1, collect_two_cb, ar);
+  assert_keys (ar, first_two);
+  g_ptr_array_unref (ar);
+
+  /* Both orders visit the same keys as the original trie. */
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse (mapped, NULL, G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
+                 collect_cb, ar);
+  g_ptr_array_sort (ar, compare_strings);
+  assert_keys (ar, keys);
+  g_ptr_array_unref (ar);
+
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse (mapped, NULL, G_POST_ORDER, G_TRAVERSE_LEAVES, -1,
+                 collect_cb, ar);
+  g_ptr_array_sort (ar, compare_strings);
+  assert_keys (ar, keys);
+  g_ptr_array_unref (ar);
+
+  ar = g_ptr_array_new_with_free_func (g_free);
+  trie_traverse (mapped, "ab", G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
+                 collect_cb, ar);
+  g_ptr_array_sort (ar, compare_strings);
+  assert_keys (ar, prefixed);
+  g_ptr_array_unref (ar);
+
+  trie_destroy (mapped);
+  g_bytes_unref (bytes);
+  trie_destroy (trie);
+}
+
+static void
+assert_rejected (const guint8 *data,
+                 gsize         size)
+{
+  GError *error = NULL;
+  Trie *trie;
+
+  trie = map_image (data, size, &error);
+  g_assert (!trie);
+  g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+  g_clear_error (&error);
+}
+
+static void
+test_trie_reject_invalid (void)
+{
+  GBytes *bytes;
+  guint8 *data;
+  guint32 word;
+  Trie *trie;
+  gsize size;
+
+  trie = build_trie ();
+  bytes = trie_serialize (trie, NULL, NULL);
+  data = g_memdup (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+  size = g_bytes_get_size (bytes);
+
+  g_assert_cmpint (size, >, IMAGE_HEADER_SIZE + IMAGE_NODE_SIZE);
+
+  /* Truncated images. */
+  assert_rejected (data, 0);
+  assert_rejected (data, IMAGE_HEADER_SIZE - 1);
+  assert_rejected (data, IMAGE_HEADER_SIZE + IMAGE_NODE_SIZE);
+  assert_rejected (data, size - 1);
+
+  /* Bad magic. */
+  data [0] ^= 0xff;
+  assert_rejected (data, size);
+  data [0] ^= 0xff;
+
+  /* A child pointing back at the root would never terminate. */
+  memcpy (&word, data + IMAGE_HEADER_SIZE + IMAGE_NODE_FIRST_CHILD, 4);
+  memset (data + IMAGE_HEADER_SIZE + IMAGE_NODE_FIRST_CHILD, 0, 4);
+  assert_rejected (data, size);
+  memcpy (data + IMAGE_HEADER_SIZE + IMAGE_NODE_FIRST_CHILD, &word, 4);
+
+  /* A value past the end of the image. */
+  memset (data + IMAGE_HEADER_SIZE + IMAGE_NODE_VALUE, 0xff, 4);
+  assert_rejected (data, size);
+
+  g_free (data);
+  g_bytes_unref (bytes);
+  trie_destroy (trie);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Trie/round_trip", test_trie_round_trip);
+  g_test_add_func ("/Trie/reject_invalid", test_trie_reject_invalid);
+  return g_test_run ();
+}
@@ -10,3 +10,42 @@ TESTS += test-navigation-list
 test_navigation_list_SOURCES = tests/test-navigation-list.c
 test_navigation_list_CFLAGS = $(libgnome_builder_la_CFLAGS)
 test_navigation_list_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += bench-auto-indenter
+bench_auto_indenter_SOURCES = tests/bench-auto-indenter.c
+bench_auto_indenter_CFLAGS = $(libgnome_builder_la_CFLAGS)
+bench_auto_indenter_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += bench-c-parse-helper
+bench_c_parse_helper_SOURCES = tests/bench-c-parse-helper.c
+bench_c_parse_helper_CFLAGS = $(libgnome_builder_la_CFLAGS)
+bench_c_parse_helper_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += bench-doc-seq
+bench_doc_seq_SOURCES = tests/bench-doc-seq.c
+bench_doc_seq_CFLAGS = $(libgnome_builder_la_CFLAGS)
+bench_doc_seq_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += test-source-vim
+TESTS += test-source-vim
+test_source_vim_SOURCES = tests/test-source-vim.c
+test_source_vim_CFLAGS = $(libgnome_builder_la_CFLAGS)
+test_source_vim_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += test-trie
+TESTS += test-trie
+test_trie_SOURCES = tests/test-trie.c
+test_trie_CFLAGS = $(libgnome_builder_la_CFLAGS)
+test_trie_LDADD = libgnome-builder.la
+
+
+noinst_PROGRAMS += test-doc-seq
+TESTS += test-doc-seq
+test_doc_seq_SOURCES = tests/test-doc-seq.c
+test_doc_seq_CFLAGS = $(libgnome_builder_la_CFLAGS)
+test_doc_seq_LDADD = libgnome-builder.la